@@ -1,28 +1,33 @@
 #include "NuclEvtGen.hh"
+#include "CompactEventFile.hh"
+#include "SobolSequence.hh"
+#include "SamplingKernels.hh"
 #include "ControlMenu.hh"
 #include "PathUtils.hh"
 #include <Math/QuasiRandom.h>
 #include <Math/Random.h>
 #include <TFile.h>
 #include <TTree.h>
+#include <TRandom.h>
+#include <TRandom3.h>
+#include <ctime>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <sys/stat.h>
 
 using namespace ROOT::Math;
 
-void mi_evtgen(StreamInteractor* S) {
-
-	// load arguments
-	const unsigned int nTrees = S->popInt();
-	const unsigned int nPerTree = S->popInt();
-	const std::string rtSelect = S->popString();
-	const std::string vpSelect = S->popString();
-	std::string outPath = S->popString();
-	const std::string genName = S->popString();
+/// generate trees firstTree to endTree-1; tree tn always holds events tn*nPerTree onwards of the
+/// random sequence, so separate jobs can each generate some of the trees of one set.
+/// With writeCompact, each tree Evts_N.root also gets a compact copy Evts_N.cevt
+/// (otherwise convert trees later with "compact").
+void genEventTrees(const std::string& genName, std::string outPath, const std::string& vpSelect, const std::string& rtSelect,
+				   unsigned int nPerTree, unsigned int firstTree, unsigned int endTree, bool writeCompact = false) {
 	
 	// load generators
-	std::string majorDir= "~/Documents/Caltech/UCNA_Sim/XSun_ucna_G4Sim";
-	static NucDecayLibrary NDL(majorDir+"/ExtraFiles/",1e-6);
-//	static NucDecayLibrary NDL(getEnvSafe("UCNA_AUX")+"/NuclearDecays/",1e-6);
-	NucDecaySystem& NDS = NDL.getGenerator(genName);
+	const NucDecaySystem& NDS = NucDecayLibrary::shared().getGenerator(genName);
 	NDS.display();
 	PositionGenerator* PosGen = vpSelect=="f" ?	(PositionGenerator*)(new CylPosGen(3.,2.3*0.0254)) :
 								vpSelect=="g" ?	(PositionGenerator*)(new CylPosGen(4.3,.075)) :
@@ -38,7 +43,7 @@ void mi_evtgen(StreamInteractor* S) {
 	makePath(outPath);
 	
 	// set up variables
-	unsigned int evtn = 0;
+	unsigned int evtn = firstTree*nPerTree;
 	double vpos[Z_DIRECTION+1];
 	for(AxisDirection d = X_DIRECTION; d <= Z_DIRECTION; ++d) vpos[d] = 0;
 	const unsigned int posDF = PosGen ? PosGen->getNDF(): 0;
@@ -47,18 +52,27 @@ void mi_evtgen(StreamInteractor* S) {
 	std::vector<double> rnd(totDF);
 	NucDecayEvent tEvt;
 	RandomMT r0;
-	QuasiRandomSobol rSobol(totDF);
+	SobolSequence rSobol(totDF,1);	// scrambled, with the same scramble in every job
 	QuasiRandomNiederreiter rNied(totDF);
 	if(qrt==QR_NIED && totDF>12) {
-		printf("Warning: ROOT's Niederreiter quasi-random generator invalid for >12 DF; switching to Sobol\n");
+		printf("Warning: ROOT's Niederreiter quasi-random generator invalid for >12 DF; switching to scrambled Sobol\n");
 		qrt=QR_SOBOL;
 	}
 	
 	printf("Generating events in '%s' with %i+%i+1 random DF\n",outPath.c_str(),posDF,decayDF);
 	
-	for(unsigned int tn=0; tn<nTrees; tn++) {
+	// start at event evtn of the sequence; every job uses the same seeds, so trees continue it
+	// seamlessly whichever job makes them. MT and Niederreiter points can only be skipped by generating them
+	if(qrt==INDEP_RANDOM)
+		for(unsigned int i=0; i<evtn; i++) r0.RndmArray(totDF,&rnd[0]);
+	else if(qrt==QR_SOBOL)
+		rSobol.skipTo(evtn);
+	else if(qrt==QR_NIED)
+		for(unsigned int i=0; i<evtn; i++) rNied.Next(&rnd[0]);
 	
-		printf("Tree %i/%i: %i events\n",tn+1,nTrees,nPerTree);
+	for(unsigned int tn=firstTree; tn<endTree; tn++) {
+	
+		printf("Tree %i/%i: %i events\n",tn+1,endTree,nPerTree);
 	
 		TFile f((outPath+"/Evts_"+itos(tn)+".root").c_str(),"RECREATE");
 		f.cd();
@@ -72,28 +86,502 @@ void mi_evtgen(StreamInteractor* S) {
 		T.Branch("time",&tEvt.t,"time/D");
 		T.Branch("weight",&tEvt.w,"weight/D");
 		
+		// optionally the same events in the compact format
+		CompactEventWriter* W = NULL;
+		if(writeCompact) {
+			Stringmap meta;
+			meta.insert("generator",genName);
+			meta.insert("vertex",vpSelect);
+			meta.insert("random",rtSelect);
+			meta.insert("tree",tn);
+			meta.insert("firstEvent",evtn);
+			meta.insert("events",nPerTree);
+			W = new CompactEventWriter(outPath+"/Evts_"+itos(tn)+".cevt",meta);
+		}
+		
 		for(unsigned int i=0; i<nPerTree; i++) {
 			std::vector<NucDecayEvent> evts;
 			if(qrt==INDEP_RANDOM) r0.RndmArray(totDF,&rnd[0]);
-			else if(qrt==QR_SOBOL) rSobol.Next(&rnd[0]);
+			else if(qrt==QR_SOBOL) rSobol.next(&rnd[0]);
 			else if(qrt==QR_NIED) rNied.Next(&rnd[0]);
 			
 			NDS.genDecayChain(evts, &rnd[0]);
 			if(PosGen) PosGen->genPos(vpos,&rnd[decayDF+1]);
 			for(unsigned int i=0; i<evts.size(); i++) {
+				evts[i].eid = evtn;
+				for(AxisDirection d = X_DIRECTION; d <= Z_DIRECTION; ++d) evts[i].x[d] = vpos[d];
 				tEvt = evts[i];
-				tEvt.eid = evtn;
-				for(AxisDirection d = X_DIRECTION; d <= Z_DIRECTION; ++d) tEvt.x[d] = vpos[d];
 				T.Fill();
 			}
+			if(W) W->addEvt(evts);
 			evtn++;
 		}
+		if(W) {
+			W->close();
+			delete W;
+		}
 		
 		T.Write();
 		f.Close();
 	}
 }
 
+/// whether "run"/"runpart" also write compact event files: $UCNA_COMPACT_EVENTS=1
+bool compactOutput() { return getEnvSafe("UCNA_COMPACT_EVENTS","0")=="1"; }
+
+void mi_evtgen(StreamInteractor* S) {
+	
+	// load arguments
+	const unsigned int nTrees = S->popInt();
+	const unsigned int nPerTree = S->popInt();
+	const std::string rtSelect = S->popString();
+	const std::string vpSelect = S->popString();
+	const std::string outPath = S->popString();
+	const std::string genName = S->popString();
+	
+	genEventTrees(genName,outPath,vpSelect,rtSelect,nPerTree,0,nTrees,compactOutput());
+}
+
+void mi_evtgen_part(StreamInteractor* S) {
+	
+	// load arguments
+	const unsigned int nTrees = S->popInt();
+	const unsigned int firstTree = S->popInt();
+	const unsigned int nPerTree = S->popInt();
+	const std::string rtSelect = S->popString();
+	const std::string vpSelect = S->popString();
+	const std::string outPath = S->popString();
+	const std::string genName = S->popString();
+	
+	genEventTrees(genName,outPath,vpSelect,rtSelect,nPerTree,firstTree,firstTree+nTrees,compactOutput());
+}
+
+void mi_selbench(StreamInteractor* S) {
+	
+	// load arguments
+	const unsigned int nSamples = S->popInt();
+	const unsigned int nLines = S->popInt();
+	
+	// GammaForest-like selector: many lines with widely spread intensities
+	PSelector P;
+	for(unsigned int i=0; i<nLines; i++) P.addProb(pow(10.,-6*gRandom->Uniform(0,1)));
+	PSelector PA = P;
+	PA.buildAlias();
+	
+	std::vector<unsigned int> hBinary(nLines), hAlias(nLines);
+	clock_t t0 = clock();
+	for(unsigned int i=0; i<nSamples; i++) {
+		double x = gRandom->Uniform(0,1);
+		hBinary[P.select(&x)]++;
+	}
+	clock_t t1 = clock();
+	for(unsigned int i=0; i<nSamples; i++)
+		hAlias[PA.select()]++;
+	clock_t t2 = clock();
+	
+	// both selectors should follow the line probabilities
+	double chi2Binary = 0, chi2Alias = 0;
+	unsigned int nBins = 0;
+	for(unsigned int i=0; i<nLines; i++) {
+		double expected = nSamples*P.getProb(i);
+		if(expected <= 0) continue;
+		chi2Binary += pow(hBinary[i]-expected,2)/expected;
+		chi2Alias += pow(hAlias[i]-expected,2)/expected;
+		nBins++;
+	}
+	const unsigned int ndf = nBins>1 ? nBins-1 : 1;
+	// time per selection: each loop made nSamples selections
+	const double nsBinary = 1e9*double(t1-t0)/CLOCKS_PER_SEC/nSamples;
+	const double nsAlias = 1e9*double(t2-t1)/CLOCKS_PER_SEC/nSamples;
+	printf("%i lines, %i samples:\n",nLines,nSamples);
+	printf("  binary search: %.1f ns/select, chi2/ndf = %.3f\n",nsBinary,chi2Binary/ndf);
+	printf("  alias table:   %.1f ns/select, chi2/ndf = %.3f (x%.2f)\n",nsAlias,chi2Alias/ndf,nsAlias>0?nsBinary/nsAlias:0.);
+}
+
+void mi_loadbench(StreamInteractor* S) {
+	
+	// load arguments
+	const std::string genName = S->popString();
+	
+	// text parsing, then first cached load (writes the caches), then loading from the caches
+	const char* labels[3] = {"text","cache build","cached"};
+	double ms[3];
+	for(int i=0; i<3; i++) {
+		QFile::useBinaryCache = (i>0);
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		NucDecayLibrary NDL(NucDecayLibrary::defaultDataPath(),1e-6);
+		NDL.getGenerator(genName);
+		ms[i] = 1e3*std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	}
+	QFile::useBinaryCache = true;
+	for(int i=0; i<3; i++)
+		printf("%s generator construction, %s: %.2f ms\n",genName.c_str(),labels[i],ms[i]);
+}
+
+/// summary statistics of generated decay events, by particle type
+struct DecayStats {
+	DecayStats(): nEvents(0), checksum(0) { for(int i=0; i<4; i++) { n[i] = 0; sumE[i] = sumE2[i] = 0; } }
+	/// add one event's particles
+	void add(const std::vector<NucDecayEvent>& evts) {
+		nEvents++;
+		for(unsigned int i=0; i<evts.size(); i++) {
+			int t = evts[i].d==D_GAMMA ? 0 : evts[i].d==D_ELECTRON ? 1 : evts[i].d==D_POSITRON ? 2 : 3;
+			n[t]++;
+			sumE[t] += evts[i].E;
+			sumE2[t] += evts[i].E*evts[i].E;
+			checksum += (i+1)*evts[i].E + evts[i].p[2];
+		}
+	}
+	unsigned long nEvents;
+	unsigned long n[4];
+	double sumE[4];
+	double sumE2[4];
+	double checksum;	///< order-sensitive sum, equal only for identical event sequences
+};
+
+/// generate nEvents from the shared decay system with a private random generator
+void stressWorker(const NucDecaySystem* NDS, unsigned int seed, unsigned int nEvents, DecayStats* stats) {
+	TRandom3 R(seed);
+	std::vector<NucDecayEvent> evts;
+	for(unsigned int i=0; i<nEvents; i++) {
+		evts.clear();
+		NDS->genDecayChain(evts, NULL, &R);
+		stats->add(evts);
+	}
+}
+
+void mi_mtstress(StreamInteractor* S) {
+	
+	// load arguments
+	const unsigned int nPerThread = S->popInt();
+	const unsigned int nThreads = S->popInt();
+	const std::string genName = S->popString();
+	
+	const NucDecaySystem& NDS = NucDecayLibrary::shared().getGenerator(genName);
+	
+	// all threads sampling the one decay system at once
+	std::vector<DecayStats> threaded(nThreads);
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for(unsigned int t=0; t<nThreads; t++)
+		workers.push_back(std::thread(stressWorker, &NDS, t+1, nPerThread, &threaded[t]));
+	for(unsigned int t=0; t<nThreads; t++) workers[t].join();
+	std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+	
+	// the same seeds one after another must give identical events
+	std::vector<DecayStats> sequential(nThreads);
+	for(unsigned int t=0; t<nThreads; t++)
+		stressWorker(&NDS, t+1, nPerThread, &sequential[t]);
+	std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+	
+	unsigned int nMismatch = 0;
+	for(unsigned int t=0; t<nThreads; t++)
+		if(threaded[t].checksum != sequential[t].checksum) nMismatch++;
+	const double tThreaded = std::chrono::duration<double>(t1-t0).count();
+	const double tSequential = std::chrono::duration<double>(t2-t1).count();
+	printf("%i threads x %i events: %.2f s threaded, %.2f s sequential (x%.2f); %i/%i threads differ from their sequential replay\n",
+		   nThreads,nPerThread,tThreaded,tSequential,tThreaded>0?tSequential/tThreaded:0.,nMismatch,nThreads);
+	
+	// per-thread means should agree within their errors
+	const char* names[4] = {"gamma","e-","e+","other"};
+	for(int i=0; i<4; i++) {
+		unsigned long nTot = 0;
+		double sumTot = 0;
+		for(unsigned int t=0; t<nThreads; t++) { nTot += threaded[t].n[i]; sumTot += threaded[t].sumE[i]; }
+		if(!nTot) continue;
+		const double mean = sumTot/nTot;
+		double chi2 = 0;
+		for(unsigned int t=0; t<nThreads; t++) {
+			const DecayStats& D = threaded[t];
+			if(D.n[i] < 2) continue;
+			double m = D.sumE[i]/D.n[i];
+			double var = (D.sumE2[i]/D.n[i]-m*m)/(D.n[i]-1);
+			if(var > 0) chi2 += (m-mean)*(m-mean)/var;
+		}
+		printf("  %-6s %.4f per event, <E> = %.3f keV, per-thread chi2/ndf = %.3f\n",
+			   names[i],nTot/double(nThreads*nPerThread),mean,nThreads>1?chi2/(nThreads-1):0.);
+	}
+}
+
+void mi_scanbench(StreamInteractor* S) {
+	
+	// load arguments
+	const unsigned int nParts = S->popInt();
+	const std::string fPattern = S->popString();
+	
+	// whole chain, in order
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	EventTreeScanner ETS;
+	ETS.addFile(fPattern);
+	const unsigned int nEvts = ETS.getnEvts();
+	std::vector<unsigned int> eids(nEvts);
+	unsigned long nPrim = 0;
+	double sumE = 0;
+	std::vector<NucDecayEvent> v;
+	for(unsigned int k=0; k<nEvts; k++) {
+		v.clear();
+		nPrim += ETS.loadEvt(v);
+		eids[k] = v[0].eid;
+		for(unsigned int i=0; i<v.size(); i++) sumE += v[i].E;
+	}
+	const double tWhole = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	printf("%i events, %li primaries in %.2f s\n",nEvts,nPrim,tWhole);
+	ETS.printCacheStats();
+	
+	// random access must find the same events
+	unsigned int nBadSeek = 0;
+	for(unsigned int i=0; i<1000 && nEvts; i++) {
+		unsigned int k = gRandom->Integer(nEvts);
+		v.clear();
+		ETS.readEvt(v,k);
+		for(unsigned int j=0; j<v.size(); j++) if(v[j].eid != eids[k]) { nBadSeek++; break; }
+	}
+	printf("1000 random event reads: %i mismatched\n",nBadSeek);
+	
+	// disjoint parts, as read by separate jobs, must cover every event exactly once
+	std::vector<unsigned int> nSeen(nEvts);
+	unsigned long nPrimParts = 0;
+	double sumEParts = 0;
+	t0 = std::chrono::steady_clock::now();
+	for(unsigned int p=0; p<nParts; p++) {
+		EventTreeScanner ETSp;
+		ETSp.addFile(fPattern);
+		ETSp.selectPart(p,nParts);
+		const unsigned int k0 = ETSp.partStart();
+		for(unsigned int k=k0; k<ETSp.partEnd(); k++) {
+			v.clear();
+			nPrimParts += ETSp.loadEvt(v);
+			if(v[0].eid == eids[k]) nSeen[k]++;
+			for(unsigned int i=0; i<v.size(); i++) sumEParts += v[i].E;
+		}
+	}
+	const double tParts = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	unsigned int nMissed = 0, nDuplicated = 0;
+	for(unsigned int k=0; k<nEvts; k++) {
+		if(!nSeen[k]) nMissed++;
+		if(nSeen[k] > 1) nDuplicated++;
+	}
+	printf("%i parts in %.2f s: %li primaries (%+li), sum KE %+.3g keV, %i events missed, %i duplicated\n",
+		   nParts,tParts,nPrimParts,(long)nPrimParts-(long)nPrim,sumEParts-sumE,nMissed,nDuplicated);
+}
+
+/// file size [MB]
+double fileMB(const std::string& fname) {
+	struct stat st;
+	return stat(fname.c_str(),&st) ? 0 : st.st_size*1e-6;
+}
+
+void mi_compact(StreamInteractor* S) {
+	
+	// load arguments
+	const int cxlevel = S->popInt();
+	const std::string fIn = S->popString();
+	const std::string fOut = fIn.substr(0,fIn.rfind('.'))+".cevt";
+	
+	// read the TTree, writing the compact file
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	EventTreeScanner ETS;
+	ETS.addFile(fIn);
+	const unsigned int nEvts = ETS.getnEvts();
+	std::vector< std::vector<NucDecayEvent> > evts(nEvts);
+	for(unsigned int k=0; k<nEvts; k++) ETS.loadEvt(evts[k]);
+	const double tTree = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	Stringmap meta;
+	meta.insert("source",fIn);
+	meta.insert("events",nEvts);
+	{
+		CompactEventWriter W(fOut,meta,cxlevel);
+		for(unsigned int k=0; k<nEvts; k++) W.addEvt(evts[k]);
+		W.close();
+	}
+	
+	// read it back and compare
+	t0 = std::chrono::steady_clock::now();
+	CompactEventFile F(fOut);
+	std::vector<NucDecayEvent> v;
+	unsigned int nBad = 0;
+	double maxdE = 0, maxdx = 0, maxdp = 0, maxdt = 0;
+	for(unsigned int k=0; k<nEvts; k++) {
+		v.clear();
+		F.loadEvt(v);
+		if(v.size() != evts[k].size()) { nBad++; continue; }
+		for(unsigned int i=0; i<v.size(); i++) {
+			const NucDecayEvent& a = evts[k][i];
+			if(v[i].eid != a.eid || v[i].d != a.d) nBad++;
+			maxdE = std::max(maxdE,fabs(v[i].E-a.E));
+			maxdt = std::max(maxdt,fabs(v[i].t-a.t));
+			for(int j=0; j<3; j++) {
+				maxdx = std::max(maxdx,fabs(v[i].x[j]-a.x[j]));
+				maxdp = std::max(maxdp,fabs(v[i].p[j]-a.p[j]));
+			}
+		}
+	}
+	const double tCompact = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	
+	printf("%i events, %llu primaries in %i blocks; %i mismatched\n",nEvts,(unsigned long long)F.getNPrimaries(),F.getNBlocks(),nBad);
+	printf("  TTree:   %.2f MB, read in %.3f s\n",fileMB(fIn),tTree);
+	printf("  compact: %.2f MB, read in %.3f s (size x%.2f, speed x%.2f)\n",fileMB(fOut),tCompact,
+		   fileMB(fOut)>0?fileMB(fIn)/fileMB(fOut):0.,tCompact>0?tTree/tCompact:0.);
+	printf("  max. differences: KE %.2g keV, vertex %.2g, direction %.2g, time %.2g\n",maxdE,maxdx,maxdp,maxdt);
+}
+
+/// chi^2/ndf of histogram h against a flat distribution
+double flatChi2(const std::vector<unsigned int>& h, unsigned int n) {
+	const double expected = double(n)/h.size();
+	double chi2 = 0;
+	for(unsigned int i=0; i<h.size(); i++) chi2 += pow(h[i]-expected,2)/expected;
+	return chi2/(h.size()-1);
+}
+
+/// bin for x in [0,1)
+inline unsigned int unitBin(double x, unsigned int nBins) { unsigned int b = x*nBins; return b<nBins ? b : nBins-1; }
+
+void mi_kernelbench(StreamInteractor* S) {
+	
+	// load arguments
+	const unsigned int nSamples = S->popInt();
+	
+	const unsigned int nBins = 100;
+	TRandom3 R(1);
+	std::vector<double> u(nSamples), v(nSamples), w(nSamples), x(nSamples), y(nSamples), z(nSamples);
+	R.RndmArray(nSamples,&u[0]);
+	R.RndmArray(nSamples,&v[0]);
+	R.RndmArray(nSamples,&w[0]);
+	
+	// isotropic directions: flat in cos theta and phi, unit length, agree with libm evaluation
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	isotropicDirections(nSamples,&u[0],&v[0],&x[0],&y[0],&z[0]);
+	std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+	double sumRef = 0;
+	for(unsigned int i=0; i<nSamples; i++) {
+		double c = 2*u[i]-1, s = sqrt((1-c)*(1+c)), phi = 2*M_PI*v[i];
+		sumRef += cos(phi)*s + sin(phi)*s + c;
+	}
+	std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+	std::vector<unsigned int> hz(nBins), hphi(nBins);
+	double maxNorm = 0, maxRef = 0;
+	for(unsigned int i=0; i<nSamples; i++) {
+		hz[unitBin(0.5*(z[i]+1),nBins)]++;
+		hphi[unitBin(0.5+0.5*atan2(y[i],x[i])/M_PI,nBins)]++;
+		maxNorm = std::max(maxNorm,fabs(sqrt(x[i]*x[i]+y[i]*y[i]+z[i]*z[i])-1));
+		double c = 2*u[i]-1, s = sqrt((1-c)*(1+c)), phi = 2*M_PI*v[i];
+		maxRef = std::max(maxRef,std::max(fabs(x[i]-cos(phi)*s),fabs(y[i]-sin(phi)*s)));
+	}
+	const double nsDir = 1e9*std::chrono::duration<double>(t1-t0).count()/nSamples;
+	const double nsDirRef = 1e9*std::chrono::duration<double>(t2-t1).count()/nSamples;
+	printf("%i samples, %i lanes:\n",nSamples,samplingLanes());
+	printf("  directions: %.2f ns/sample (libm %.2f ns, x%.2f); chi2/ndf cos theta %.3f, phi %.3f\n",
+		   nsDir,nsDirRef,nsDir>0?nsDirRef/nsDir:0.,flatChi2(hz,nSamples),flatChi2(hphi,nSamples));
+	printf("              max ||p|-1| = %.2g, max deviation from libm %.2g (checksum %g)\n",maxNorm,maxRef,sumRef);
+	
+	// unit disk: flat in r^2 and angle; compared with rejection sampling
+	t0 = std::chrono::steady_clock::now();
+	uniformDisk(nSamples,&u[0],&v[0],1.,&x[0],&y[0]);
+	t1 = std::chrono::steady_clock::now();
+	unsigned int nTries = 0, j = 0;
+	double sumRej = 0;
+	for(unsigned int i=0; i<nSamples; i++) {
+		double a, b;
+		do {
+			a = 2*(j<nSamples ? u[j] : R.Uniform())-1;
+			b = 2*(j<nSamples ? w[j] : R.Uniform())-1;
+			j++;
+			nTries++;
+		} while(a*a+b*b > 1);
+		sumRej += a+b;
+	}
+	t2 = std::chrono::steady_clock::now();
+	std::vector<unsigned int> hr2(nBins), hth(nBins);
+	for(unsigned int i=0; i<nSamples; i++) {
+		hr2[unitBin(x[i]*x[i]+y[i]*y[i],nBins)]++;
+		hth[unitBin(0.5+0.5*atan2(y[i],x[i])/M_PI,nBins)]++;
+	}
+	const double nsDisk = 1e9*std::chrono::duration<double>(t1-t0).count()/nSamples;
+	const double nsRej = 1e9*std::chrono::duration<double>(t2-t1).count()/nSamples;
+	printf("  disk:       %.2f ns/sample (rejection %.2f ns, %.3f tries, x%.2f); chi2/ndf r^2 %.3f, angle %.3f (checksum %g)\n",
+		   nsDisk,nsRej,double(nTries)/nSamples,nsDisk>0?nsRej/nsDisk:0.,flatChi2(hr2,nSamples),flatChi2(hth,nSamples),sumRej);
+	
+	// cylinder: as disk, plus flat along the axis
+	t0 = std::chrono::steady_clock::now();
+	uniformCylinder(nSamples,&u[0],&v[0],&w[0],1.,2.,&x[0],&y[0],&z[0]);
+	t1 = std::chrono::steady_clock::now();
+	std::vector<unsigned int> hcr2(nBins), hcz(nBins);
+	for(unsigned int i=0; i<nSamples; i++) {
+		hcr2[unitBin(x[i]*x[i]+y[i]*y[i],nBins)]++;
+		hcz[unitBin(0.5*(z[i]+1),nBins)]++;
+	}
+	const double nsCyl = 1e9*std::chrono::duration<double>(t1-t0).count()/nSamples;
+	printf("  cylinder:   %.2f ns/sample; chi2/ndf r^2 %.3f, z %.3f\n",nsCyl,flatChi2(hcr2,nSamples),flatChi2(hcz,nSamples));
+}
+
+void mi_gfbench(StreamInteractor* S) {
+	
+	// load arguments
+	const double nMean = S->popFloat();
+	const unsigned int nClusters = S->popInt();
+	const std::string fname = S->popString();
+	
+	// text parsing, cache build, cached load
+	const char* labels[3] = {"text","cache build","cached"};
+	double ms[3];
+	GammaForest* GF = NULL;
+	for(int i=0; i<3; i++) {
+		QFile::useBinaryCache = (i>0);
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		delete GF;
+		GF = new GammaForest(fname);
+		ms[i] = 1e3*std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	}
+	QFile::useBinaryCache = true;
+	for(int i=0; i<3; i++) printf("GammaForest load, %s: %.2f ms\n",labels[i],ms[i]);
+	
+	// per-cluster generation into event vectors, vs. batches into preallocated buffers
+	TRandom3 R(1);
+	std::vector<NucDecayEvent> v;
+	size_t nSingle = 0;
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for(unsigned int c=0; c<nClusters; c++) {
+		v.clear();
+		GF->genDecays(v,nMean,&R);
+		nSingle += v.size();
+	}
+	const double tSingle = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+	const unsigned int batch = 4096;
+	std::vector<unsigned int> nGam(batch);
+	std::vector<double> E(size_t(batch*(nMean+1)));
+	std::map<double,unsigned int> counts;
+	size_t nBatch = 0;
+	double tBatch = 0;
+	for(unsigned int c=0; c<nClusters;) {
+		t0 = std::chrono::steady_clock::now();
+		unsigned int nc = GF->genClusters(std::min(batch,nClusters-c),nMean,&nGam[0],&E[0],E.size(),&R);
+		tBatch += std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+		if(!nc) break;
+		size_t ng = 0;
+		for(unsigned int i=0; i<nc; i++) ng += nGam[i];
+		for(size_t i=0; i<ng; i++) counts[E[i]]++;
+		nBatch += ng;
+		c += nc;
+	}
+	
+	// line frequencies against cross sections, lines of equal energy combined
+	std::map<double,double> expected;
+	for(unsigned int i=0; i<GF->getN(); i++) expected[GF->getE(i)] += nBatch*GF->getProb(i);
+	double chi2 = 0;
+	unsigned int ndf = 0;
+	for(std::map<double,double>::const_iterator it = expected.begin(); it != expected.end(); it++) {
+		if(it->second <= 0) continue;
+		chi2 += pow(counts[it->first]-it->second,2)/it->second;
+		ndf++;
+	}
+	const double nsSingle = nSingle ? 1e9*tSingle/nSingle : 0;
+	const double nsBatch = nBatch ? 1e9*tBatch/nBatch : 0;
+	printf("%i clusters of mean multiplicity %g:\n",nClusters,nMean);
+	printf("  per cluster: %.2f ns/gamma, %.4f gammas/cluster\n",nsSingle,double(nSingle)/nClusters);
+	printf("  batched:     %.2f ns/gamma, %.4f gammas/cluster (x%.2f); chi2/ndf of lines %.3f\n",
+		   nsBatch,double(nBatch)/nClusters,nsBatch>0?nsSingle/nsBatch:0.,ndf>1?chi2/(ndf-1):0.);
+	delete GF;
+}
 
 int main(int argc, char *argv[]) {
 
@@ -122,10 +610,63 @@ int main(int argc, char *argv[]) {
 	run_evt_gen.addArg(&selectRandomType);
 	run_evt_gen.addArg("Events per TTree","10000");
 	run_evt_gen.addArg("N. TTrees","100");
+	
+	// event generator for part of a set of trees, e.g. one of several parallel jobs
+	InputRequester run_evt_gen_part("Run event generator for some of the trees",&mi_evtgen_part);
+	run_evt_gen_part.addArg("Generator name");
+	run_evt_gen_part.addArg("Output path", "~/Documents/Caltech/UCNA_Sim/XSun_ucna_G4Sim/");
+	run_evt_gen_part.addArg(&selectVertexPos);
+	run_evt_gen_part.addArg(&selectRandomType);
+	run_evt_gen_part.addArg("Events per TTree","10000");
+	run_evt_gen_part.addArg("First TTree","0");
+	run_evt_gen_part.addArg("N. TTrees","10");
 		
+	// probability selector benchmark
+	InputRequester sel_bench("Benchmark line selection",&mi_selbench);
+	sel_bench.addArg("N. lines","10000");
+	sel_bench.addArg("N. samples","10000000");
+	
+	// multi-threaded decay generation check
+	InputRequester mt_stress("Multi-threaded generation check",&mi_mtstress);
+	mt_stress.addArg("Generator name");
+	mt_stress.addArg("N. threads","8");
+	mt_stress.addArg("Events per thread","100000");
+	
+	// decay data loading benchmark
+	InputRequester load_bench("Benchmark generator construction",&mi_loadbench);
+	load_bench.addArg("Generator name");
+	
+	// event file scanning check
+	InputRequester scan_bench("Check indexed event file reading",&mi_scanbench);
+	scan_bench.addArg("Event file(s)");
+	scan_bench.addArg("N. parts","4");
+	
+	// compact event file conversion
+	InputRequester compact("Convert event TTree to compact file",&mi_compact);
+	compact.addArg("Event TTree file");
+	compact.addArg("Compression level (0 for raw)","1");
+	
+	// sampling kernel check and benchmark
+	InputRequester kernel_bench("Check and benchmark sampling kernels",&mi_kernelbench);
+	kernel_bench.addArg("N. samples","10000000");
+	
+	// gamma forest loading and sampling benchmark
+	InputRequester gf_bench("Benchmark gamma forest loading and sampling",&mi_gfbench);
+	gf_bench.addArg("Gamma list file");
+	gf_bench.addArg("N. clusters","1000000");
+	gf_bench.addArg("Mean multiplicity","2.5");
+	
 	// main menu
 	OptionsMenu OM("Event Generator Menu");
 	OM.addChoice(&run_evt_gen,"run");
+	OM.addChoice(&run_evt_gen_part,"runpart");
+	OM.addChoice(&sel_bench,"selbench");
+	OM.addChoice(&mt_stress,"mtstress");
+	OM.addChoice(&load_bench,"loadbench");
+	OM.addChoice(&scan_bench,"scanbench");
+	OM.addChoice(&compact,"compact");
+	OM.addChoice(&kernel_bench,"kernelbench");
+	OM.addChoice(&gf_bench,"gfbench");
 	OM.addChoice(&exitMenu,"x");
 	
 	// load command line arguments
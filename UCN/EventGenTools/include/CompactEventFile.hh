@@ -0,0 +1,117 @@
+#ifndef COMPACTEVENTFILE_HH
+#define COMPACTEVENTFILE_HH
+
+#include "NuclEvtGen.hh"
+#include "QFile.hh"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <fstream>
+
+/// one primary particle in a compact event file (32 bytes, vs. 80 per TTree entry before compression)
+struct CompactPrimary {
+	float E;		///< kinetic energy [keV]
+	float x[3];		///< vertex position
+	float t;		///< time
+	float w;		///< weight
+	int16_t p[2];	///< momentum direction, octahedral map quantized to 1/32767 (< 1e-4 rad)
+	int8_t d;		///< particle type (DecayType)
+	uint8_t deid;	///< event number step from the previous primary; 0 continues its event
+	uint16_t reserved;
+};
+
+/// pack an event into the compact record (deid left to the caller)
+void packPrimary(const NucDecayEvent& e, CompactPrimary& c);
+/// unpack a compact record
+void unpackPrimary(const CompactPrimary& c, unsigned int eid, NucDecayEvent& e);
+
+/// Writer for compact primary-event files: blocks of whole events, each stored raw or
+/// zlib-compressed, followed by the generator metadata and a block table.
+/// Event numbers are delta-coded within a block; a block starts a new one when an event
+/// number does not increase by 1-255.
+class CompactEventWriter {
+public:
+	/// constructor; cxlevel 0 stores the records raw, for zero-copy reading
+	CompactEventWriter(const std::string& fname, const Stringmap& meta, int cxlevel = 1, unsigned int blockSize = 4096);
+	/// destructor; closes the file if still open, printing rather than throwing write errors
+	~CompactEventWriter();
+	/// add one event's primaries (event number from the first)
+	void addEvt(const std::vector<NucDecayEvent>& v);
+	/// write remaining block, metadata and block table; throws SMExcept on write errors
+	void close();
+
+protected:
+	/// write out current block
+	void flushBlock();
+	/// throw SMExcept "fileWriteFailed" if a write failed
+	void checkStream(const std::string& stage);
+
+	std::string fname;					///< output file name
+	std::ofstream fout;					///< output file
+	Stringmap meta;						///< generator metadata
+	int cxlevel;						///< zlib compression level
+	unsigned int blockSize;				///< primaries per block (events are not split)
+	std::vector<CompactPrimary> block;	///< current block
+	uint32_t eid0;						///< first event number in current block
+	uint32_t lastEid;					///< previous event number
+	uint32_t blockEvents;				///< events in current block
+	std::vector<uint64_t> offsets;		///< block offsets
+	uint64_t nPrimaries;				///< primaries written
+	uint64_t nEvents;					///< events written
+};
+
+/// Reader for compact primary-event files, memory-mapped. Blocks stored raw are used in place,
+/// compressed blocks are inflated one at a time into a buffer; use one reader per thread.
+/// Opening checks the byte order, the block sizes and the totals; each block's event count is
+/// checked against its records when the block is read. Damaged files throw SMExcept "badEventFile".
+class CompactEventFile {
+public:
+	/// constructor
+	CompactEventFile(const std::string& fname);
+	/// destructor
+	~CompactEventFile();
+
+	/// generator metadata
+	const Stringmap& getMeta() const { return meta; }
+	/// number of blocks
+	unsigned int getNBlocks() const { return nBlocks; }
+	/// number of primaries
+	uint64_t getNPrimaries() const { return nPrimaries; }
+	/// number of events
+	uint64_t getNEvents() const { return nEvents; }
+	/// records of block b, with their number and the first event number
+	const CompactPrimary* getBlock(unsigned int b, unsigned int& n, uint32_t& blockEid0);
+
+	/// load next event of the selected part into vector, wrapping around at its end; return number of primaries
+	unsigned int loadEvt(std::vector<NucDecayEvent>& v);
+	/// restrict loadEvt to part p of nP shares of the blocks
+	void selectPart(unsigned int p, unsigned int nP);
+
+	bool firstpass;	///< whether read is on first pass through data
+
+protected:
+	/// position at start of block b
+	void startBlock(unsigned int b);
+	/// throw SMExcept "badEventFile" for block b
+	void badBlock(unsigned int b);
+
+	std::string fname;				///< file name
+	const char* mapped;				///< mapped file
+	size_t mapSize;					///< mapped size
+	Stringmap meta;					///< generator metadata
+	unsigned int nBlocks;			///< number of blocks
+	uint64_t nPrimaries;			///< number of primaries
+	uint64_t nEvents;				///< number of events
+	const uint64_t* offsets;		///< block offsets, in the map
+	std::vector<CompactPrimary> buf;	///< inflated block
+	unsigned int bufBlock;			///< block held in buf
+
+	unsigned int b0, b1;			///< selected blocks
+	unsigned int curBlock;			///< block being read
+	const CompactPrimary* recs;		///< its records
+	unsigned int nRecs;				///< number of records
+	unsigned int nextRec;			///< next record
+	uint32_t eid;					///< current event number
+};
+
+#endif
@@ -14,33 +14,47 @@
 #include <map>
 #include <set>
 #include <climits>
+#include <mutex>
 #include <float.h>
 #include <stdio.h>
 
+class TRandom;
+
 /// random event selector
 class PSelector {
 public:
 	/// constructor
 	PSelector() { cumprob.push_back(0); }
-	/// add a probability
-	void addProb(double p) { cumprob.push_back(p+cumprob.back()); }
-	/// select partition for given input (random if not specified); re-scale input to partition range to pass along to sub-selections
-	unsigned int select(double* x = NULL) const;
+	/// add a probability (drops any alias table)
+	void addProb(double p) { cumprob.push_back(p+cumprob.back()); aliasProb.clear(); alias.clear(); }
+	/// select partition for given input (random from R, or gRandom, if not specified); re-scale input to partition range to pass along to sub-selections.
+	/// Random selections use the alias table when built; given inputs always use binary search, to keep the remaining fraction.
+	unsigned int select(double* x = NULL, TRandom* R = NULL) const;
+	/// build Walker/Vose alias table for O(1) random selection
+	void buildAlias();
+	/// whether an alias table is available
+	bool hasAlias() const { return !alias.empty(); }
+	/// alias table probability of keeping column i's own item
+	double getAliasProb(unsigned int i) const { return aliasProb[i]; }
+	/// alias table other item in column i
+	unsigned int getAlias(unsigned int i) const { return alias[i]; }
 	/// get cumulative probability
 	double getCumProb() const { return cumprob.back(); }
 	/// get number of items
 	unsigned int getN() const { return cumprob.size()-1; }
 	/// get probability of numbered item
 	double getProb(unsigned int n) const;
-	/// scale all probabilities
+	/// scale all probabilities (the alias table is normalized and stays valid)
 	void scale(double s);
 		
 protected:
 	std::vector<double> cumprob;	///< cumulative probabilites
+	std::vector<double> aliasProb;	///< alias table: probability of keeping each column's own item
+	std::vector<unsigned int> alias;	///< alias table: other item in each column
 };
 
-/// generate an isotropic random direction, from optional random in [0,1]^2
-void randomDirection(double& x, double& y, double& z, double* rnd = NULL);
+/// generate an isotropic random direction, from optional random in [0,1]^2 (else from R, or gRandom)
+void randomDirection(double& x, double& y, double& z, double* rnd = NULL, TRandom* R = NULL);
 
 /// Nuclear energy level
 class NucLevel {
@@ -85,7 +99,7 @@ public:
 	/// constructor
 	NucDecayEvent(): eid(0), E(0), d(D_NONEVENT), t(0), w(1.) {}
 	/// randomize momentum direction
-	void randp(double* rnd = NULL) { randomDirection(p[0],p[1],p[2],rnd); }
+	void randp(double* rnd = NULL, TRandom* R = NULL) { randomDirection(p[0],p[1],p[2],rnd,R); }
 	
 	unsigned int eid;	///< event ID number
 	double E;			///< particle energy
@@ -104,7 +118,7 @@ public:
 	/// load Auger data from Stringmap
 	void load(const Stringmap& m);
 	/// generate Auger K probabilistically
-	void genAuger(std::vector<NucDecayEvent>& v);
+	void genAuger(std::vector<NucDecayEvent>& v, TRandom* R = NULL) const;
 	/// display info
 	void display(bool verbose = false) const;
 	
@@ -127,8 +141,8 @@ public:
 	/// display transition line info
 	virtual void display(bool verbose = false) const;
 	
-	/// select transition outcome
-	virtual void run(std::vector<NucDecayEvent>&, double* = NULL) { }
+	/// select transition outcome; returns number of K shell vacancies left behind
+	virtual unsigned int run(std::vector<NucDecayEvent>&, double* = NULL, TRandom* = NULL) const { return 0; }
 	
 	/// return number of continuous degrees of freedom needed to specify transition
 	virtual unsigned int getNDF() const { return 2; }
@@ -138,8 +152,6 @@ public:
 	
 	/// get probability of removing an electron from a given shell
 	virtual double getPVacant(unsigned int) const { return 0; }
-	/// how many of given electron type were knocked out
-	virtual unsigned int nVacant(unsigned int) const { return 0; }
 	
 	DecayAtom* toAtom;	///< final state atom info
 	NucLevel& from;	///< level this transition is from
@@ -154,15 +166,13 @@ public:
 	/// constructor
 	ConversionGamma(NucLevel& f, NucLevel& t, const Stringmap& m);
 	/// select transition outcome
-	virtual void run(std::vector<NucDecayEvent>& v, double* rnd = NULL);
+	virtual unsigned int run(std::vector<NucDecayEvent>& v, double* rnd = NULL, TRandom* R = NULL) const;
 	/// display transition line info
 	virtual void display(bool verbose = false) const;
 	/// get total conversion efficiency
 	double getConversionEffic() const;
 	/// get probability of knocking conversion electron from a given shell
 	virtual double getPVacant(unsigned int n) const { return n<shells.getN()-1?shells.getProb(n):0; }
-	/// get whether said electron was knocked out
-	virtual unsigned int nVacant(unsigned int n) const { return int(n)==shell; }
 	/// shell weighted average energy
 	double shellAverageE(unsigned int n) const;
 	/// line weighted average
@@ -171,8 +181,6 @@ public:
 	virtual void scale(double s);
 	
 	double Egamma;		///< gamma energy
-	int shell;			///< selected conversion electron shell
-	int subshell;		///< selected conversion electron subshell
 	double Igamma;		///< total gamma intensity
 	
 protected:
@@ -187,18 +195,14 @@ public:
 	/// constructor
 	ECapture(NucLevel& f, NucLevel& t): TransitionBase(f,t) {}
 	/// select transition outcome
-	virtual void run(std::vector<NucDecayEvent>&, double* rnd = NULL);
+	virtual unsigned int run(std::vector<NucDecayEvent>&, double* rnd = NULL, TRandom* R = NULL) const;
 	/// display transition line info
 	virtual void display(bool verbose = false) const { printf("Ecapture "); TransitionBase::display(verbose); }
 	/// get probability of removing an electron from a given shell
 	virtual double getPVacant(unsigned int n) const { return n==0?toAtom->IMissing:0; }
-	/// get whether said electron was knocked out
-	virtual unsigned int nVacant(unsigned int n) const { return n==0?isKCapt:0; }
 	
 	/// return number of continuous degrees of freedom needed to specify transition
 	virtual unsigned int getNDF() const { return 0; }
-	
-	bool isKCapt;	///< whether transition was a K capture
 };
 
 /// beta decay transitions
@@ -209,7 +213,7 @@ public:
 	/// destructor
 	~BetaDecayTrans();
 	/// select transition outcome
-	virtual void run(std::vector<NucDecayEvent>& v, double* rnd = NULL);
+	virtual unsigned int run(std::vector<NucDecayEvent>& v, double* rnd = NULL, TRandom* R = NULL) const;
 	/// display transition line info
 	virtual void display(bool verbose = false) const;
 	
@@ -243,8 +247,9 @@ public:
 	void displayTransitions(bool verbose = false) const;
 	/// display list of atoms
 	void displayAtoms(bool verbose = false) const;
-	/// generate a chain of decay events starting from level n
-	void genDecayChain(std::vector<NucDecayEvent>& v, double* rnd = NULL, unsigned int n = UINT_MAX);
+	/// generate a chain of decay events starting from level n, from the random inputs rnd (else from R, or gRandom);
+	/// re-entrant: any number of threads may sample one system, each with its own R
+	void genDecayChain(std::vector<NucDecayEvent>& v, double* rnd = NULL, TRandom* R = NULL, unsigned int n = UINT_MAX) const;
 	/// rescale all probabilities
 	void scale(double s);
 	
@@ -274,7 +279,8 @@ protected:
 	std::vector< std::vector<TransitionBase*> > transOut;	///< transitions out of each level
 };
 
-/// manager for loading decay event generators
+/// manager for loading decay event generators; each generator is built once, on first request,
+/// and handed out read-only, so any number of threads can share the library and its generators
 class NucDecayLibrary {
 public:
 	/// constructor
@@ -283,8 +289,13 @@ public:
 	~NucDecayLibrary();
 	/// check if generator is available
 	bool hasGenerator(const std::string& nm);
-	/// get decay generator by name
-	NucDecaySystem& getGenerator(const std::string& nm);
+	/// get decay generator by name (thread-safe)
+	const NucDecaySystem& getGenerator(const std::string& nm);
+	
+	/// process-wide library: data from defaultDataPath(), 1 us cutoff
+	static NucDecayLibrary& shared();
+	/// decay data directory: $UCNA_DECAY_DATA, default the source tree's ExtraFiles; a leading '~' is $HOME
+	static std::string defaultDataPath();
 	
 	std::string datpath;	///< path to data folder
 	double tcut;			///< event generator default cutoff time
@@ -293,20 +304,49 @@ public:
 protected:
 	std::map<std::string,NucDecaySystem*> NDs;	///< loaded decay systems
 	std::set<std::string> cantdothis;			///< list of decay systems that can't be loaded
+	std::mutex lock;							///< guards NDs and cantdothis; held while a generator is built
 };
 
 /// class for throwing from large list of gammas
 class GammaForest {
 public:
-	/// constructor
-	GammaForest(const std::string& fname, double E2keV = 1000);
+	/// constructor; cached loads read the (energy, cross section) table from a binary <file>.gfcache (in QFile::cacheDir)
+	GammaForest(const std::string& fname, double E2keV = 1000, bool cached = true);
 	/// get total cross section
 	double getCrossSection() const { return gammaProb.getCumProb(); }
+	/// get number of gamma lines
+	unsigned int getN() const { return gammaE.size(); }
+	/// get energy of numbered line
+	double getE(unsigned int i) const { return gammaE[i]; }
+	/// get probability of numbered line
+	double getProb(unsigned int i) const { return gammaProb.getProb(i); }
+	
+	/// number of gammas in a cluster with mean multiplicity n: floor(n), plus one with probability n-floor(n)
+	unsigned int genMultiplicity(double n, TRandom* R = NULL) const;
+	/// energy of one gamma for uniform random u in [0,1)
+	double sampleE(double u) const;
 	/// generate cluster of gamma decays
-	void genDecays(std::vector<NucDecayEvent>& v, double n = 1.0);
+	void genDecays(std::vector<NucDecayEvent>& v, double n = 1.0, TRandom* R = NULL) const;
+	/// generate up to nClusters clusters into preallocated buffers: multiplicities in nGam[nClusters], energies
+	/// cluster after cluster in E[maxGammas]; stops before the cluster that would overflow E. Returns number of clusters.
+	unsigned int genClusters(unsigned int nClusters, double n, unsigned int* nGam, double* E, size_t maxGammas, TRandom* R = NULL) const;
+	
 protected:
-	std::vector<double> gammaE;	///< gamma energies
-	PSelector gammaProb;		///< gamma probabilities selector
+	/// load table from binary cache of fname, if it matches the file's size and modification time
+	bool readCache(const std::string& fname, std::vector<double>& E, std::vector<double>& P) const;
+	/// write binary cache of fname
+	void writeCache(const std::string& fname, const std::vector<double>& E, const std::vector<double>& P) const;
+	
+	/// alias table column: keep own line's energy with probability keep, else the alias line's
+	struct AliasColumn {
+		double keep;	///< probability of own line
+		double E;		///< own line energy
+		double Ealias;	///< alias line energy
+	};
+	
+	std::vector<double> gammaE;			///< gamma energies
+	PSelector gammaProb;				///< gamma probabilities selector
+	std::vector<AliasColumn> aliasE;	///< alias table over energies, for one-lookup sampling
 };
 
 //------------------------------------------------------------------------------
@@ -367,15 +407,31 @@ public:
 //------------------------------------------------------------------------------
 
 
-/// class for reading events trees
+/// class for reading events trees. Events are located through the group index of their
+/// "num" branch, so each read touches exactly its own entries, any event can be sought directly,
+/// and the events can be split exactly between workers (e.g. one part per job).
 class EventTreeScanner: protected TChainScanner {
 public:
 	/// constructor
-	EventTreeScanner(): TChainScanner("Evts") {}
+	EventTreeScanner(): TChainScanner("Evts"), firstpass(true), part(0), nParts(1), nextEvt(UINT_MAX) {}
 	/// add a file to the TChain
 	virtual int addFile(const std::string& filename);
-	/// load next event into vector; return number of primaries
+	/// load next event of the selected part into vector, wrapping around at its end; return number of primaries
 	unsigned int loadEvt(std::vector<NucDecayEvent>& v);
+	/// load event k (counted over all files) into vector; return number of primaries
+	unsigned int readEvt(std::vector<NucDecayEvent>& v, unsigned int k);
+	/// continue loadEvt from event k (within the selected part)
+	void seekEvent(unsigned int k);
+	/// restrict loadEvt to part p of nP equal, disjoint shares of the events
+	void selectPart(unsigned int p, unsigned int nP);
+	/// total number of events in all files
+	unsigned int getnEvts() { return getnGroups(); }
+	/// first event of the selected part
+	unsigned int partStart() { return (unsigned long long)getnGroups()*part/nParts; }
+	/// end of the selected part
+	unsigned int partEnd() { return (unsigned long long)getnGroups()*(part+1)/nParts; }
+	
+	using TChainScanner::printCacheStats;
 
 	bool firstpass;	///< whether read is on first pass through data
 	
@@ -383,8 +439,10 @@ protected:
 	/// set tree readpoints
 	virtual void setReadpoints();
 
-	NucDecayEvent evt;	///< event readpoint
-	unsigned int prevN;	///< previous event number
+	NucDecayEvent evt;		///< event readpoint
+	unsigned int part;		///< selected part
+	unsigned int nParts;	///< number of parts
+	unsigned int nextEvt;	///< next event for loadEvt; outside the part for its start
 };
 
 #endif
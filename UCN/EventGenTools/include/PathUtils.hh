@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
 
 /// check if file exists
 bool fileExists(std::string f);
@@ -14,6 +15,8 @@ void makePath(std::string p, bool forFile = false);
 std::vector<std::string> listdir(const std::string& dir, bool includeHidden = false);
 /// get time since last file modification (s)
 double fileAge(const std::string& fname);
+/// modification time [ns since epoch] and size of a file, to tell when caches derived from it are stale; false if missing
+bool fileStamp(const std::string& fname, int64_t& mtime, int64_t& size);
 /// get environment variable, with default or fail if missing
 std::string getEnvSafe(const std::string& v, const std::string& dflt = "FAIL_IF_MISSING");
 
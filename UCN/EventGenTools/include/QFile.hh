@@ -52,10 +52,15 @@ public:
 	
 	std::multimap< std::string, std::string > dat;	///< key-value multimap
 	
+	/// set pre-converted value of a key's first entry (from QFile binary caches)
+	void setNumeric(const std::string& str, double d) { numcache[str] = d; }
+	
 protected:
 	
 	/// merge data into another stringmap
 	void mergeInto(Stringmap& S) const;
+	
+	std::map<std::string, double> numcache;	///< pre-converted first values for getDefault
 };
 
 /// base class for objects that provide stringmaps
@@ -90,8 +95,8 @@ protected:
 class QFile {
 public:
 	
-	/// constructor given a string
-	QFile(const std::string& s = "", bool readit = true);
+	/// constructor given a string; optionally read through the file's binary cache
+	QFile(const std::string& s = "", bool readit = true, bool cached = false);
 	
 	/// insert key/(string)value pair
 	void insert(const std::string& str, const Stringmap& v);
@@ -123,9 +128,22 @@ public:
 	
 	/// convert to RData format
 	//RData* toRData() const;
+	
+	/// whether cached reads use compiled binary caches (<file>.qcache in cacheDir, rebuilt when the file changes)
+	static bool useBinaryCache;
+	/// directory for the binary caches: $UCNA_QCACHE_DIR (e.g. under /dev/shm, so that they are built once
+	/// per node and read from memory), else $XDG_CACHE_HOME/ucna or ~/.cache/ucna; empty for next to each file
+	static std::string cacheDir;
+	/// binary cache file name for fname, also used by other compiled data caches with their own extension
+	static std::string cacheName(const std::string& fname, const std::string& ext = ".qcache");
 
 protected:
 	
+	/// load from the binary cache of fname, if it matches the file's size and modification time
+	bool readCache(const std::string& fname);
+	/// write the binary cache of fname, with numeric values pre-converted
+	void writeCache(const std::string& fname) const;
+	
 	std::string name;								///< name for this object
 	std::multimap< std::string, Stringmap > dat;	///< key-value multimap
 
@@ -0,0 +1,23 @@
+#ifndef SAMPLINGKERNELS_HH
+#define SAMPLINGKERNELS_HH
+
+/// \file SamplingKernels.hh \brief batched, rejection-free direction and position sampling
+/// Each kernel maps n sets of uniform random numbers in [0,1] (one array per random DF,
+/// so quasi-random dimensions keep their meaning) onto n samples, without rejection.
+/// Blocks are processed with SSE2/AVX when available, sin/cos by polynomial rather than libm.
+/// Used by the EventGenTools position generators and the Geant4 primary generator.
+
+/// isotropic unit vectors: cos theta = 2u-1, phi = 2 pi v (as randomDirection)
+void isotropicDirections(unsigned int n, const double* u, const double* v, double* x, double* y, double* z);
+/// uniform points in a disk of radius r around the origin: angle 2 pi a, radius r sqrt(b) (as square2circle)
+void uniformDisk(unsigned int n, const double* a, const double* b, double r, double* x, double* y);
+/// uniform points in a cylinder of radius r and length dz centered on the origin, axis along z
+void uniformCylinder(unsigned int n, const double* a, const double* b, const double* c, double r, double dz,
+					 double* x, double* y, double* z);
+/// sin and cos of 2 pi u for n values of u in [0,1]
+void sinCos2Pi(unsigned int n, const double* u, double* s, double* c);
+
+/// number of values the kernels process at once
+unsigned int samplingLanes();
+
+#endif
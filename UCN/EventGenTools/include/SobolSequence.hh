@@ -0,0 +1,38 @@
+#ifndef SOBOLSEQUENCE_HH
+#define SOBOLSEQUENCE_HH
+
+#include <stdint.h>
+#include <vector>
+
+/// Sobol low-discrepancy sequence in any number of dimensions, optionally randomized by a
+/// random linear matrix scramble plus digital shift (Matousek), which keeps the net structure.
+/// Points are generated in Gray-code order; skipTo jumps to any point in O(log n) per dimension,
+/// so trees, threads or jobs can each take a disjoint block of one sequence.
+/// Dimensions beyond the Joe-Kuo table (1025) use further primitive polynomials with
+/// pseudo-random initial direction numbers.
+class SobolSequence {
+public:
+	/// constructor; seed 0 for the plain (unscrambled) sequence
+	SobolSequence(unsigned int nd, uint32_t seed = 0);
+
+	/// number of dimensions
+	unsigned int getDim() const { return ndim; }
+	/// index of the next point
+	uint64_t getIndex() const { return index; }
+	/// jump to point n (n < 2^32)
+	void skipTo(uint64_t n);
+	/// fill x[getDim()] with the next point, in (0,1)
+	void next(double* x);
+
+protected:
+	/// direction numbers of dimension d
+	void makeDirections(unsigned int d, uint32_t* v) const;
+
+	unsigned int ndim;				///< number of dimensions
+	std::vector<uint32_t> V;		///< direction numbers (scrambled), V[32*d+k] for bit k of the Gray code
+	std::vector<uint32_t> shift;	///< digital shift of each dimension
+	std::vector<uint32_t> state;	///< current point, unshifted
+	uint64_t index;					///< index of next point
+};
+
+#endif
@@ -5,7 +5,12 @@
 #include <string>
 #include <vector>
 
-/// class for assembling and scanning a TChain
+/// class for assembling and scanning a TChain.
+/// Reads go through a TTreeCache holding only the branches given to SetBranchAddress,
+/// optionally (asyncPrefetch) with asynchronous prefetching of the next baskets. A subclass whose entries come
+/// in groups (e.g. all primaries of one event) names the branch identifying the group with
+/// setGroupBranch, and random starts then land on group boundaries. The group index of each
+/// file is kept as <file>.gidx in QFile::cacheDir and only rebuilt when the file changes.
 class TChainScanner {
 public:
 	/// constructor
@@ -36,23 +41,47 @@ public:
 	unsigned int getLocal(unsigned int e) { return Tch->LoadTree(e); }
 	/// get number of files
 	virtual unsigned int getnFiles() const { return nFiles; }
+	
+	/// number of entry groups (builds the group index on first use; 0 without a group branch)
+	unsigned int getnGroups();
+	/// first entry of group k; k = getnGroups() gives nEvents
+	Long64_t groupStart(unsigned int k);
+	/// jump scanner to first entry of group k
+	void gotoGroup(unsigned int k);
+	/// print TTreeCache efficiency and file read counts
+	void printCacheStats() const;
 		
 	UInt_t nEvents;						///< number of events in current TChain
 	
+	static Long64_t cacheSize;			///< TTreeCache size [bytes], 0 for no cache; set before adding files
+	static bool asyncPrefetch;			///< whether the cache prefetches asynchronously (off by default); set before adding files
+	static bool groupIndexFiles;		///< whether group indices are read from and saved to <file>.gidx caches
+	
 protected:
 	
 	/// over-write this in subclass to automaticlly set readout points on first loaded file
 	virtual void setReadpoints() {}
-	/// "string friendly" SetBranchAddress
+	/// "string friendly" SetBranchAddress; also adds the branch to the cache
 	void SetBranchAddress(const std::string& bname, void* bdata);
+	/// set branch whose value changes between entry groups
+	void setGroupBranch(const std::string& bname) { groupBranch = bname; groupIndex.clear(); }
+	/// set up the TTreeCache for the read branches
+	void configureCache();
+	/// (re)build group index
+	void indexGroups();
 	
-	std::vector<unsigned int> nnEvents;	///< number of events in each loaded TChain;
+	std::vector<unsigned int> nnEvents;	///< number of events in each chained file
+	std::vector<std::string> fileNames;	///< name of each chained file, wildcards expanded
 	unsigned int nFiles;				///< get number of loaded files
 	
 	TChain* Tch;						///< TChain of relevant runs
 	unsigned int currentEvent;			///< event number of current event in chain
 	unsigned int noffset;				///< offset of current event relative to currently loaded tree
 	unsigned int nLocalEvents;			///< number of events in currently loaded tree
+	
+	std::vector<std::string> readBranches;	///< branches read, cached
+	std::string groupBranch;			///< branch identifying entry groups
+	std::vector<Long64_t> groupIndex;	///< first entry of each group, plus nEvents at the end; empty until built
 };
 
 #endif
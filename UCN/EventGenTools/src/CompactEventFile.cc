@@ -0,0 +1,329 @@
+#include "CompactEventFile.hh"
+#include "SMExcept.hh"
+#include <cmath>
+#include <cstring>
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+/// file header; all offsets from the start of the file
+/// numbers are host-endian; byteOrder tells a file written on a host of the other order
+struct CompactFileHeader {
+	char magic[8];			///< "UCNCEVT2"
+	uint32_t byteOrder;		///< CEVT_BYTE_ORDER as written
+	uint32_t recordSize;	///< sizeof(CompactPrimary)
+	uint32_t nBlocks;		///< number of blocks
+	uint32_t reserved;
+	uint64_t nPrimaries;	///< number of primaries
+	uint64_t nEvents;		///< number of events
+	uint64_t metaOffset;	///< generator metadata (Stringmap string)
+	uint64_t metaBytes;		///< its length
+	uint64_t tableOffset;	///< block offsets
+};
+
+/// header before each block's records
+struct CompactBlockHeader {
+	uint32_t nPrimaries;	///< records in block
+	uint32_t nEvents;		///< events in block
+	uint32_t eid0;			///< event number of first record
+	uint32_t storedBytes;	///< bytes following the header
+	uint32_t compressed;	///< whether zlib-compressed
+	uint32_t reserved;
+};
+
+/// byte order marker value
+static const uint32_t CEVT_BYTE_ORDER = 0x01020304;
+
+/// pad output to 8 bytes, keeping records aligned in the map
+static void padTo8(std::ofstream& fout) {
+	static const char zeros[8] = {0,0,0,0,0,0,0,0};
+	uint64_t n = fout.tellp();
+	if(n%8) fout.write(zeros,8-n%8);
+}
+
+static double signNotZero(double x) { return x<0 ? -1 : 1; }
+
+void packPrimary(const NucDecayEvent& e, CompactPrimary& c) {
+	c.E = e.E;
+	for(unsigned int i=0; i<3; i++) c.x[i] = e.x[i];
+	c.t = e.t;
+	c.w = e.w;
+	c.d = e.d;
+	c.deid = 0;
+	c.reserved = 0;
+	// octahedral map: project onto |u|+|v|+|z|=1, fold the z<0 half outwards
+	double s = fabs(e.p[0])+fabs(e.p[1])+fabs(e.p[2]);
+	double u = s>0 ? e.p[0]/s : 0;
+	double v = s>0 ? e.p[1]/s : 0;
+	if(e.p[2] < 0) {
+		double u0 = u;
+		u = (1-fabs(v))*signNotZero(u0);
+		v = (1-fabs(u0))*signNotZero(v);
+	}
+	c.p[0] = (int16_t)floor(u*32767+0.5);
+	c.p[1] = (int16_t)floor(v*32767+0.5);
+}
+
+void unpackPrimary(const CompactPrimary& c, unsigned int eid, NucDecayEvent& e) {
+	e.eid = eid;
+	e.E = c.E;
+	for(unsigned int i=0; i<3; i++) e.x[i] = c.x[i];
+	e.t = c.t;
+	e.w = c.w;
+	e.d = DecayType(c.d);
+	double u = c.p[0]/32767.;
+	double v = c.p[1]/32767.;
+	double z = 1-fabs(u)-fabs(v);
+	if(z < 0) {
+		double u0 = u;
+		u = (1-fabs(v))*signNotZero(u0);
+		v = (1-fabs(u0))*signNotZero(v);
+	}
+	double r = sqrt(u*u+v*v+z*z);
+	e.p[0] = u/r;
+	e.p[1] = v/r;
+	e.p[2] = z/r;
+}
+
+//------------------------------------------------------------------------------
+
+CompactEventWriter::CompactEventWriter(const std::string& fn, const Stringmap& m, int cx, unsigned int bs):
+fname(fn), meta(m), cxlevel(cx), blockSize(bs), eid0(0), lastEid(0), blockEvents(0), nPrimaries(0), nEvents(0) {
+	fout.open(fname.c_str(),std::ios::binary);
+	if(!fout.good()) {
+		SMExcept e("fileUnwritable");
+		e.insert("filename",fname);
+		throw(e);
+	}
+	CompactFileHeader H;
+	memset(&H,0,sizeof(H));	// filled in by close()
+	fout.write((const char*)&H,sizeof(H));
+	checkStream("header");
+}
+
+CompactEventWriter::~CompactEventWriter() {
+	// destructors must not throw: report here, call close() to get the exception
+	try { close(); }
+	catch(SMExcept& e) { fprintf(stderr,"%s\n",e.what()); }
+}
+
+void CompactEventWriter::checkStream(const std::string& stage) {
+	if(fout.good()) return;
+	if(fout.is_open()) fout.close();	// the zeroed header marks the file unreadable
+	SMExcept e("fileWriteFailed");
+	e.insert("filename",fname);
+	e.insert("stage",stage);
+	throw(e);
+}
+
+void CompactEventWriter::addEvt(const std::vector<NucDecayEvent>& v) {
+	if(v.empty()) return;
+	const uint32_t e = v[0].eid;
+	if(!block.empty() && (block.size()+v.size() > blockSize || e <= lastEid || e-lastEid > 255))
+		flushBlock();
+	if(block.empty()) eid0 = e;
+	const uint8_t step = block.empty() ? 0 : e-lastEid;
+	CompactPrimary c;
+	for(unsigned int i=0; i<v.size(); i++) {
+		packPrimary(v[i],c);
+		c.deid = i ? 0 : step;
+		block.push_back(c);
+	}
+	lastEid = e;
+	blockEvents++;
+	nEvents++;
+	nPrimaries += v.size();
+}
+
+void CompactEventWriter::flushBlock() {
+	if(block.empty()) return;
+	CompactBlockHeader B;
+	memset(&B,0,sizeof(B));
+	B.nPrimaries = block.size();
+	B.nEvents = blockEvents;
+	B.eid0 = eid0;
+	const uLong rawBytes = block.size()*sizeof(CompactPrimary);
+	std::vector<Bytef> packed;
+	if(cxlevel > 0) {
+		uLongf n = compressBound(rawBytes);
+		packed.resize(n);
+		if(compress2(&packed[0],&n,(const Bytef*)&block[0],rawBytes,cxlevel) == Z_OK && n < rawBytes) packed.resize(n);
+		else packed.clear();
+	}
+	B.compressed = !packed.empty();
+	B.storedBytes = B.compressed ? packed.size() : rawBytes;
+
+	offsets.push_back(fout.tellp());
+	fout.write((const char*)&B,sizeof(B));
+	if(B.compressed) fout.write((const char*)&packed[0],packed.size());
+	else fout.write((const char*)&block[0],rawBytes);
+	padTo8(fout);
+	block.clear();
+	blockEvents = 0;
+	checkStream("block");
+}
+
+void CompactEventWriter::close() {
+	if(!fout.is_open()) return;
+	flushBlock();
+	CompactFileHeader H;
+	memset(&H,0,sizeof(H));
+	memcpy(H.magic,"UCNCEVT2",8);
+	H.byteOrder = CEVT_BYTE_ORDER;
+	H.recordSize = sizeof(CompactPrimary);
+	H.nBlocks = offsets.size();
+	H.nPrimaries = nPrimaries;
+	H.nEvents = nEvents;
+	std::string m = meta.toString();
+	H.metaOffset = fout.tellp();
+	H.metaBytes = m.size();
+	fout.write(m.data(),m.size());
+	padTo8(fout);
+	H.tableOffset = fout.tellp();
+	if(!offsets.empty()) fout.write((const char*)&offsets[0],offsets.size()*sizeof(uint64_t));
+	checkStream("index");
+	fout.seekp(0);
+	fout.write((const char*)&H,sizeof(H));
+	checkStream("header");
+	fout.close();
+	checkStream("close");
+}
+
+//------------------------------------------------------------------------------
+
+CompactEventFile::CompactEventFile(const std::string& fn): firstpass(true), fname(fn), mapped(NULL), mapSize(0),
+nBlocks(0), nPrimaries(0), nEvents(0), offsets(NULL), bufBlock(UINT_MAX), b0(0), b1(0), curBlock(UINT_MAX),
+recs(NULL), nRecs(0), nextRec(0), eid(0) {
+	struct stat st;
+	int fd = open(fname.c_str(),O_RDONLY);
+	if(fd < 0 || fstat(fd,&st)) {
+		if(fd >= 0) ::close(fd);
+		SMExcept e("fileUnreadable");
+		e.insert("filename",fname);
+		throw(e);
+	}
+	mapSize = st.st_size;
+	void* m = mapSize >= sizeof(CompactFileHeader) ? mmap(NULL,mapSize,PROT_READ,MAP_PRIVATE,fd,0) : MAP_FAILED;
+	::close(fd);
+
+	CompactFileHeader H;
+	bool ok = (m != MAP_FAILED);
+	if(ok) {
+		mapped = (const char*)m;
+		memcpy(&H,mapped,sizeof(H));
+		ok = !memcmp(H.magic,"UCNCEVT2",8) && H.byteOrder == CEVT_BYTE_ORDER && H.recordSize == sizeof(CompactPrimary)
+			&& H.metaOffset+H.metaBytes <= mapSize && H.tableOffset+H.nBlocks*sizeof(uint64_t) <= mapSize;
+	}
+	if(ok) {
+		// every block inside the map, raw blocks holding exactly their records, and the totals adding up
+		offsets = (const uint64_t*)(mapped+H.tableOffset);
+		uint64_t sumPrimaries = 0, sumEvents = 0;
+		for(unsigned int b=0; ok && b<H.nBlocks; b++) {
+			ok = offsets[b]%8 == 0 && offsets[b]+sizeof(CompactBlockHeader) <= mapSize;
+			if(ok) {
+				const CompactBlockHeader* B = (const CompactBlockHeader*)(mapped+offsets[b]);
+				ok = B->nPrimaries && B->nEvents && B->nEvents <= B->nPrimaries
+					&& offsets[b]+sizeof(CompactBlockHeader)+B->storedBytes <= mapSize
+					&& (B->compressed || B->storedBytes == (uint64_t)B->nPrimaries*sizeof(CompactPrimary));
+				sumPrimaries += B->nPrimaries;
+				sumEvents += B->nEvents;
+			}
+		}
+		ok = ok && sumPrimaries == H.nPrimaries && sumEvents == H.nEvents;
+	}
+	if(!ok) {
+		if(mapped) munmap((void*)mapped,mapSize);
+		mapped = NULL;
+		SMExcept e("badEventFile");
+		e.insert("filename",fname);
+		throw(e);
+	}
+	meta += Stringmap(std::string(mapped+H.metaOffset,H.metaBytes));
+	nBlocks = H.nBlocks;
+	nPrimaries = H.nPrimaries;
+	nEvents = H.nEvents;
+	b1 = nBlocks;
+}
+
+CompactEventFile::~CompactEventFile() {
+	if(mapped) munmap((void*)mapped,mapSize);
+}
+
+/// whether n records hold nEvents events: the first starts one, every later nonzero step another
+static bool blockEventsMatch(const CompactPrimary* r, unsigned int n, unsigned int nEvents) {
+	if(r[0].deid) return false;
+	unsigned int k = 1;
+	for(unsigned int i=1; i<n; i++) k += (r[i].deid != 0);
+	return k == nEvents;
+}
+
+void CompactEventFile::badBlock(unsigned int b) {
+	bufBlock = UINT_MAX;
+	SMExcept e("badEventFile");
+	e.insert("filename",fname);
+	e.insert("block",b);
+	throw(e);
+}
+
+const CompactPrimary* CompactEventFile::getBlock(unsigned int b, unsigned int& n, uint32_t& blockEid0) {
+	smassert(b < nBlocks);
+	const CompactBlockHeader* B = (const CompactBlockHeader*)(mapped+offsets[b]);
+	n = B->nPrimaries;
+	blockEid0 = B->eid0;
+	const char* payload = (const char*)(B+1);
+	if(!B->compressed) {
+		// sizes were checked on opening; the event count needs the records
+		const CompactPrimary* r = (const CompactPrimary*)payload;
+		if(!blockEventsMatch(r,n,B->nEvents)) badBlock(b);
+		return r;
+	}
+	if(bufBlock != b) {
+		buf.resize(n);
+		uLongf nOut = n*sizeof(CompactPrimary);
+		int err = uncompress((Bytef*)&buf[0],&nOut,(const Bytef*)payload,B->storedBytes);
+		if(err != Z_OK || nOut != n*sizeof(CompactPrimary) || !blockEventsMatch(&buf[0],n,B->nEvents)) {
+			badBlock(b);
+		}
+		bufBlock = b;
+	}
+	return &buf[0];
+}
+
+void CompactEventFile::startBlock(unsigned int b) {
+	curBlock = b;
+	recs = getBlock(b,nRecs,eid);
+	nextRec = 0;
+}
+
+void CompactEventFile::selectPart(unsigned int p, unsigned int nP) {
+	smassert(nP && p < nP);
+	b0 = (uint64_t)nBlocks*p/nP;
+	b1 = (uint64_t)nBlocks*(p+1)/nP;
+	curBlock = UINT_MAX;
+	firstpass = true;
+}
+
+unsigned int CompactEventFile::loadEvt(std::vector<NucDecayEvent>& v) {
+	if(b0 == b1) return 0;
+	if(curBlock < b0 || curBlock >= b1) startBlock(b0);
+	eid += recs[nextRec].deid;
+	unsigned int n = 0;
+	NucDecayEvent e;
+	do {
+		unpackPrimary(recs[nextRec++],eid,e);
+		v.push_back(e);
+		n++;
+	} while(nextRec < nRecs && !recs[nextRec].deid);
+	if(nextRec == nRecs) {
+		if(curBlock+1 < b1) startBlock(curBlock+1);
+		else {
+			startBlock(b0);
+			firstpass = false;
+		}
+	}
+	return n;
+}
@@ -2,15 +2,28 @@
 #include "SMExcept.hh"
 #include "strutils.hh"
 #include "PathUtils.hh"
+#include "SamplingKernels.hh"
 #include <math.h>
 #include <cfloat>
+#include <climits>
 #include <stdlib.h>
 #include <algorithm>
 #include <TRandom.h>
-
-unsigned int PSelector::select(double* x) const {
-	static double rnd_tmp;
-	if(!x) { x=&rnd_tmp; rnd_tmp=gRandom->Uniform(0,cumprob.back()); }
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/// random source for calls without one
+static TRandom* randomSource(TRandom* R) { return R?R:gRandom; }
+
+unsigned int PSelector::select(double* x, TRandom* R) const {
+	if(!x && alias.size()) {
+		double u = randomSource(R)->Uniform(0,alias.size());
+		unsigned int i = std::min((unsigned int)u, (unsigned int)alias.size()-1);
+		return (u-i < aliasProb[i]) ? i : alias[i];
+	}
+	double rnd_tmp;
+	if(!x) { x=&rnd_tmp; rnd_tmp=randomSource(R)->Uniform(0,cumprob.back()); }
 	else { smassert(0. <= *x && *x <= 1.); (*x) *= cumprob.back(); }
 	std::vector<double>::const_iterator itsel = std::upper_bound(cumprob.begin(),cumprob.end(),*x);
 	unsigned int selected = (unsigned int)(itsel-cumprob.begin()-1);
@@ -19,6 +32,33 @@ unsigned int PSelector::select(double* x) const {
 	return selected;
 }
 
+void PSelector::buildAlias() {
+	// Vose's method: columns of height 1 per item, over-full items topping up under-full ones
+	const unsigned int n = getN();
+	aliasProb.assign(n,1.);
+	alias.resize(n);
+	for(unsigned int i=0; i<n; i++) alias[i] = i;
+	if(!n || !(cumprob.back() > 0)) { aliasProb.clear(); alias.clear(); return; }
+	std::vector<double> h(n);
+	std::vector<unsigned int> small, large;
+	for(unsigned int i=0; i<n; i++) {
+		h[i] = n*(cumprob[i+1]-cumprob[i])/cumprob.back();
+		if(h[i] < 1.) small.push_back(i);
+		else large.push_back(i);
+	}
+	while(small.size() && large.size()) {
+		unsigned int s = small.back(); small.pop_back();
+		unsigned int l = large.back();
+		aliasProb[s] = h[s];
+		alias[s] = l;
+		h[l] -= 1.-h[s];
+		if(h[l] < 1.) { large.pop_back(); small.push_back(l); }
+	}
+	// leftovers are full columns up to rounding
+	for(unsigned int i=0; i<small.size(); i++) aliasProb[small[i]] = 1.;
+	for(unsigned int i=0; i<large.size(); i++) aliasProb[large[i]] = 1.;
+}
+
 void PSelector::scale(double s) {
 	for(std::vector<double>::iterator it = cumprob.begin(); it != cumprob.end(); it++)
 		(*it) *= s;
@@ -47,13 +87,11 @@ DecayType particleType(const std::string& s) {
 	return D_NONEVENT;
 }
 
-void randomDirection(double& x, double& y, double& z, double* rnd) {
-	double phi = 2.0*M_PI*(rnd?rnd[1]:gRandom->Uniform(0,1));
-	double costheta = 2.0*(rnd?rnd[0]:gRandom->Uniform(0,1))-1.0;
-	double sintheta = sqrt(1.0-costheta*costheta);
-	x = cos(phi)*sintheta;
-	y = sin(phi)*sintheta;
-	z = costheta;
+void randomDirection(double& x, double& y, double& z, double* rnd, TRandom* R) {
+	double u[2];
+	u[1] = rnd?rnd[1]:randomSource(R)->Uniform(0,1);
+	u[0] = rnd?rnd[0]:randomSource(R)->Uniform(0,1);
+	isotropicDirections(1,u,u+1,&x,&y,&z);
 }
 
 //-----------------------------------------
@@ -98,12 +136,12 @@ void DecayAtom::load(const Stringmap& m) {
 	if(!Iauger) IMissing = pAuger = 0;	
 }
 
-void DecayAtom::genAuger(std::vector<NucDecayEvent>& v) {
-	if(gRandom->Uniform(0,1) > pAuger) return;
+void DecayAtom::genAuger(std::vector<NucDecayEvent>& v, TRandom* R) const {
+	if(randomSource(R)->Uniform(0,1) > pAuger) return;
 	NucDecayEvent evt;
 	evt.d = D_ELECTRON;
 	evt.E = Eauger;
-	evt.randp();
+	evt.randp(NULL,R);
 	v.push_back(evt);
 }
 
@@ -144,12 +182,13 @@ ConversionGamma::ConversionGamma(NucLevel& f, NucLevel& t, const Stringmap& m):
 	Itotal = shells.getCumProb();
 }
 
-void ConversionGamma::run(std::vector<NucDecayEvent>& v, double* rnd) {
-	shell = (int)shells.select(rnd);
+unsigned int ConversionGamma::run(std::vector<NucDecayEvent>& v, double* rnd, TRandom* R) const {
+	int shell = (int)shells.select(rnd,R);
+	int subshell = -1;
 	if(shell < (int)subshells.size())
-		subshell = (int)subshells[shell].select(rnd);
+		subshell = (int)subshells[shell].select(rnd,R);
 	else
-		shell = subshell = -1;
+		shell = -1;
 	NucDecayEvent evt;
 	evt.E = Egamma;
 	if(shell<0) {
@@ -158,8 +197,9 @@ void ConversionGamma::run(std::vector<NucDecayEvent>& v, double* rnd) {
 		evt.d = D_ELECTRON;
 		evt.E -= toAtom->BET->getSubshellBinding(shell,subshell);
 	}
-	evt.randp(rnd);
+	evt.randp(rnd,R);
 	v.push_back(evt);
+	return shell==0;
 }
 
 void ConversionGamma::display(bool verbose) const {
@@ -252,21 +292,22 @@ void BetaDecayTrans::display(bool verbose) const {
 	TransitionBase::display(verbose);
 }
 
-void BetaDecayTrans::run(std::vector<NucDecayEvent>& v, double* rnd) {
+unsigned int BetaDecayTrans::run(std::vector<NucDecayEvent>& v, double* rnd, TRandom* R) const {
 	NucDecayEvent evt;
 	evt.d = positron?D_POSITRON:D_ELECTRON;
-	evt.randp(rnd);
-	if(rnd) evt.E = betaQuantiles->eval(rnd[2]);
-	else evt.E = betaTF1.GetRandom();
+	evt.randp(rnd,R);
+	// inverse CDF table rather than TF1::GetRandom, which updates the TF1 and uses gRandom
+	evt.E = betaQuantiles->eval(rnd?rnd[2]:randomSource(R)->Uniform(0,1));
 	v.push_back(evt);
+	return 0;
 }
 
 double BetaDecayTrans::evalBeta(double* x, double*) { return BSG.decayProb(x[0]); }
 
 //-----------------------------------------
 
-void ECapture::run(std::vector<NucDecayEvent>&, double*) {
-	isKCapt = gRandom->Uniform(0,1) < toAtom->IMissing;
+unsigned int ECapture::run(std::vector<NucDecayEvent>&, double*, TRandom* R) const {
+	return randomSource(R)->Uniform(0,1) < toAtom->IMissing;
 }
 
 //-----------------------------------------
@@ -403,7 +444,9 @@ void NucDecaySystem::setCutoff(double t) {
 			for(unsigned int t = 0; t < transIn[n].size(); t++)
 				pStart += transIn[n][t]->Itotal;
 		lStart.addProb(pStart);
+		levelDecays[n].buildAlias();
 	}
+	lStart.buildAlias();
 }
 
 void NucDecaySystem::display(bool verbose) const {
@@ -448,20 +491,19 @@ unsigned int NucDecaySystem::levIndex(const std::string& s) const {
 	return n->second;
 }
 
-void NucDecaySystem::genDecayChain(std::vector<NucDecayEvent>& v, double* rnd, unsigned int n) {
+void NucDecaySystem::genDecayChain(std::vector<NucDecayEvent>& v, double* rnd, TRandom* R, unsigned int n) const {
 	bool init = n>=levels.size();
 	if(init)
-		n = lStart.select(rnd);
+		n = lStart.select(rnd,R);
 	if(!levels[n].fluxOut || (!init && levels[n].hl > tcut)) return;
 	
-	TransitionBase* T = transOut[n][levelDecays[n].select(rnd)];
-	T->run(v, rnd);
+	const TransitionBase* T = transOut[n][levelDecays[n].select(rnd,R)];
+	unsigned int nAugerK = T->run(v, rnd, R);
 	if(rnd) rnd += T->getNDF(); // remove random numbers "consumed" by continuous processes
-	unsigned int nAugerK = T->nVacant(0);
 	while(nAugerK--)
-		getAtom(T->to.Z)->genAuger(v);
+		T->toAtom->genAuger(v,R);
 	
-	genDecayChain(v, rnd, T->to.n);
+	genDecayChain(v, rnd, R, T->to.n);
 }
 
 unsigned int NucDecaySystem::getNDF(unsigned int n) const {
@@ -496,7 +538,7 @@ void NucDecaySystem::scale(double s) {
 //-----------------------------------------
 
 NucDecayLibrary::NucDecayLibrary(const std::string& datp, double t):
-datpath(datp), tcut(t), BEL(QFile(datpath+"/ElectronBindingEnergy.txt")) {
+datpath(datp), tcut(t), BEL(QFile(datpath+"/ElectronBindingEnergy.txt",true,true)) {
 }
 
 NucDecayLibrary::~NucDecayLibrary() {
@@ -504,7 +546,21 @@ NucDecayLibrary::~NucDecayLibrary() {
 		delete(it->second);
 }
 
-NucDecaySystem& NucDecayLibrary::getGenerator(const std::string& nm) {
+std::string NucDecayLibrary::defaultDataPath() {
+	// file opens do not expand '~' as the shell would, so substitute $HOME
+	std::string p = getEnvSafe("UCNA_DECAY_DATA","~/Documents/Caltech/UCNA_Sim/XSun_ucna_G4Sim/ExtraFiles/");
+	if(p.size() && p[0]=='~') p = getEnvSafe("HOME","")+p.substr(1);
+	return p;
+}
+
+NucDecayLibrary& NucDecayLibrary::shared() {
+	static NucDecayLibrary NDL(defaultDataPath(),1e-6);
+	return NDL;
+}
+
+const NucDecaySystem& NucDecayLibrary::getGenerator(const std::string& nm) {
+	// building under the lock also serializes the ROOT object (TF1) creation inside
+	std::lock_guard<std::mutex> guard(lock);
 	std::map<std::string,NucDecaySystem*>::iterator it = NDs.find(nm);
 	if(it != NDs.end()) return *(it->second);
 	std::string fname = datpath+"/"+nm+".txt"; 
@@ -514,16 +570,20 @@ NucDecaySystem& NucDecayLibrary::getGenerator(const std::string& nm) {
 		throw(e);
 	}
 	std::pair<std::map<std::string,NucDecaySystem*>::iterator,bool> ret;
-	ret = NDs.insert(std::pair<std::string,NucDecaySystem*>(nm,new NucDecaySystem(QFile(fname),BEL,tcut)));
+	ret = NDs.insert(std::pair<std::string,NucDecaySystem*>(nm,new NucDecaySystem(QFile(fname,true,true),BEL,tcut)));
 	return *(ret.first->second);
 }
 
 bool NucDecayLibrary::hasGenerator(const std::string& nm) {
-	if(cantdothis.count(nm)) return false;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if(cantdothis.count(nm)) return false;
+	}
 	try {
 		getGenerator(nm);
 		return true;
 	} catch(...) {
+		std::lock_guard<std::mutex> guard(lock);
 		cantdothis.insert(nm);
 	}
 	return false;
@@ -532,47 +592,139 @@ bool NucDecayLibrary::hasGenerator(const std::string& nm) {
 //-----------------------------------------
 
 
-GammaForest::GammaForest(const std::string& fname, double E2keV) {
+/// GammaForest binary cache: header, then nGammas energies and nGammas cross sections, as in the file
+struct GammaCacheHeader {
+	char magic[8];		///< "GFCACHE2"
+	int64_t mtime;		///< source file modification time [ns]
+	int64_t size;		///< source file size
+	uint64_t nGammas;	///< number of lines
+};
+
+bool GammaForest::readCache(const std::string& fname, std::vector<double>& E, std::vector<double>& P) const {
+	int64_t mtime, size;
+	if(!fileStamp(fname,mtime,size)) return false;
+	std::ifstream fin(QFile::cacheName(fname,".gfcache").c_str(),std::ios::binary);
+	GammaCacheHeader H;
+	if(!fin.read((char*)&H,sizeof(H)) || memcmp(H.magic,"GFCACHE2",8)
+	   || H.mtime != mtime || H.size != size || H.nGammas > (uint64_t)size) return false;
+	E.resize(H.nGammas);
+	P.resize(H.nGammas);
+	if(!H.nGammas) return true;
+	return fin.read((char*)&E[0],H.nGammas*sizeof(double)) && fin.read((char*)&P[0],H.nGammas*sizeof(double));
+}
+
+void GammaForest::writeCache(const std::string& fname, const std::vector<double>& E, const std::vector<double>& P) const {
+	GammaCacheHeader H;
+	if(!fileStamp(fname,H.mtime,H.size)) return;
+	std::string cname = QFile::cacheName(fname,".gfcache");
+	if(QFile::cacheDir!="") makePath(QFile::cacheDir);
+	std::string tmpname = cname+".tmp"+itos(getpid());
+	std::ofstream fout(tmpname.c_str(),std::ios::binary);
+	if(!fout.good()) return;
+	memcpy(H.magic,"GFCACHE2",8);
+	H.nGammas = E.size();
+	fout.write((const char*)&H,sizeof(H));
+	if(H.nGammas) {
+		fout.write((const char*)&E[0],H.nGammas*sizeof(double));
+		fout.write((const char*)&P[0],H.nGammas*sizeof(double));
+	}
+	fout.close();
+	if(fout.good()) rename(tmpname.c_str(),cname.c_str());
+	else remove(tmpname.c_str());
+}
+
+GammaForest::GammaForest(const std::string& fname, double E2keV, bool cached) {
 	if(!fileExists(fname)) {
 		SMExcept e("fileUnreadable");
 		e.insert("filename",fname);
 		throw(e);
 	}
-	std::ifstream fin(fname.c_str());
-	std::string s;
-	while (fin.good()) {
-		std::getline(fin,s);
-		s = strip(s);
-		if(!s.size() || s[0]=='#')
-			continue;
-		std::vector<double> v = sToDoubles(s," ,\t");
-		if(v.size() != 2) continue;
-		gammaE.push_back(v[0]*E2keV);
-		gammaProb.addProb(v[1]);
-	}
-	fin.close();
+	cached = cached && QFile::useBinaryCache;
+	std::vector<double> E, P;
+	if(!(cached && readCache(fname,E,P))) {
+		E.clear();
+		P.clear();
+		std::ifstream fin(fname.c_str());
+		std::string s;
+		while (fin.good()) {
+			std::getline(fin,s);
+			s = strip(s);
+			if(!s.size() || s[0]=='#')
+				continue;
+			std::vector<double> v = sToDoubles(s," ,\t");
+			if(v.size() != 2) continue;
+			E.push_back(v[0]);
+			P.push_back(v[1]);
+		}
+		fin.close();
+		if(cached) writeCache(fname,E,P);
+	}
+	gammaE.resize(E.size());
+	for(unsigned int i=0; i<E.size(); i++) {
+		gammaE[i] = E[i]*E2keV;
+		gammaProb.addProb(P[i]);
+	}
+	gammaProb.buildAlias();
+	// flatten the alias table onto energies, so a draw is one lookup
+	aliasE.resize(gammaProb.hasAlias() ? gammaE.size() : 0);
+	for(unsigned int i=0; i<aliasE.size(); i++) {
+		aliasE[i].keep = gammaProb.getAliasProb(i);
+		aliasE[i].E = gammaE[i];
+		aliasE[i].Ealias = gammaE[gammaProb.getAlias(i)];
+	}
 	printf("Located %i gammas with total cross section %g\n",(int)gammaE.size(),gammaProb.getCumProb());
 }
 
-void GammaForest::genDecays(std::vector<NucDecayEvent>& v, double n) {
-	while(n>=1. || gRandom->Uniform(0,1)<n) {
-		NucDecayEvent evt;
-		evt.d = D_GAMMA;
-		evt.t = 0;
-		evt.E = gammaE[gammaProb.select()];
+unsigned int GammaForest::genMultiplicity(double n, TRandom* R) const {
+	if(!(n > 0)) return 0;
+	unsigned int k = (unsigned int)n;
+	const double f = n-k;
+	if(f > 0 && randomSource(R)->Uniform(0,1) < f) k++;
+	return k;
+}
+
+double GammaForest::sampleE(double u) const {
+	smassert(aliasE.size());
+	const double x = u*aliasE.size();
+	const unsigned int i = std::min((unsigned int)x,(unsigned int)aliasE.size()-1);
+	return (x-i < aliasE[i].keep) ? aliasE[i].E : aliasE[i].Ealias;
+}
+
+void GammaForest::genDecays(std::vector<NucDecayEvent>& v, double n, TRandom* R) const {
+	const unsigned int k = genMultiplicity(n,R);
+	NucDecayEvent evt;
+	evt.d = D_GAMMA;
+	evt.t = 0;
+	v.reserve(v.size()+k);
+	for(unsigned int i=0; i<k; i++) {
+		evt.E = sampleE(randomSource(R)->Uniform(0,1));
 		v.push_back(evt);
-		--n;
 	}
 }
 
+unsigned int GammaForest::genClusters(unsigned int nClusters, double n, unsigned int* nGam, double* E, size_t maxGammas, TRandom* R) const {
+	// multiplicities first, then all energies from one block of random numbers
+	size_t nTot = 0;
+	unsigned int c = 0;
+	for(; c<nClusters; c++) {
+		const unsigned int k = genMultiplicity(n,R);
+		if(nTot+k > maxGammas) break;
+		nGam[c] = k;
+		nTot += k;
+	}
+	// RndmArray takes an Int_t count: fill in batches that fit it
+	TRandom* rnd = randomSource(R);
+	for(size_t i=0; i<nTot; i+=INT_MAX) rnd->RndmArray((Int_t)std::min<size_t>(nTot-i,INT_MAX),E+i);
+	for(size_t i=0; i<nTot; i++) E[i] = sampleE(E[i]);
+	return c;
+}
+
 
 //-----------------------------------------
 
 void square2circle(double& x, double& y, double r) {
-	double th = 2*M_PI*x;
-	r *= sqrt(y);
-	x = r*cos(th);
-	y = r*sin(th);
+	const double a = x, b = y;
+	uniformDisk(1,&a,&b,r,&x,&y);
 }
 
 void CubePosGen::genPos(double* v, double* rnd) const {
@@ -583,8 +735,7 @@ void CubePosGen::genPos(double* v, double* rnd) const {
 void CylPosGen::genPos(double* v, double* rnd) const {
 	for(AxisDirection d = X_DIRECTION; d <= Z_DIRECTION; ++d)
 		v[d] = rnd?rnd[d]:gRandom->Uniform(0,1);
-	square2circle(v[X_DIRECTION],v[Y_DIRECTION],r);
-	v[Z_DIRECTION] = (v[Z_DIRECTION]-0.5)*dz;
+	uniformCylinder(1,v+X_DIRECTION,v+Y_DIRECTION,v+Z_DIRECTION,r,dz,v+X_DIRECTION,v+Y_DIRECTION,v+Z_DIRECTION);
 }
 
 //-----------------------------------------
@@ -600,26 +751,50 @@ void EventTreeScanner::setReadpoints() {
 	SetBranchAddress("direction",evt.p);
 	SetBranchAddress("time",&evt.t);
 	SetBranchAddress("weight",&evt.w);
+	setGroupBranch("num");
 }
 
 int EventTreeScanner::addFile(const std::string& filename) {
 	int nf = TChainScanner::addFile(filename);
-	startScan();
-	nextPoint();
-	prevN = evt.eid;
+	nextEvt = UINT_MAX;
 	firstpass = true;
 	return nf;
 }
 
-unsigned int EventTreeScanner::loadEvt(std::vector<NucDecayEvent>& v) {
-	unsigned int nevts = 0;
-	do {
+void EventTreeScanner::seekEvent(unsigned int k) {
+	smassert(k < getnEvts());
+	nextEvt = k;
+}
+
+void EventTreeScanner::selectPart(unsigned int p, unsigned int nP) {
+	smassert(nP && p < nP);
+	part = p;
+	nParts = nP;
+	nextEvt = UINT_MAX;
+	firstpass = true;
+}
+
+unsigned int EventTreeScanner::readEvt(std::vector<NucDecayEvent>& v, unsigned int k) {
+	const Long64_t e0 = groupStart(k);
+	const Long64_t e1 = groupStart(k+1);
+	for(Long64_t e = e0; e < e1; e++) {
+		speedload(e);
 		v.push_back(evt);
-		++nevts;
-		nextPoint();
-	} while(prevN==evt.eid);
-	firstpass &= evt.eid>=prevN;
-	prevN=evt.eid;
+	}
+	currentEvent = e1-1;
+	return e1-e0;
+}
+
+unsigned int EventTreeScanner::loadEvt(std::vector<NucDecayEvent>& v) {
+	const unsigned int k0 = partStart();
+	const unsigned int k1 = partEnd();
+	if(k0 == k1) return 0;
+	if(nextEvt < k0 || nextEvt >= k1) nextEvt = k0;
+	unsigned int nevts = readEvt(v,nextEvt);
+	if(++nextEvt == k1) {
+		nextEvt = k0;
+		firstpass = false;
+	}
 	return nevts;
 }
 
@@ -43,6 +43,19 @@ void makePath(std::string p, bool forFile) {
 	}
 }
 
+bool fileStamp(const std::string& fname, int64_t& mtime, int64_t& size) {
+	struct stat st;
+	if(stat(fname.c_str(),&st)) return false;
+	// nanoseconds: an edit within the same second that keeps the size still changes the stamp
+#ifdef __APPLE__
+	mtime = (int64_t)st.st_mtimespec.tv_sec*1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+	mtime = (int64_t)st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+#endif
+	size = st.st_size;
+	return true;
+}
+
 double fileAge(const std::string& fname) {
 	if(!(fileExists(fname) || dirExists(fname)))
 		return -1.;
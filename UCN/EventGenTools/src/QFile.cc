@@ -4,6 +4,12 @@
 #include <sstream>
 #include <fstream>
 #include <utility>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "strutils.hh"
 #include "PathUtils.hh"
 //#include "SMExcept.hh"
@@ -20,20 +26,21 @@ Stringmap::Stringmap(const std::string& s) {
 	}
 }
 
-Stringmap::Stringmap(const Stringmap& m) {
+Stringmap::Stringmap(const Stringmap& m): numcache(m.numcache) {
 	for(std::multimap< std::string, std::string >::const_iterator it = m.dat.begin(); it!=m.dat.end(); it++)
 		dat.insert(std::make_pair(it->first,it->second));
 }
 
 void Stringmap::insert(const std::string& s, const std::string& v) {
 	dat.insert(std::make_pair(s,v));
+	numcache.erase(s);
 }
 
 void Stringmap::insert(const std::string& s, double d) {
 	insert(s,dtos(d));
 }
 
-void Stringmap::erase(const std::string& s) { dat.erase(s); }
+void Stringmap::erase(const std::string& s) { dat.erase(s); numcache.erase(s); }
 
 std::vector<std::string> Stringmap::retrieve(const std::string& s) const {
 	std::vector<std::string> v;
@@ -63,6 +70,9 @@ void Stringmap::display(std::string linepfx) const {
 
 
 double Stringmap::getDefault(const std::string& k, double d) const {
+	std::map<std::string,double>::const_iterator itn = numcache.find(k);
+	if(itn != numcache.end())
+		return itn->second;
 	std::string s = getDefault(k,"");
 	if(!s.size())
 		return d;
@@ -111,10 +121,137 @@ RData* Stringmap::toRData() const {
 
 
 
-QFile::QFile(const std::string& fname, bool readit) {
+bool QFile::useBinaryCache = true;
+/// $UCNA_QCACHE_DIR, else the user's cache directory, so caches stay out of (source tree) data directories
+static std::string defaultCacheDir() {
+	std::string d = getEnvSafe("UCNA_QCACHE_DIR","");
+	if(d!="") return d;
+	std::string base = getEnvSafe("XDG_CACHE_HOME","");
+	if(base=="" && getEnvSafe("HOME","")!="") base = getEnvSafe("HOME","")+"/.cache";
+	return base=="" ? "" : base+"/ucna";
+}
+std::string QFile::cacheDir = defaultCacheDir();
+
+std::string QFile::cacheName(const std::string& fname, const std::string& ext) {
+	if(cacheDir=="") return fname+ext;
+	// one flat directory: the absolute source path, with '/' mangled, names the cache
+	char* full = realpath(fname.c_str(),NULL);
+	std::string p = full?full:fname;
+	free(full);
+	for(size_t i=0; i<p.size(); i++) if(p[i]=='/') p[i] = '%';
+	return cacheDir+"/"+p+ext;
+}
+
+/// binary cache layout: header, then per entry the key and its key/value pairs
+/// (each string as uint32 length + bytes, each value followed by uint8 isNumeric and a double)
+struct QCacheHeader {
+	char magic[8];		///< "QFCACHE2"
+	int64_t mtime;		///< source file modification time [ns]
+	int64_t size;		///< source file size
+	uint32_t nEntries;	///< number of QFile entries
+};
+
+/// bounds-checked reader over a cache read into memory
+class QCacheReader {
+public:
+	QCacheReader(const char* p, size_t n): pos(p), end(p+n), ok(true) {}
+	template<typename T> T get() {
+		T x = T();
+		if(pos+sizeof(T) > end) { ok = false; return x; }
+		memcpy(&x,pos,sizeof(T));
+		pos += sizeof(T);
+		return x;
+	}
+	std::string getString() {
+		uint32_t n = get<uint32_t>();
+		if(!ok || pos+n > end) { ok = false; return ""; }
+		std::string s(pos,n);
+		pos += n;
+		return s;
+	}
+	const char* pos;
+	const char* end;
+	bool ok;
+};
+
+static void putString(std::ofstream& o, const std::string& s) {
+	uint32_t n = s.size();
+	o.write((const char*)&n,sizeof(n));
+	o.write(s.data(),n);
+}
+
+bool QFile::readCache(const std::string& fname) {
+	struct stat cached;
+	int64_t mtime, size;
+	std::string cname = cacheName(fname);
+	if(!fileStamp(fname,mtime,size) || stat(cname.c_str(),&cached) || cached.st_size < (off_t)sizeof(QCacheHeader)) return false;
+	// one read of the whole cache; the gain over the text is skipping its parsing, not the I/O
+	std::ifstream fin(cname.c_str(),std::ios::binary);
+	std::string buf(cached.st_size,'\0');
+	if(!fin.read(&buf[0],buf.size())) return false;
+	
+	QCacheReader R(buf.data(),buf.size());
+	QCacheHeader H = R.get<QCacheHeader>();
+	bool ok = !memcmp(H.magic,"QFCACHE2",8) && H.mtime == mtime && H.size == size;
+	std::multimap< std::string, Stringmap > d;
+	for(uint32_t i=0; ok && i<H.nEntries; i++) {
+		std::string key = R.getString();
+		uint32_t nPairs = R.get<uint32_t>();
+		Stringmap m;
+		for(uint32_t j=0; R.ok && j<nPairs; j++) {
+			std::string k = R.getString();
+			std::string v = R.getString();
+			bool isNum = R.get<uint8_t>();
+			double x = R.get<double>();
+			m.insert(k,v);
+			if(isNum && m.count(k)==1) m.setNumeric(k,x);	// getDefault reads the first value
+		}
+		ok = R.ok;
+		d.insert(std::make_pair(key,m));
+	}
+	if(ok) dat.swap(d);
+	return ok;
+}
+
+void QFile::writeCache(const std::string& fname) const {
+	QCacheHeader H;
+	if(!fileStamp(fname,H.mtime,H.size)) return;
+	std::string cname = cacheName(fname);
+	if(cacheDir!="") makePath(cacheDir);
+	std::string tmpname = cname+".tmp"+itos(getpid());	// processes may race to write the same cache
+	std::ofstream fout(tmpname.c_str(),std::ios::binary);
+	if(!fout.good()) return;	// read-only cache location: no cache
+	memcpy(H.magic,"QFCACHE2",8);
+	H.nEntries = dat.size();
+	fout.write((const char*)&H,sizeof(H));
+	for(std::multimap<std::string, Stringmap>::const_iterator it = dat.begin(); it != dat.end(); it++) {
+		putString(fout,it->first);
+		uint32_t nPairs = it->second.dat.size();
+		fout.write((const char*)&nPairs,sizeof(nPairs));
+		for(std::multimap<std::string,std::string>::const_iterator it2 = it->second.dat.begin(); it2 != it->second.dat.end(); it2++) {
+			putString(fout,it2->first);
+			putString(fout,it2->second);
+			// numeric if fully read the way Stringmap::getDefault reads it
+			std::istringstream ss(it2->second);
+			double x = 0;
+			ss >> x;
+			uint8_t isNum = !ss.fail() && ss.eof();
+			fout.write((const char*)&isNum,sizeof(isNum));
+			fout.write((const char*)&x,sizeof(x));
+		}
+	}
+	fout.close();
+	if(fout.good()) rename(tmpname.c_str(),cname.c_str());
+	else remove(tmpname.c_str());
+}
+
+QFile::QFile(const std::string& fname, bool readit, bool cached) {
 	name = fname;
 	if(!readit || name=="")
 		return;
+	cached = cached && useBinaryCache;
+	if(cached && readCache(fname))
+		return;
 	if(!fileExists(fname)) {
 /*		SMExcept e("fileUnreadable");
 		e.insert("filename",fname);
@@ -141,6 +278,7 @@ QFile::QFile(const std::string& fname, bool readit) {
 		insert(key,Stringmap(vals));
 	}
 	fin.close();
+	if(cached) writeCache(fname);
 }
 
 void QFile::insert(const std::string& s, const Stringmap& v) {
@@ -0,0 +1,165 @@
+#include "SamplingKernels.hh"
+#include <cmath>
+#include <cstring>
+
+// lanes: the same kernel code on AVX, SSE2 or plain doubles
+#if defined(__AVX__)
+#include <immintrin.h>
+typedef __m256d vdouble;
+static const unsigned int NLANES = 4;
+static inline vdouble vload(const double* p) { return _mm256_loadu_pd(p); }
+static inline void vstore(double* p, vdouble a) { _mm256_storeu_pd(p,a); }
+static inline vdouble vset(double a) { return _mm256_set1_pd(a); }
+static inline vdouble vadd(vdouble a, vdouble b) { return _mm256_add_pd(a,b); }
+static inline vdouble vsub(vdouble a, vdouble b) { return _mm256_sub_pd(a,b); }
+static inline vdouble vmul(vdouble a, vdouble b) { return _mm256_mul_pd(a,b); }
+static inline vdouble vsqrt(vdouble a) { return _mm256_sqrt_pd(a); }
+/// 1 where a >= b, else 0
+static inline vdouble vge(vdouble a, vdouble b) { return _mm256_and_pd(_mm256_cmp_pd(a,b,_CMP_GE_OQ),_mm256_set1_pd(1.)); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128d vdouble;
+static const unsigned int NLANES = 2;
+static inline vdouble vload(const double* p) { return _mm_loadu_pd(p); }
+static inline void vstore(double* p, vdouble a) { _mm_storeu_pd(p,a); }
+static inline vdouble vset(double a) { return _mm_set1_pd(a); }
+static inline vdouble vadd(vdouble a, vdouble b) { return _mm_add_pd(a,b); }
+static inline vdouble vsub(vdouble a, vdouble b) { return _mm_sub_pd(a,b); }
+static inline vdouble vmul(vdouble a, vdouble b) { return _mm_mul_pd(a,b); }
+static inline vdouble vsqrt(vdouble a) { return _mm_sqrt_pd(a); }
+static inline vdouble vge(vdouble a, vdouble b) { return _mm_and_pd(_mm_cmpge_pd(a,b),_mm_set1_pd(1.)); }
+#else
+typedef double vdouble;
+static const unsigned int NLANES = 1;
+static inline vdouble vload(const double* p) { return *p; }
+static inline void vstore(double* p, vdouble a) { *p = a; }
+static inline vdouble vset(double a) { return a; }
+static inline vdouble vadd(vdouble a, vdouble b) { return a+b; }
+static inline vdouble vsub(vdouble a, vdouble b) { return a-b; }
+static inline vdouble vmul(vdouble a, vdouble b) { return a*b; }
+static inline vdouble vsqrt(vdouble a) { return sqrt(a); }
+static inline vdouble vge(vdouble a, vdouble b) { return a >= b ? 1. : 0.; }
+#endif
+
+unsigned int samplingLanes() { return NLANES; }
+
+/// sin and cos of 2 pi u, u in [0,1], to ~1e-16
+static inline void vsincos2pi(vdouble u, vdouble& s, vdouble& c) {
+	// nearest quarter turn q (0-4) and the remaining angle, within +-pi/4
+	vdouble q = vadd(vadd(vge(u,vset(0.125)),vge(u,vset(0.375))),vadd(vge(u,vset(0.625)),vge(u,vset(0.875))));
+	vdouble a = vmul(vsub(u,vmul(q,vset(0.25))),vset(2*M_PI));
+	vdouble a2 = vmul(a,a);
+	// Taylor series, truncated below 1e-17 at pi/4
+	vdouble sp = vset(1./355687428096000.);
+	sp = vadd(vmul(sp,a2),vset(-1./1307674368000.));
+	sp = vadd(vmul(sp,a2),vset(1./6227020800.));
+	sp = vadd(vmul(sp,a2),vset(-1./39916800.));
+	sp = vadd(vmul(sp,a2),vset(1./362880.));
+	sp = vadd(vmul(sp,a2),vset(-1./5040.));
+	sp = vadd(vmul(sp,a2),vset(1./120.));
+	sp = vadd(vmul(sp,a2),vset(-1./6.));
+	sp = vadd(vmul(vmul(sp,a2),a),a);
+	vdouble cp = vset(1./20922789888000.);
+	cp = vadd(vmul(cp,a2),vset(-1./87178291200.));
+	cp = vadd(vmul(cp,a2),vset(1./479001600.));
+	cp = vadd(vmul(cp,a2),vset(-1./3628800.));
+	cp = vadd(vmul(cp,a2),vset(1./40320.));
+	cp = vadd(vmul(cp,a2),vset(-1./720.));
+	cp = vadd(vmul(cp,a2),vset(1./24.));
+	cp = vadd(vmul(cp,a2),vset(-0.5));
+	cp = vadd(vmul(cp,a2),vset(1.));
+	// rotate by q quarter turns: odd q swaps sin and cos; sin < 0 for q = 2,3, cos < 0 for q = 1,2
+	vdouble ge1 = vge(q,vset(1)), ge2 = vge(q,vset(2)), ge3 = vge(q,vset(3)), ge4 = vge(q,vset(4));
+	vdouble odd = vadd(vsub(ge1,ge2),vsub(ge3,ge4));
+	vdouble sgnS = vsub(vset(1),vmul(vset(2),vsub(ge2,ge4)));
+	vdouble sgnC = vsub(vset(1),vmul(vset(2),vsub(ge1,ge3)));
+	s = vmul(sgnS,vadd(sp,vmul(odd,vsub(cp,sp))));
+	c = vmul(sgnC,vadd(cp,vmul(odd,vsub(sp,cp))));
+}
+
+/// run kernel K over n values: full blocks in place, the remainder through zero-padded copies
+template<unsigned int NIN, unsigned int NOUT, class K>
+static void runBlocks(unsigned int n, const double* const* in, double* const* out, const K& k) {
+	unsigned int i = 0;
+	vdouble vin[NIN > 0 ? NIN : 1], vout[NOUT];
+	for(; i+NLANES <= n; i += NLANES) {
+		for(unsigned int j=0; j<NIN; j++) vin[j] = vload(in[j]+i);
+		k(vin,vout);
+		for(unsigned int j=0; j<NOUT; j++) vstore(out[j]+i,vout[j]);
+	}
+	if(i == n) return;
+	double tin[NIN > 0 ? NIN : 1][NLANES], tout[NOUT][NLANES];
+	memset(tin,0,sizeof(tin));
+	for(unsigned int j=0; j<NIN; j++) {
+		for(unsigned int l=0; i+l<n; l++) tin[j][l] = in[j][i+l];
+		vin[j] = vload(tin[j]);
+	}
+	k(vin,vout);
+	for(unsigned int j=0; j<NOUT; j++) {
+		vstore(tout[j],vout[j]);
+		for(unsigned int l=0; i+l<n; l++) out[j][i+l] = tout[j][l];
+	}
+}
+
+struct SinCosKernel {
+	void operator()(const vdouble* in, vdouble* out) const { vsincos2pi(in[0],out[0],out[1]); }
+};
+
+struct DirectionKernel {
+	void operator()(const vdouble* in, vdouble* out) const {
+		vdouble z = vsub(vmul(vset(2),in[0]),vset(1));
+		vdouble st = vsqrt(vmul(vsub(vset(1),z),vadd(vset(1),z)));	// (1-z)(1+z) >= 0, also rounded
+		vdouble s, c;
+		vsincos2pi(in[1],s,c);
+		out[0] = vmul(st,c);
+		out[1] = vmul(st,s);
+		out[2] = z;
+	}
+};
+
+struct DiskKernel {
+	DiskKernel(double rr): r(rr) {}
+	void operator()(const vdouble* in, vdouble* out) const {
+		vdouble rho = vmul(vset(r),vsqrt(in[1]));
+		vdouble s, c;
+		vsincos2pi(in[0],s,c);
+		out[0] = vmul(rho,c);
+		out[1] = vmul(rho,s);
+	}
+	double r;
+};
+
+struct CylinderKernel {
+	CylinderKernel(double rr, double l): disk(rr), dz(l) {}
+	void operator()(const vdouble* in, vdouble* out) const {
+		disk(in,out);
+		out[2] = vmul(vsub(in[2],vset(0.5)),vset(dz));
+	}
+	DiskKernel disk;
+	double dz;
+};
+
+void sinCos2Pi(unsigned int n, const double* u, double* s, double* c) {
+	const double* in[1] = {u};
+	double* out[2] = {s,c};
+	runBlocks<1,2>(n,in,out,SinCosKernel());
+}
+
+void isotropicDirections(unsigned int n, const double* u, const double* v, double* x, double* y, double* z) {
+	const double* in[2] = {u,v};
+	double* out[3] = {x,y,z};
+	runBlocks<2,3>(n,in,out,DirectionKernel());
+}
+
+void uniformDisk(unsigned int n, const double* a, const double* b, double r, double* x, double* y) {
+	const double* in[2] = {a,b};
+	double* out[2] = {x,y};
+	runBlocks<2,2>(n,in,out,DiskKernel(r));
+}
+
+void uniformCylinder(unsigned int n, const double* a, const double* b, const double* c, double r, double dz,
+					 double* x, double* y, double* z) {
+	const double* in[3] = {a,b,c};
+	double* out[3] = {x,y,z};
+	runBlocks<3,3>(n,in,out,CylinderKernel(r,dz));
+}
@@ -0,0 +1,130 @@
+#include "SobolSequence.hh"
+#include "SMExcept.hh"
+
+extern const unsigned int sobolNPoly;
+extern const uint16_t sobolPoly[];
+extern const uint16_t sobolM[];
+
+/// splitmix64 generator step, for scrambling matrices and extra direction numbers
+static uint64_t splitmix(uint64_t& s) {
+	uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/// degree of polynomial p
+static unsigned int polyDegree(uint32_t p) { unsigned int s = 0; while(p >>= 1) s++; return s; }
+
+/// product of a and b modulo p (degree s) over GF(2)
+static uint32_t polyMulMod(uint32_t a, uint32_t b, uint32_t p, unsigned int s) {
+	uint32_t r = 0;
+	for(; b; b >>= 1) {
+		if(b & 1) r ^= a;
+		a <<= 1;
+		if((a >> s) & 1) a ^= p;
+	}
+	return r;
+}
+
+/// x^e modulo p (degree s) over GF(2)
+static uint32_t polyPowX(uint64_t e, uint32_t p, unsigned int s) {
+	uint32_t r = 1, b = 2 % p;
+	for(; e; e >>= 1) {
+		if(e & 1) r = polyMulMod(r,b,p,s);
+		b = polyMulMod(b,b,p,s);
+	}
+	return r;
+}
+
+/// whether p is a primitive polynomial over GF(2): x has order 2^s-1 modulo p
+static bool isPrimitive(uint32_t p) {
+	const unsigned int s = polyDegree(p);
+	if(!(p & 1) || s == 0 || s > 30) return false;
+	const uint64_t order = (1ULL << s)-1;
+	if(polyPowX(order,p,s) != 1) return false;
+	uint64_t n = order;
+	for(uint64_t q = 2; q*q <= n; q++) {
+		if(n % q) continue;
+		if(polyPowX(order/q,p,s) == 1) return false;
+		while(!(n % q)) n /= q;
+	}
+	return n == 1 || n == order || polyPowX(order/n,p,s) != 1;
+}
+
+/// the 32 direction numbers for polynomial p of degree s with initial values m
+static void sobolDirections(uint32_t p, unsigned int s, const std::vector<uint64_t>& m, uint32_t* v) {
+	uint64_t M[32];
+	for(unsigned int k=0; k<32; k++) {
+		if(k < s) M[k] = m[k];
+		else {
+			M[k] = M[k-s] ^ (M[k-s] << s);
+			for(unsigned int i=1; i<s; i++)
+				if((p >> (s-i)) & 1) M[k] ^= M[k-i] << i;
+		}
+		v[k] = M[k] << (31-k);
+	}
+}
+
+SobolSequence::SobolSequence(unsigned int nd, uint32_t seed): ndim(nd), V(32*nd), shift(nd), state(nd), index(0) {
+	uint32_t p = 0;
+	unsigned int moff = 0;
+	uint64_t extraState = 0x5EED;
+	for(unsigned int d=0; d<ndim; d++) {
+		uint32_t* v = &V[32*d];
+		if(!d) {
+			for(unsigned int k=0; k<32; k++) v[k] = 1U << (31-k);	// van der Corput
+			continue;
+		}
+		std::vector<uint64_t> m;
+		if(d <= sobolNPoly) {
+			p = sobolPoly[d-1];
+			m.assign(sobolM+moff,sobolM+moff+polyDegree(p));
+			moff += m.size();
+		} else {
+			// next primitive polynomial; any odd m_k < 2^k gives a valid sequence
+			do p += 2; while(!isPrimitive(p));
+			for(unsigned int k=0; k<polyDegree(p); k++) m.push_back((splitmix(extraState) & ((2ULL << k)-1)) | 1);
+		}
+		sobolDirections(p,polyDegree(p),m,v);
+	}
+
+	if(seed) {
+		uint64_t rs = seed;
+		for(unsigned int d=0; d<ndim; d++) {
+			// lower-triangular matrix with unit diagonal acting on the binary digits, most significant first
+			uint32_t L[32];
+			for(unsigned int r=0; r<32; r++)
+				L[r] = (1U << (31-r)) | (r ? (uint32_t)splitmix(rs) & (~0U << (32-r)) : 0);
+			for(unsigned int k=0; k<32; k++) {
+				uint32_t w = 0;
+				for(unsigned int r=0; r<32; r++)
+					if(__builtin_parity(L[r] & V[32*d+k])) w |= 1U << (31-r);
+				V[32*d+k] = w;
+			}
+			shift[d] = splitmix(rs);
+		}
+	}
+}
+
+void SobolSequence::skipTo(uint64_t n) {
+	smassert(n < (1ULL << 32));
+	const uint64_t g = n ^ (n >> 1);	// Gray code of n
+	for(unsigned int d=0; d<ndim; d++) {
+		uint32_t x = 0;
+		for(unsigned int k=0; k<32; k++)
+			if((g >> k) & 1) x ^= V[32*d+k];
+		state[d] = x;
+	}
+	index = n;
+}
+
+void SobolSequence::next(double* x) {
+	smassert(index < (1ULL << 32)-1);
+	const unsigned int c = __builtin_ctzll(~index);	// bit changed by the next Gray code step
+	for(unsigned int d=0; d<ndim; d++) {
+		x[d] = ((state[d] ^ shift[d]) + 0.5)*(1./4294967296.);
+		state[d] ^= V[32*d+c];
+	}
+	index++;
+}
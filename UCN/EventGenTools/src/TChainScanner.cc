@@ -1,7 +1,78 @@
 #include "TChainScanner.hh"
 #include "SMExcept.hh"
+#include "strutils.hh"
+#include "PathUtils.hh"
+#include "QFile.hh"
+#include <TEnv.h>
+#include <TFile.h>
+#include <TTreeCache.h>
+#include <TChainElement.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <time.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+
+Long64_t TChainScanner::cacheSize = 30000000;
+bool TChainScanner::asyncPrefetch = false;
+bool TChainScanner::groupIndexFiles = true;
+
+/// header of a group index file; the source file's size and modification time detect stale indices
+struct GroupIndexHeader {
+	char magic[8];			///< "TCSGIDX2"
+	char branch[32];		///< group branch name
+	int64_t mtime;			///< source modification time [ns]
+	int64_t size;			///< source size
+	int64_t nEntries;		///< entries in the source tree
+	int64_t nGroups;		///< number of group starts following the header
+};
+
+/// fill header for a source file; false if it cannot hold an index (patterns, missing files)
+static bool groupIndexHeader(const std::string& fname, const std::string& bname, Long64_t nEntries, GroupIndexHeader& H) {
+	int64_t mtime, size;
+	if(fname.find_first_of("*?[") != std::string::npos || bname.size() >= sizeof(H.branch) || !fileStamp(fname,mtime,size)) return false;
+	memset(&H,0,sizeof(H));
+	memcpy(H.magic,"TCSGIDX2",8);
+	strcpy(H.branch,bname.c_str());
+	H.mtime = mtime;
+	H.size = size;
+	H.nEntries = nEntries;
+	return true;
+}
+
+/// read group starts (local to the file) from its index; false if missing or stale
+static bool readGroupIndex(const std::string& fname, const std::string& bname, Long64_t nEntries, std::vector<Long64_t>& starts) {
+	GroupIndexHeader H, Hf;
+	if(!groupIndexHeader(fname,bname,nEntries,H)) return false;
+	std::ifstream fin(QFile::cacheName(fname,".gidx").c_str(),std::ios::binary);
+	if(!fin.read((char*)&Hf,sizeof(Hf)) || Hf.nGroups < 0 || Hf.nGroups > nEntries) return false;
+	H.nGroups = Hf.nGroups;
+	if(memcmp(&H,&Hf,sizeof(H))) return false;
+	std::vector<int64_t> s(H.nGroups);
+	if(H.nGroups && !fin.read((char*)&s[0],H.nGroups*sizeof(int64_t))) return false;
+	starts.assign(s.begin(),s.end());
+	return true;
+}
+
+/// save group starts of a file in the cache directory (see QFile::cacheDir); silently skipped if it is read-only
+static void writeGroupIndex(const std::string& fname, const std::string& bname, Long64_t nEntries, const std::vector<Long64_t>& starts) {
+	GroupIndexHeader H;
+	if(!groupIndexHeader(fname,bname,nEntries,H)) return;
+	H.nGroups = starts.size();
+	std::vector<int64_t> s(starts.begin(),starts.end());
+	std::string cname = QFile::cacheName(fname,".gidx");
+	if(QFile::cacheDir!="") makePath(QFile::cacheDir);
+	std::string tmpname = cname+".tmp"+itos(getpid());
+	std::ofstream fout(tmpname.c_str(),std::ios::binary);
+	if(!fout.good()) return;
+	fout.write((const char*)&H,sizeof(H));
+	if(!s.empty()) fout.write((const char*)&s[0],s.size()*sizeof(int64_t));
+	fout.close();
+	if(fout.fail() || rename(tmpname.c_str(),cname.c_str())) remove(tmpname.c_str());
+}
 
 TChainScanner::TChainScanner(const std::string& treeName): nEvents(0), nFiles(0), Tch(new TChain(treeName.c_str())),
 currentEvent(0), noffset(0), nLocalEvents(0) {
@@ -11,6 +82,7 @@ currentEvent(0), noffset(0), nLocalEvents(0) {
 
 int TChainScanner::addFile(const std::string& filename) {
 	unsigned int oldEvents = nEvents;
+	int oldFiles = Tch->GetListOfFiles()->GetEntries();
 	int nfAdded = Tch->Add(filename.c_str(),0);
 	if(!nfAdded) {
 		SMExcept e("missingFiles");
@@ -18,19 +90,96 @@ int TChainScanner::addFile(const std::string& filename) {
 		throw e;
 	}
 	nEvents = Tch->GetEntries();
-	nnEvents.push_back(nEvents-oldEvents);
-	if(!nnEvents.back()) {
+	if(nEvents == oldEvents) {
 		SMExcept e("noEventsInFile");
 		e.insert("fileName",filename);
 		e.insert("nFiles",nfAdded);
 		throw e;
 	}
-	if(!nFiles)
+	// one entry per file, also for each file a wildcard pattern matched; Add read their entry counts
+	for(int i=oldFiles; i<Tch->GetListOfFiles()->GetEntries(); i++) {
+		const TChainElement* el = (const TChainElement*)Tch->GetListOfFiles()->At(i);
+		nnEvents.push_back(el->GetEntries());
+		fileNames.push_back(el->GetTitle());
+	}
+	if(!nFiles) {
 		setReadpoints();
+		configureCache();
+	}
 	nFiles+=nfAdded;
+	groupIndex.clear();
 	return nfAdded;
 }
 
+void TChainScanner::configureCache() {
+	if(cacheSize <= 0 || !nEvents) return;
+	Tch->LoadTree(0);	// the chain's cache attaches to its current file, then follows it through the chain
+	// the cache reads the process-wide prefetch setting when it is made; restore the setting afterwards
+	int oldAsync = gEnv->GetValue("TFile.AsyncPrefetching",0);
+	if(asyncPrefetch) gEnv->SetValue("TFile.AsyncPrefetching",1);
+	Tch->SetCacheSize(cacheSize);
+	if(asyncPrefetch) gEnv->SetValue("TFile.AsyncPrefetching",oldAsync);
+	for(std::vector<std::string>::const_iterator it = readBranches.begin(); it != readBranches.end(); it++)
+		Tch->AddBranchToCache(it->c_str(),kTRUE);
+	Tch->StopCacheLearningPhase();
+	nLocalEvents = noffset = 0;
+}
+
+void TChainScanner::indexGroups() {
+	groupIndex.clear();
+	if(!nEvents || groupBranch.empty()) return;
+	// file by file, so groups also break at file boundaries, where the numbering restarts
+	Long64_t offset = 0;
+	unsigned int nBuilt = 0;
+	for(unsigned int f=0; f<nnEvents.size(); f++) {
+		std::vector<Long64_t> starts;
+		if(!groupIndexFiles || !readGroupIndex(fileNames[f],groupBranch,nnEvents[f],starts)) {
+			Tch->SetEstimate(nnEvents[f]+1);
+			Long64_t n = Tch->Draw(groupBranch.c_str(),"","goff",nnEvents[f],offset);
+			const Double_t* v = Tch->GetV1();
+			for(Long64_t i=0; i<n; i++)
+				if(!i || v[i] != v[i-1]) starts.push_back(i);
+			if(groupIndexFiles) writeGroupIndex(fileNames[f],groupBranch,nnEvents[f],starts);
+			nBuilt++;
+		}
+		for(std::vector<Long64_t>::const_iterator it = starts.begin(); it != starts.end(); it++)
+			groupIndex.push_back(offset + *it);
+		offset += nnEvents[f];
+	}
+	groupIndex.push_back(offset);
+	printf("Indexed %u groups of '%s' in %u entries (%u of %u files scanned)\n",
+		   (unsigned int)groupIndex.size()-1,groupBranch.c_str(),nEvents,nBuilt,(unsigned int)nnEvents.size());
+	if(!nBuilt) return;
+	// Draw read the group branch into our readpoint; restore the current entry
+	nLocalEvents = noffset = 0;
+	if(currentEvent < nEvents) speedload(currentEvent);
+}
+
+unsigned int TChainScanner::getnGroups() {
+	if(groupIndex.empty()) indexGroups();
+	return groupIndex.empty() ? 0 : groupIndex.size()-1;
+}
+
+Long64_t TChainScanner::groupStart(unsigned int k) {
+	unsigned int nG = getnGroups();
+	smassert(k <= nG);
+	return nG ? groupIndex[k] : 0;
+}
+
+void TChainScanner::gotoGroup(unsigned int k) {
+	smassert(k < getnGroups());
+	gotoEvent(groupIndex[k]);
+}
+
+void TChainScanner::printCacheStats() const {
+	TFile* f = Tch->GetCurrentFile();
+	TTreeCache* tc = f ? dynamic_cast<TTreeCache*>(f->GetCacheRead(Tch->GetTree())) : NULL;
+	if(tc) printf("TTreeCache: %i branches, efficiency %.3f (relative %.3f)\n",
+				  tc->GetCachedBranches()->GetEntries(),tc->GetEfficiency(),tc->GetEfficiencyRel());
+	else printf("TTreeCache: none\n");
+	printf("%i file reads, %.1f MB read\n",TFile::GetFileReadCalls(),TFile::GetFileBytesRead()*1e-6);
+}
+
 void TChainScanner::gotoEvent(unsigned int e) {
 	currentEvent = e;
 	Tch->GetEvent(currentEvent);
@@ -47,7 +196,10 @@ void TChainScanner::startScan(bool startRandom) {
 	if(startRandom) {
 		if(!currentEvent) {
 			srand(time(NULL));	// random random seed
-			gotoEvent(rand()%Tch->GetEntries());
+			// start on a group boundary if there are groups
+			unsigned int nG = getnGroups();
+			if(nG) gotoGroup(rand()%nG);
+			else gotoEvent(rand()%Tch->GetEntries());
 			printf("Scan Starting at offset %i/%i: ",currentEvent,nEvents);
 		} else {
 			printf("Scan Continuing at offset %i/%i: ",currentEvent,nEvents);
@@ -69,6 +221,7 @@ void TChainScanner::SetBranchAddress(const std::string& bname, void* bdata) {
 		e.insert("errCode",err);
 		throw e;
 	}
+	readBranches.push_back(bname);
 }
 
 void TChainScanner::speedload(unsigned int e) {
@@ -0,0 +1,85 @@
+#ifndef CachedField_h
+#define CachedField_h 1
+
+#include "globals.hh"
+#include "G4MagneticField.hh"
+#include "G4ElectroMagneticField.hh"
+
+#include <atomic>
+
+/// Per-thread memory of the last field evaluation of one field. A query within the
+/// cache distance of the thread's previous query returns the previous value instead
+/// of evaluating the field. Every Nth cache hit is also evaluated exactly to measure
+/// the error this makes. Slots are indexed by G4 thread id, so the stepping loop
+/// never locks; threads beyond kMaxThreads evaluate directly.
+class FieldValueCache
+{
+public:
+  FieldValueCache(G4int nComponents);
+
+  /// field value at point, from the cache or from field
+  void Evaluate(const G4Field* field, const G4double point[4], G4double* value) const;
+
+  void SetDistance(G4double d) { fDistance2 = d*d; }
+  G4double GetDistance() const { return sqrt(fDistance2); }
+  void SetCheckInterval(G4int n) { fCheckEvery = n; }
+  /// forget all cached values, after the field was changed
+  void Invalidate() { fGeneration++; }
+
+  /// print hit rate and the errors measured on checked hits, then reset the counters
+  void Report(const G4String& name);
+
+  static const int kMaxThreads = 64;
+
+private:
+  struct Slot		// per-thread state; the trailing pad keeps two threads' data at least
+  {			// one cache line apart, whatever the alignment of fSlots
+    Slot(): generation(-1), calls(0), hits(0), checks(0), sumDevB(0), maxDevB(0), sumDevE(0), maxDevE(0) {}
+    G4double point[3];
+    G4double value[6];
+    long generation;		// fGeneration when stored
+    long long calls;
+    long long hits;
+    long long checks;		// hits also evaluated exactly
+    G4double sumDevB, maxDevB;	// |B cached - B exact| on checked hits
+    G4double sumDevE, maxDevE;	// same for E
+    char pad[64];		// never touched
+  };
+
+  G4int fNComponents;		// 3 for B, 6 for B and E
+  G4double fDistance2;		// squared cache distance; 0 disables the cache
+  G4int fCheckEvery;		// check every Nth hit; 0 for no checks
+  std::atomic<long> fGeneration;
+  mutable Slot fSlots[kMaxThreads + 1];	// G4 thread id + 1; the master/sequential thread is -1
+};
+
+/// GlobalField (or any magnetic field) behind a FieldValueCache
+class CachedMagneticField: public G4MagneticField
+{
+public:
+  CachedMagneticField(G4MagneticField* field): fField(field), fCache(3) {}
+
+  void GetFieldValue(const G4double Point[4], G4double *Bfield) const { fCache.Evaluate(fField, Point, Bfield); }
+  FieldValueCache& GetCache() { return fCache; }
+
+private:
+  G4MagneticField* fField;
+  FieldValueCache fCache;
+};
+
+/// MWPCField (or any electromagnetic field) behind a FieldValueCache
+class CachedElectroMagneticField: public G4ElectroMagneticField
+{
+public:
+  CachedElectroMagneticField(G4ElectroMagneticField* field): fField(field), fCache(6) {}
+
+  void GetFieldValue(const G4double Point[4], G4double *Bfield) const { fCache.Evaluate(fField, Point, Bfield); }
+  G4bool DoesFieldChangeEnergy() const { return fField->DoesFieldChangeEnergy(); }
+  FieldValueCache& GetCache() { return fCache; }
+
+private:
+  G4ElectroMagneticField* fField;
+  FieldValueCache fCache;
+};
+
+#endif
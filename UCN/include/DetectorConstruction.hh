@@ -3,6 +3,7 @@
 
 #include "G4VUserDetectorConstruction.hh"
 #include "globals.hh"
+#include "G4UImessenger.hh"
 
 #include <G4Material.hh>		// stole from Michael Mendenhall's code.
 #include <G4Element.hh>
@@ -15,6 +16,9 @@
 
 #include <string>
 #include <sstream>
+#include <map>
+
+#include "EnergyAwareFieldManager.hh"
 
 //using 	namespace	std;
 
@@ -23,6 +27,24 @@ const G4double torr = atmosphere/760.;
 
 class G4VPhysicalVolume;
 class G4LogicalVolume;
+class G4Tubs;
+class G4FieldManager;
+class G4MagIntegratorStepper;
+class UniformFieldHelixStepper;
+class CachedMagneticField;
+class CachedElectroMagneticField;
+class GlobalField;
+class MWPCField;
+class DetectorConstructionMessenger;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcmdWith3VectorAndUnit;
+class G4UIcmdWithoutParameter;
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithADouble;
+class G4UIcommand;
 
 /// Detector construction class to define materials and geometry.
 
@@ -35,6 +57,74 @@ class DetectorConstruction : public G4VUserDetectorConstruction
 
     void SetVacuumPressure(G4double pressure);
 
+    // Run-to-run parameter updates that leave the built geometry and physics tables in place.
+    // Used between sub-runs of a parameter sweep (see SweepDriver).
+    void SetMWPCPotential(G4double V);		///< anode voltage of both wirechambers
+    void SetFieldScale(G4double scale);		///< scale factor on the solenoid field profile
+    /// exact helix steps in the flat sections of the solenoid field (default), or the
+    /// mixed helix/RK stepper everywhere
+    void SetHelixTransport(G4bool b);
+    /// reuse the previous field value for queries within d of it (per thread; 0 = off)
+    void SetFieldCacheDistance(G4double d);
+    /// evaluate every nth cache hit exactly as well, to measure the cache error
+    void SetFieldCacheCheck(G4int n);
+    void ReportFieldCache();
+    /// MWPC magnetic field from a table around each chamber (default) or from the full profile
+    void SetMWPCBTable(G4bool b);
+    /// compare and time the tabulated MWPC magnetic field against the profile
+    void CheckMWPCField(G4int nPoints);
+    /// per-track integration tolerances, used by the solenoid and MWPC field managers
+    FieldAccuracyPolicy& GetAccuracyPolicy() { return fAccuracyPolicy; }
+    void ReportFieldAccuracy();
+    void SetDeadLayerThickness(G4double t);	///< scintillator dead layer, below the scintillator thickness; resizes the solids in place
+
+    G4double GetMWPCPotential() const { return fMWPCPotential; }
+    G4double GetFieldScale() const { return fFieldScale; }
+    G4double GetVacuumPressure() const { return fVacuumPressure; }
+    G4double GetDeadLayerThickness() const { return fScintDeadLayerThick; }
+
+    // Geometry parameters (/ucn/geometry/ commands). These take effect on the next Construct(),
+    // either at /run/initialize or, once built, through RebuildGeometry().
+    void SetScintThickness(G4double t);		///< must exceed the dead layer thickness
+    void SetScintStepLimit(G4double l) { fScintStepLimit = l; }
+    void SetSourceWindowThickness(G4double t) { fSourceWindowThick = t; }
+    void SetTrapWindowThickness(G4double t) { fTrapWindowThick = t; }
+    void SetTrapCoatingThickness(G4double t) { fTrapCoatingThick = t; }
+    void SetMWPCWindowThickness(G4double t) { fMWPCWindowThick = t; }
+    void SetWireSpacing(G4double d) { fWireSpacing = d; }
+    void SetKevlarSpacing(G4double d) { fKevlarSpacing = d; }
+    void SetKevlarRadius(G4double r) { fKevlarRadius = r; }
+    void SetSourcePosition(G4ThreeVector pos) { fSourcePosition = pos; }
+    void SetSourceWindowMaterial(const G4String& name) { fSourceWindowMatName = name; }
+    void SetTrapWindowMaterial(const G4String& name) { fTrapWindowMatName = name; }
+    void SetMWPCWindowMaterial(const G4String& name) { fMWPCWindowMatName = name; }
+    void SetMWPCFillGas(const G4String& name) { fMWPCGasName = name; }
+
+    G4ThreeVector GetSourcePosition() const { return fSourcePosition; }
+
+    /// throw away the built geometry and construct it again from the current parameters,
+    /// keeping the physics tables (only new material-cuts couples get tables built)
+    void RebuildGeometry();
+    /// whether a constructed geometry exists (false between RebuildGeometry() and the next Construct())
+    G4bool IsBuilt() const { return experimentalHall_log != NULL; }
+
+    /// write the built geometry to a GDML file
+    void ExportGDML(const G4String& fileName);
+    /// fast start: load this GDML snapshot instead of constructing, if its checksum matches the
+    /// current parameters; otherwise construct as usual and refresh the snapshot
+    void SetGDMLCache(const G4String& fileName) { fGDMLCacheFile = fileName; }
+    void SetCheckOverlaps(G4bool b) { fCheckOverlaps = b; }
+    /// MWPC wire planes as G4PVParameterised wires instead of G4PVReplica segments
+    void SetParameterisedWires(G4bool b) { fParameterisedWires = b; }
+    G4bool GetParameterisedWires() const { return fParameterisedWires; }
+
+    /// smart voxel density for the daughters of one logical volume (G4 default 2);
+    /// 0 switches voxelization off for that volume. Applied at once if built, and at every construction
+    void SetSmartless(const G4String& logVolName, G4double smartless);
+    /// voxel settings file ("voxel:" lines with volume and smartless keys, as written by
+    /// /ucn/validate/tuneVoxels), read at every construction; explicit SetSmartless calls take precedence
+    void SetVoxelFile(const G4String& fileName) { fVoxelFile = fileName; }
+
     G4Material* Be; 		///< Beryllium for trap windows
     G4Material* Al; 		///< Aluminum
     G4Material* Si; 		///< Silicon
@@ -113,8 +203,19 @@ class DetectorConstruction : public G4VUserDetectorConstruction
 
   private:
     void DefineMaterials();
+    G4Material* FindMaterial(const G4String& name, G4Material* fallback);
+    void ApplyUserLimits();
+    void ApplyVoxelSettings();
+    G4bool ApplySmartless(const G4String& logVolName, G4double smartless);
+    G4String GeometryParameters() const;
+    G4String GeometryChecksum() const;
+    G4VPhysicalVolume* ReadGDMLCache();
+    void WriteGDMLCache();
+    void RestoreVolumePointers();
+    void ForgetVolumes();		// null the cached volume and solid pointers used outside Construct()
     std::string Append(int i, std::string str);
     void ConstructGlobalField();
+    void ConfigureGlobalStepper();
     void ConstructEastMWPCField(G4double a, G4double b, G4double c, G4double d,
 				G4RotationMatrix* e, G4ThreeVector f);
     void ConstructWestMWPCField(G4double a, G4double b, G4double c, G4double d,
@@ -127,6 +228,101 @@ class DetectorConstruction : public G4VUserDetectorConstruction
 				// f = translation vector of our coordinate system
 
     G4double fScintStepLimit;
+
+    G4double fMWPCPotential;		// mwpc_fieldE0 in Construct()
+    G4double fFieldScale;
+    G4double fVacuumPressure;
+    G4double fScintDeadLayerThick;
+    G4double fScintThick;		// kept for resizing the dead layer
+    G4double fScintN2Volume_Z;
+
+    G4double fSourceWindowThick;
+    G4double fTrapWindowThick;		// decay trap window: mylar
+    G4double fTrapCoatingThick;		// and its Be coating
+    G4double fMWPCWindowThick;
+    G4double fWireSpacing;
+    G4double fWirePlaneSpacing;
+    G4double fAnodeRadius;
+    G4double fKevlarSpacing;
+    G4double fKevlarRadius;
+    G4ThreeVector fSourcePosition;
+    G4String fSourceWindowMatName;
+    G4String fTrapWindowMatName;
+    G4String fMWPCWindowMatName;
+    G4String fMWPCGasName;
+    G4bool fParameterisedWires;
+    G4bool fCheckOverlaps;		// on the top-level placements
+    G4String fGDMLCacheFile;		// "" for no snapshot
+    G4String fVoxelFile;		// "" for G4 defaults
+    std::map<G4String, G4double> fSmartless;	// per logical volume, from /ucn/geometry/smartless
+
+    // fields survive geometry rebuilds; they are updated and re-attached to the new volumes
+    GlobalField* fGlobalField;
+    MWPCField* fMWPCField[2];
+    EnergyAwareFieldManager* fMWPCFieldManager[2];
+    EnergyAwareFieldManager* fGlobalFieldManager;
+    FieldAccuracyPolicy fAccuracyPolicy;
+    CachedMagneticField* fCachedGlobalField;
+    CachedElectroMagneticField* fCachedMWPCField[2];
+    G4double fFieldCacheDistance;
+    G4int fFieldCacheCheck;
+    G4bool fHelixTransport;
+    G4bool fMWPCBTable;
+    UniformFieldHelixStepper* fHelixStepper;
+    G4MagIntegratorStepper* fMixedStepper;
+    G4Tubs* fScintDeadLayerTube;
+    G4Tubs* fScintTube;
+
+    DetectorConstructionMessenger* fMessenger;
+};
+
+/// UI for the DetectorConstruction geometry parameters
+class DetectorConstructionMessenger: public G4UImessenger
+{
+  public:
+    DetectorConstructionMessenger(DetectorConstruction*);
+    ~DetectorConstructionMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    DetectorConstruction* fDetector;
+    G4UIdirectory* fGeometryDir;		///< '/ucn/geometry/' commands directory
+    G4UIdirectory* fFieldDir;			///< '/ucn/field/' commands directory
+    G4UIcmdWithADoubleAndUnit* fScintThickCmd;
+    G4UIcmdWithADoubleAndUnit* fDeadLayerCmd;
+    G4UIcmdWithADoubleAndUnit* fStepLimitCmd;
+    G4UIcmdWithADoubleAndUnit* fSourceWindowThickCmd;
+    G4UIcmdWithADoubleAndUnit* fTrapWindowThickCmd;
+    G4UIcmdWithADoubleAndUnit* fTrapCoatingThickCmd;
+    G4UIcmdWithADoubleAndUnit* fMWPCWindowThickCmd;
+    G4UIcmdWithADoubleAndUnit* fWireSpacingCmd;
+    G4UIcmdWithADoubleAndUnit* fKevlarSpacingCmd;
+    G4UIcmdWithADoubleAndUnit* fKevlarRadiusCmd;
+    G4UIcmdWith3VectorAndUnit* fSourcePosCmd;
+    G4UIcmdWithADoubleAndUnit* fVacuumCmd;
+    G4UIcmdWithAString* fSourceWindowMatCmd;
+    G4UIcmdWithAString* fTrapWindowMatCmd;
+    G4UIcmdWithAString* fMWPCWindowMatCmd;
+    G4UIcmdWithAString* fMWPCGasCmd;
+    G4UIcmdWithoutParameter* fRebuildCmd;
+    G4UIcmdWithAString* fWirePlanesCmd;
+    G4UIcmdWithABool* fCheckOverlapsCmd;
+    G4UIcmdWithAString* fExportGDMLCmd;
+    G4UIcmdWithAString* fGDMLCacheCmd;
+    G4UIcommand* fSmartlessCmd;
+    G4UIcmdWithAString* fVoxelFileCmd;
+    G4UIcmdWithABool* fHelixTransportCmd;
+    G4UIcmdWithADoubleAndUnit* fCacheDistanceCmd;
+    G4UIcmdWithAnInteger* fCacheCheckCmd;
+    G4UIcmdWithoutParameter* fCacheReportCmd;
+    G4UIcmdWithABool* fMWPCBTableCmd;
+    G4UIcmdWithAnInteger* fCheckMWPCFieldCmd;
+    G4UIcmdWithABool* fEnergyAwareCmd;
+    G4UIcmdWithADoubleAndUnit* fLowEnergyCmd;
+    G4UIcmdWithADoubleAndUnit* fHighEnergyCmd;
+    G4UIcmdWithADouble* fCoarseFactorCmd;
+    G4UIcmdWithoutParameter* fAccuracyReportCmd;
 };
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef EnergyAwareFieldManager_h
+#define EnergyAwareFieldManager_h 1
+
+#include "globals.hh"
+#include "G4FieldManager.hh"
+#include "G4SystemOfUnits.hh"
+
+class G4Field;
+class G4Track;
+
+/// Which tracks may be integrated less accurately. Shared by all field managers.
+struct FieldAccuracyPolicy
+{
+  FieldAccuracyPolicy(): enabled(false), lowEnergy(1*keV), highEnergy(10*keV), coarseFactor(10.) {}
+  G4bool enabled;
+  G4double lowEnergy;		///< secondary e-/e+ below this get coarseFactor looser tolerances
+  G4double highEnergy;		///< below this, sqrt(coarseFactor) looser; above, the base tolerances
+  G4double coarseFactor;
+};
+
+/// Field manager choosing its integration tolerances per step from the track:
+/// primaries, non-electron species and energetic secondaries keep the base
+/// (tight) delta chord, delta one step and epsilon range; low-energy secondary
+/// electrons, which stop within a few steps anyway, get looser ones.
+/// The propagator calls ConfigureForTrack() before every step in the field.
+class EnergyAwareFieldManager: public G4FieldManager
+{
+public:
+  EnergyAwareFieldManager(G4Field* field, const FieldAccuracyPolicy* policy);
+
+  /// tolerances for the tight tier; applies them at once
+  void SetBaseAccuracy(G4double deltaChord, G4double deltaOneStep, G4double epsMin, G4double epsMax);
+  void ConfigureForTrack(const G4Track* track);
+
+  /// print the fraction of steps in each tier, then reset the counts
+  void Report(const G4String& name);
+
+  enum Tier { kTight = 0, kMedium = 1, kCoarse = 2 };
+
+private:
+  void ApplyTier(G4int tier);
+
+  const FieldAccuracyPolicy* fPolicy;
+  G4double fDeltaChord;
+  G4double fDeltaOneStep;
+  G4double fEpsMin;
+  G4double fEpsMax;
+  G4int fTier;			// tier of the tolerances currently set
+  long long fSteps[3];		// steps configured per tier
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include "globals.hh"
 #include <G4Event.hh>
 
+#include <vector>
+
 class EventAction : public G4UserEventAction
 {
   public:
@@ -14,13 +16,22 @@ class EventAction : public G4UserEventAction
     virtual void BeginOfEventAction(const G4Event* evt);
     virtual void EndOfEventAction(const G4Event* evt);
 
-    void AddEdep(G4double edep, int typeFlag, int locFlag);
+    /// branch -1 is the trunk, shared by all branches (see ImportanceSplitting)
+    void AddEdep(G4double edep, int typeFlag, int locFlag, int branch = -1);
+    /// the rest of the event runs as nBranches weighted branches; one row each is written
+    void StartBranches(G4int nBranches) { fBranchEdep.assign(4*nBranches, 0.); }
+    G4bool HasBranches() const { return !fBranchEdep.empty(); }
+    void CountStep() { fNSteps++; }	// tallied for the progress report
 
   private:
     G4double  fEdep_East_Scint;
     G4double  fEdep_East_MWPC;
     G4double  fEdep_West_Scint;
     G4double  fEdep_West_MWPC;
+    std::vector<G4double> fBranchEdep;	// per branch: East Scint, East MWPC, West Scint, West MWPC
+
+    G4long    fNSteps;
+    double    fTraceEventBegin;	// start of this event on the RunTracer clock
 
 };
 
@@ -0,0 +1,108 @@
+#ifndef EventTermination_h
+#define EventTermination_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+#include <atomic>
+#include <map>
+
+class G4Step;
+class G4Track;
+class G4VPhysicalVolume;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcmdWithADouble;
+class DetectorConstruction;
+class EventTerminationMessenger;
+
+/// flagged track followed in audit mode until it ends
+struct InertTail
+{
+  double start;		///< flag time [s, steady clock]
+  G4long steps;		///< steps taken since the flag
+  G4double edep;	///< energy deposited in scintillators and MWPCs since the flag
+  G4int reason;
+};
+
+/// Stops tracks that cannot, or are very unlikely to, deposit more energy in a scintillator
+/// (scint_scintillator_log) or an MWPC (mwpc_container_log), so an event ends as soon as its
+/// remaining tracks (almost surely) cannot change the output. A track outside those volumes is inert when:
+/// - stopped: it is an electron and its range is below the safety of its current volume,
+///   so it cannot leave the volume (deposits in daughters, e.g. wires, are not counted either);
+///   positrons are not stopped, since their annihilation gammas still travel;
+/// - absorbed: it is a gamma and the safety exceeds fGammaLengths attenuation lengths. This is
+///   a probabilistic cut: at the default of 10 lengths a gamma reaches the boundary unscattered
+///   with probability e^-10 = 4.5e-5, and scattered gammas can get out too, so killing these biases
+///   the output slightly;
+/// - escaping: it is neutral, in the world volume outside the bounding cylinder of all
+///   world daughters, and moving away from it.
+/// Secondaries leaving an inert track (bremsstrahlung, fluorescence) are neglected; the
+/// audit mode measures this, following flagged tracks to their end and counting any
+/// that still deposit, and times their remaining stepping as the time that kill would save.
+class EventTermination
+{
+  public:
+    static EventTermination* Instance();
+
+    enum Mode { kOff, kAudit, kKill };
+    enum Reason { kNotInert, kStopped, kAbsorbed, kEscaping, kNReasons };
+
+    /// size the escape cylinder from the current geometry and reset the counters
+    void BeginRun();
+    /// print the counts, saved time and audit violations
+    void EndRun();
+
+    G4bool IsEnabled() const { return fMode != kOff; }
+    /// why the track at the end of this step cannot deposit any more (kNotInert if it can)
+    Reason Classify(const G4Step* step, const DetectorConstruction* detector) const;
+    /// the same for a track in the given volume with the given safety, e.g. a new secondary
+    Reason ClassifyAt(const G4Track* track, G4VPhysicalVolume* volume, G4double safety,
+		      const DetectorConstruction* detector) const;
+    /// classify the step's track and kill or audit it; sensitiveEdep is this step's deposit
+    /// in a counted volume, tails the calling thread's audited tracks
+    void Apply(const G4Step* step, const DetectorConstruction* detector, G4double sensitiveEdep,
+	       std::map<G4int, InertTail>& tails);
+
+    void SetMode(const G4String& mode);
+    void SetGammaLengths(G4double n) { fGammaLengths = n; }
+
+  private:
+    EventTermination();
+    G4bool Escaping(const G4Track* track) const;
+
+    Mode fMode;
+    G4double fGammaLengths;		///< attenuation lengths to the boundary for an absorbed gamma
+    G4double fRegionRadius;		///< escape cylinder around the world daughters
+    G4double fRegionHalfZ;
+
+    std::atomic<long long> fInert[kNReasons];	///< tracks flagged per reason
+    std::atomic<long long> fEventsEnded;	///< events whose last track was killed
+    std::atomic<long long> fTailNanoseconds;	///< audit: stepping time of flagged tracks
+    std::atomic<long long> fTailSteps;
+    std::atomic<long long> fTails;
+    std::atomic<long long> fViolations;		///< audit: flagged tracks that deposited anyway
+    std::atomic<long long> fViolationEdep;	///< their deposits [eV]
+    double fRunStart;
+    double fAuditTailPerTrack;			///< mean tail of the last audit run [s], for kill estimates
+
+    EventTerminationMessenger* fMessenger;
+};
+
+/// UI for EventTermination
+class EventTerminationMessenger: public G4UImessenger
+{
+  public:
+    EventTerminationMessenger(EventTermination*);
+    ~EventTerminationMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    EventTermination* fTermination;
+    G4UIdirectory* fTerminationDir;		///< '/ucn/termination/' commands directory
+    G4UIcmdWithAString* fModeCmd;
+    G4UIcmdWithADouble* fGammaLengthsCmd;
+};
+
+#endif
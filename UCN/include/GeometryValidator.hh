@@ -0,0 +1,112 @@
+#ifndef GeometryValidator_h
+#define GeometryValidator_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+#include <vector>
+
+class G4VPhysicalVolume;
+class DetectorConstruction;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithADouble;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcommand;
+class GeometryValidatorMessenger;
+
+/// material traversed in one volume, averaged over the rays that cross it
+struct ThicknessEntry
+{
+  G4String volume;		///< physical volume name (replicas share one entry)
+  G4String material;
+  G4String direction;		///< "axial" (along the solenoid axis) or "transverse"
+  G4double hitFraction;		///< fraction of the rays entering the volume
+  G4double thickness;		///< mean path length per entering ray
+  G4double arealDensity;	///< mean path length * density per entering ray
+};
+
+/// navigation cost of straight electron-like crossings of a wirechamber
+struct NavigationTiming
+{
+  G4double locateTime;		///< LocateGlobalPointAndSetup time per crossing [s]
+  G4double stepTime;		///< ComputeStep time per crossing [s]
+  G4double steps;		///< navigation steps per crossing
+};
+
+/// Geometry validation without firing particles:
+/// - G4 overlap checks on every placement;
+/// - a material-thickness profile per volume from rays cast along and across
+///   the solenoid axis with private navigators, which can be stored as a
+///   reference (QFile format) and diffed against later geometries;
+/// - a navigation benchmark through the West wirechamber, optionally
+///   comparing the replicated and parameterised wire planes;
+/// - smart voxel tuning of the volumes with many daughters, timed on isotropic rays.
+/// Everything runs serially on the master thread: Geant4 navigation and overlap checks
+/// share geometry state that is only safe to use from threads Geant4 itself sets up,
+/// so the checks are not parallelised.
+/// Replaces reading DebuggingGeometry.txt dumps from SteppingAction.
+class GeometryValidator
+{
+  public:
+    GeometryValidator(DetectorConstruction* det);
+    ~GeometryValidator();
+
+    /// overlap-check all placements with nPoints surface points each; returns number overlapping
+    G4int CheckOverlaps(G4int nPoints);
+    /// cast nRays in each direction and rebuild the thickness profile
+    void CastRays(G4int nRays);
+    /// print the current profile, and write it to fileName if not empty
+    void WriteProfile(const G4String& fileName) const;
+    /// compare the current profile with a stored one; returns number of differing entries
+    G4int CompareToReference(const G4String& fileName) const;
+    /// time navigation for nCrossings straight crossings of the West wirechamber
+    NavigationTiming BenchmarkNavigation(G4int nCrossings);
+    /// run the benchmark with replicated and with parameterised wire planes (rebuilds the geometry)
+    void CompareWirePlanes(G4int nCrossings);
+    /// time nRays isotropic rays for a range of smartless values on each volume with at least 3 daughters,
+    /// keep the fastest per volume and write them as a voxel settings file for /ucn/geometry/voxelFile
+    void TuneVoxels(G4int nRays, const G4String& fileName);
+
+    void SetRadius(G4double r) { fRadius = r; }
+    void SetTolerance(G4double t) { fTolerance = t; }
+
+  private:
+    G4VPhysicalVolume* World() const;
+    void CastDirection(G4VPhysicalVolume* world, G4bool axial, G4int nRays);
+    G4bool RebuildNow();		///< rebuild now; false if no world afterwards
+    G4double TimeRays(G4VPhysicalVolume* world, G4int nRays) const;
+
+    DetectorConstruction* fDetector;
+    G4double fRadius;			///< half-width of the ray bundle around the axis
+    G4double fTolerance;		///< relative thickness difference flagged by the comparison
+    std::vector<ThicknessEntry> fProfile;
+
+    GeometryValidatorMessenger* fMessenger;
+};
+
+/// UI for GeometryValidator
+class GeometryValidatorMessenger: public G4UImessenger
+{
+  public:
+    GeometryValidatorMessenger(GeometryValidator*);
+    ~GeometryValidatorMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    GeometryValidator* fValidator;
+    G4UIdirectory* fValidateDir;		///< '/ucn/validate/' commands directory
+    G4UIcmdWithAnInteger* fOverlapsCmd;
+    G4UIcmdWithAnInteger* fRaysCmd;
+    G4UIcmdWithADoubleAndUnit* fRadiusCmd;
+    G4UIcmdWithADouble* fToleranceCmd;
+    G4UIcmdWithAString* fWriteCmd;
+    G4UIcmdWithAString* fCompareCmd;
+    G4UIcmdWithAnInteger* fNavBenchCmd;
+    G4UIcmdWithAnInteger* fWirePlanesCmd;
+    G4UIcommand* fTuneVoxelsCmd;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define GlobalField_h 1
 
 #include <vector>
+#include <cmath>
 #include "G4MagneticField.hh"
 #include "G4UniformMagField.hh"
 
@@ -21,6 +22,11 @@ public:
   void GetFieldValue( const G4double Point[3], G4double *Bfield ) const;
   void SetFieldScale(G4double val) { fFieldScale = val; }
 
+  /// whether z lies in a section where the profile is flat (B along z only), and if so
+  /// its z range and (scaled) B_z. Valid for radii below GetMaxRadius().
+  G4bool UniformSection(G4double z, G4double& zMin, G4double& zMax, G4double& Bz) const;
+  G4double GetMaxRadius() const { return sqrt(fSqOfMaxRadius); }
+
 private:
   void AddPoint(G4double zPositions, G4double BValues);
   vector<G4double> Bpoints; ///< field profile B values
@@ -0,0 +1,83 @@
+#ifndef ImportanceSplitting_h
+#define ImportanceSplitting_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+#include "G4VUserTrackInformation.hh"
+
+class G4Step;
+class G4UIdirectory;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithAString;
+class G4UIcmdWithADoubleAndUnit;
+class DetectorConstruction;
+class ImportanceSplittingMessenger;
+
+/// Branch of the event a track belongs to after a split. Tracks without it belong
+/// to the trunk, whose energy deposits are shared by every branch.
+class BranchInfo: public G4VUserTrackInformation
+{
+  public:
+    BranchInfo(G4int branch): fBranch(branch) {}
+    G4int GetBranch() const { return fBranch; }
+
+  private:
+    G4int fBranch;
+};
+
+/// Importance splitting for backscatter studies. The first electron of an event
+/// (above a minimum energy) to backscatter out of an MWPC or a scintillator, i.e.
+/// to leave it heading back towards the decay trap, is split into N copies of
+/// weight 1/N, each the start of one branch of the event; their secondaries
+/// inherit the branch. Copies keep the original's parent ID, so every branch is
+/// transported alike. EventAction then writes one output row per
+/// branch, with trunk + branch deposits and weight 1/N, so weighted spectra
+/// reproduce unbiased ones. One split level per event keeps the weights exact.
+class ImportanceSplitting
+{
+  public:
+    static ImportanceSplitting* Instance();
+
+    G4bool IsEnabled() const { return fSplitFactor > 1; }
+    /// whether this step is a splittable track backscattering out of a splitting volume
+    G4bool IsSplitPoint(const G4Step* step, const DetectorConstruction* detector) const;
+    /// add fSplitFactor - 1 copies of the step's track at its post-step point to the
+    /// step's secondaries; the track itself continues as branch 0
+    void Split(const G4Step* step) const;
+    /// give new secondaries the branch of their parent
+    static void PropagateBranch(const G4Step* step);
+
+    void SetSplitFactor(G4int n) { fSplitFactor = n; }
+    G4int GetSplitFactor() const { return fSplitFactor; }
+    void SetMinEnergy(G4double E) { fMinEnergy = E; }
+    void SetSplitVolumes(const G4String& where);
+
+  private:
+    ImportanceSplitting();
+
+    G4int fSplitFactor;		///< copies per split; 1 = no splitting
+    G4double fMinEnergy;	///< electrons below this are not split
+    G4bool fAtMWPC;		///< split on backscattering out of an MWPC container
+    G4bool fAtScint;		///< split on backscattering out of a scintillator container
+
+    ImportanceSplittingMessenger* fMessenger;
+};
+
+/// UI for ImportanceSplitting
+class ImportanceSplittingMessenger: public G4UImessenger
+{
+  public:
+    ImportanceSplittingMessenger(ImportanceSplitting*);
+    ~ImportanceSplittingMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    ImportanceSplitting* fSplitting;
+    G4UIdirectory* fBiasDir;			///< '/ucn/bias/' commands directory
+    G4UIcmdWithAnInteger* fSplitCmd;
+    G4UIcmdWithADoubleAndUnit* fMinEnergyCmd;
+    G4UIcmdWithAString* fVolumesCmd;
+};
+
+#endif
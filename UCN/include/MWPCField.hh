@@ -29,17 +29,29 @@ public:
 
 
   void SetPotential(G4double Vanode);
+  void SetFieldScale(G4double val) { fFieldScale = val; }
   void SetActiveReg_d(G4double activeRegion_d) {d = activeRegion_d;};
   void SetActiveReg_L(G4double activeRegion_L) {L = activeRegion_L;};
   void SetActiveReg_r(G4double activeRegion_r) {r = activeRegion_r;};
   void SetSideRot(G4RotationMatrix* sideRot) {fChamberRot = sideRot;};
-  void SetSideTrans(G4ThreeVector sideTrans) {fChamberTrans = sideTrans;};
+  void SetSideTrans(G4ThreeVector sideTrans) {fChamberTrans = sideTrans; BuildBTable();};
+
+  /// B inside the chamber from a table of the solenoid profile around it (default),
+  /// instead of evaluating the profile on every call
+  void SetBTable(G4bool b) { fUseBTable = b; };
+  /// compare tabulated and profile B at nPoints random points in the chamber, and time
+  /// the field with the profile, with the table, and the E field alone
+  void CheckBTable(G4int nPoints);
 
 protected:
   G4double fE0;		// apparently a field scaling constant
 
 private:
   void AddPoint(G4double zPositions, G4double BValues);
+  void ProfileB(const G4double Point[4], G4double *Bfield) const;
+  void ElectricField(const G4double Point[4], G4double *Bfield) const;
+  void ProfileBz(G4double z, G4double& Bz, G4double& dBzdz) const;
+  void BuildBTable();
   vector<G4double> Bpoints; ///< field profile B values
   vector<G4double> Zpoints; ///< field profile z positions
 
@@ -52,6 +64,13 @@ private:
   G4RotationMatrix* fChamberRot;
   G4ThreeVector fChamberTrans;
 
+  // unscaled B_z and dB_z/dz on a fine z grid around the chamber, for cubic Hermite interpolation
+  G4bool fUseBTable;
+  vector<G4double> fTableBz;
+  vector<G4double> fTableDBz;
+  G4double fTableZ0;
+  G4double fTableStep;
+
 };
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "ElectronBindingEnergy.hh"
 #include "NuclEvtGen.hh"
+#include "CompactEventFile.hh"
 #include "DetectorConstruction.hh"
 
 #include "G4VUserPrimaryGeneratorAction.hh"	// original example used these 3
@@ -14,11 +15,20 @@
 #include <G4ParticleGun.hh>
 #include <G4Event.hh>
 #include <G4VUserEventInformation.hh>
+#include "G4UImessenger.hh"
+
+#include <vector>
 
 class G4ParticleGun;
 class G4Event;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class PrimaryGeneratorActionMessenger;
 
 /// The primary generator action class with particle gun.
+/// Fires the 113Sn source by default, or the pre-generated events of a compact
+/// event file (see CompactEventFile; vertices in m relative to the source position,
+/// times in s), read in order and started over at the end.
 
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 {
@@ -31,17 +41,44 @@ class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
 
     // method to access particle gun
     const G4ParticleGun* GetParticleGun() const { return fParticleGun; }
+    /// primary columns written at the start of the current event's output row
+    const G4String& GetRowPrefix() const { return fRowPrefix; }
+
+    /// read primaries from a compact event file; "none" returns to the 113Sn source
+    void SetEventFile(const G4String& fileName);
 
   private:
     G4ParticleGun*  fParticleGun; // pointer a to G4 gun class
     DetectorConstruction* fMyDetector;	// pointer to the detector geometry class
 
     double fSourceRadius;
+    G4String fRowPrefix;			///< primary columns of the current event's output row
+
+    CompactEventFile* fEventFile;		///< pre-generated events, or NULL
+    std::vector<NucDecayEvent> fFileEvent;	///< primaries of the current event from fEventFile
+    PrimaryGeneratorActionMessenger* fMessenger;
 
     void DiskRandom(G4double radius, G4double& x, G4double& y);
     void DisplayGunStatus();
     void Set_113SnSource();
+    void LoadFileEvent();
+    void AddFilePrimaries(G4Event* anEvent);
+
+};
 
+/// UI for PrimaryGeneratorAction
+class PrimaryGeneratorActionMessenger: public G4UImessenger
+{
+  public:
+    PrimaryGeneratorActionMessenger(PrimaryGeneratorAction*);
+    ~PrimaryGeneratorActionMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    PrimaryGeneratorAction* fGenerator;
+    G4UIdirectory* fGunDir;			///< '/ucn/gun/' commands directory
+    G4UIcmdWithAString* fEventFileCmd;
 };
 
 #endif
@@ -0,0 +1,74 @@
+#ifndef ProgressMonitor_h
+#define ProgressMonitor_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+#include <atomic>
+
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAString;
+class G4UIcmdWithADoubleAndUnit;
+class ProgressMonitorMessenger;
+
+/// Lightweight run progress reporter. Events and steps are tallied with atomic
+/// counters from EndOfEventAction; whichever thread first crosses the report time
+/// claims the report with a compare-and-swap, so the event loop never takes a lock.
+/// Reports events/s, ETA, steps per event, memory use and the per-thread split
+/// to stdout and (atomically replaced) to a JSON progress file for batch polling.
+class ProgressMonitor
+{
+  public:
+    static ProgressMonitor* Instance();
+
+    /// reset counters at the start of a run of nEvents
+    void BeginRun(G4int nEvents);
+    /// tally one finished event with its step count; may emit a report
+    void EventDone(G4long nSteps);
+    /// final report at the end of the run
+    void EndRun();
+
+    void SetEnabled(G4bool b) { fEnabled = b; }
+    void SetInterval(G4double t) { fInterval = t; }
+    void SetFileName(const G4String& f) { fFileName = f; }
+
+    static const int kMaxThreads = 64;	///< threads beyond this share the last per-thread slot
+
+  private:
+    ProgressMonitor();
+    double Elapsed() const;
+    void Report(G4bool final);
+
+    G4bool fEnabled;
+    G4double fInterval;			///< seconds between reports
+    G4String fFileName;			///< progress file; empty for console only
+    G4int fEventsToProcess;
+
+    double fRunStart;				///< run start [s, steady clock]
+    std::atomic<long long> fEvents;
+    std::atomic<long long> fSteps;
+    std::atomic<long long> fNextReport;		///< next report time [ms since run start]
+    std::atomic<long long> fThreadEvents[kMaxThreads];
+
+    ProgressMonitorMessenger* fMessenger;
+};
+
+/// UI for ProgressMonitor
+class ProgressMonitorMessenger: public G4UImessenger
+{
+  public:
+    ProgressMonitorMessenger(ProgressMonitor*);
+    ~ProgressMonitorMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    ProgressMonitor* fMonitor;
+    G4UIdirectory* fProgressDir;		///< '/ucn/progress/' commands directory
+    G4UIcmdWithABool* fEnableCmd;
+    G4UIcmdWithADoubleAndUnit* fIntervalCmd;
+    G4UIcmdWithAString* fFileCmd;
+};
+
+#endif
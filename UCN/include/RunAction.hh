@@ -15,6 +15,13 @@ class RunAction : public G4UserRunAction
 
     virtual void BeginOfRunAction(const G4Run*);
     virtual void   EndOfRunAction(const G4Run*);
+
+    // text output file shared by the primary generator, event and run actions
+    static void SetOutputFileName(const G4String& name) { fOutputFileName = name; }
+    static const G4String& GetOutputFileName() { return fOutputFileName; }
+
+  private:
+    static G4String fOutputFileName;
 };
 
 #endif
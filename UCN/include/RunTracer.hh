@@ -0,0 +1,111 @@
+#ifndef RunTracer_h
+#define RunTracer_h 1
+
+#include "globals.hh"
+#include "G4Threading.hh"
+#include "G4VStateDependent.hh"
+#include "G4UImessenger.hh"
+
+#include <string>
+#include <vector>
+
+class G4UIdirectory;
+class G4UIcmdWithABool;
+class G4UIcmdWithAString;
+class G4UIcmdWithoutParameter;
+class RunTracerMessenger;
+
+/// one timestamped span on the run timeline
+struct TraceSpan
+{
+  std::string name;	///< span name shown in the trace viewer
+  std::string cat;	///< span category (init, state, event, output)
+  double ts;		///< start time [us since tracer creation]
+  double dur;		///< duration [us]
+  G4int tid;		///< thread the span was recorded on (0 = master)
+};
+
+/// Records begin/end spans for the run phases on every thread and writes them
+/// in the Chrome trace-event JSON format (load in chrome://tracing or Perfetto).
+/// Disabled by default; turn on with /ucn/trace/enable true before /run/initialize.
+class RunTracer
+{
+  public:
+    static RunTracer* Instance();
+    ~RunTracer();
+
+    /// cheap check used by the instrumentation points
+    static G4bool IsEnabled() { return fEnabled; }
+    /// whether per-event spans are wanted as well
+    static G4bool TraceEvents() { return fEnabled && fTraceEvents; }
+
+    void SetEnabled(G4bool b);
+    void SetTraceEvents(G4bool b) { fTraceEvents = b; }
+    void SetFileName(const G4String& f) { fFileName = f; }
+
+    /// current time [us] on the tracer clock
+    double Now() const;
+    /// record a finished span on the calling thread
+    void Record(const char* name, const char* cat, double tBegin, double tEnd);
+    /// follow application state changes (Init, Idle, GeomClosed, EventProc) on the calling thread
+    void AttachToThread();
+    /// write everything recorded so far to the trace file
+    void Write();
+
+  private:
+    RunTracer();
+    std::vector<TraceSpan>* LocalSpans();
+
+    static G4bool fEnabled;
+    static G4bool fTraceEvents;
+
+    G4String fFileName;
+    std::vector< std::vector<TraceSpan>* > fThreadSpans;	///< per-thread buffers, registered once per thread
+    RunTracerMessenger* fMessenger;
+};
+
+/// RAII helper: records a span from construction to destruction when tracing is enabled
+class TraceScope
+{
+  public:
+    TraceScope(const char* name, const char* cat = "init")
+    : fName(name), fCat(cat), fBegin(RunTracer::IsEnabled() ? RunTracer::Instance()->Now() : -1) {}
+    ~TraceScope() { if(fBegin >= 0) RunTracer::Instance()->Record(fName, fCat, fBegin, RunTracer::Instance()->Now()); }
+
+  private:
+    const char* fName;
+    const char* fCat;
+    double fBegin;
+};
+
+/// turns G4 application state transitions into spans on its own thread
+class RunTracerStateObserver : public G4VStateDependent
+{
+  public:
+    RunTracerStateObserver();
+    virtual G4bool Notify(G4ApplicationState requestedState);
+
+  private:
+    G4ApplicationState fState;
+    double fStateBegin;
+};
+
+/// UI for RunTracer
+class RunTracerMessenger: public G4UImessenger
+{
+  public:
+    RunTracerMessenger(RunTracer*);
+    ~RunTracerMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    RunTracer* fTracer;
+    G4UIdirectory* fTraceDir;		///< '/ucn/trace/' commands directory
+    G4UIcmdWithABool* fEnableCmd;
+    G4UIcmdWithABool* fEventsCmd;
+    G4UIcmdWithAString* fFileCmd;
+    G4UIcmdWithoutParameter* fWriteCmd;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef StackingAction_h
+#define StackingAction_h 1
+
+#include "G4UserStackingAction.hh"
+#include "G4UImessenger.hh"
+#include "globals.hh"
+
+class DetectorConstruction;
+class G4Navigator;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcmdWithADoubleAndUnit;
+class G4UIcmdWithoutParameter;
+class StackingActionMessenger;
+
+/// Orders (and optionally prunes) the tracks of an event. New tracks are sorted into
+/// classes, each with a configurable stack:
+/// - primary: always urgent;
+/// - detectorCharged: charged tracks inside a scintillator or MWPC container, always urgent;
+/// - charged: other charged tracks (urgent or waiting);
+/// - lowGamma: gammas below an energy threshold outside the detector containers
+///   (urgent, waiting, or kill; kill only drops those EventTermination finds escaping
+///   at their birth point, which cannot come back, and the others wait);
+/// - other: everything else, urgent.
+/// Waiting tracks are tracked after the urgent stack is empty, which only changes the
+/// order deposits are summed in; the defaults (all urgent) reproduce the LIFO order of
+/// running without a stacking action. Per-class counts and energies are printed at the
+/// end of each run.
+class StackingAction : public G4UserStackingAction
+{
+  public:
+    StackingAction(DetectorConstruction* det);
+    virtual ~StackingAction();
+
+    virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track* track);
+
+    enum TrackClass { kPrimary, kDetectorCharged, kCharged, kLowGamma, kOther, kNClasses };
+
+    /// per-class statistics of the current run
+    void Report() const;
+    /// whether any class goes somewhere other than the urgent stack
+    G4bool IsActive() const { return fChargedStack != fUrgent || fLowGammaStack != fUrgent; }
+
+    void SetChargedStack(const G4String& stack);
+    void SetLowGammaStack(const G4String& stack);
+    void SetLowGammaEnergy(G4double E) { fLowGammaEnergy = E; }
+
+  private:
+    TrackClass Classify(const G4Track* track) const;
+    G4bool InDetector(const G4Track* track) const;
+    G4bool Escaping(const G4Track* track);
+    void StartRun(G4int runID);
+
+    DetectorConstruction* fDetector;
+    G4ClassificationOfNewTrack fChargedStack;
+    G4ClassificationOfNewTrack fLowGammaStack;
+    G4double fLowGammaEnergy;
+    G4Navigator* fNavigator;		///< private navigator for the safety at a track's birth point
+    G4int fRunID;			///< run the statistics belong to
+
+    G4long fNTracks[kNClasses];
+    G4long fNWaiting[kNClasses];
+    G4long fNKilled[kNClasses];
+    G4double fEnergy[kNClasses];	///< summed kinetic energy at birth
+
+    StackingActionMessenger* fMessenger;
+};
+
+/// UI for StackingAction
+class StackingActionMessenger: public G4UImessenger
+{
+  public:
+    StackingActionMessenger(StackingAction*);
+    ~StackingActionMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    StackingAction* fStacking;
+    G4UIdirectory* fStackDir;			///< '/ucn/stack/' commands directory
+    G4UIcmdWithAString* fChargedCmd;
+    G4UIcmdWithAString* fLowGammaCmd;
+    G4UIcmdWithADoubleAndUnit* fLowGammaEnergyCmd;
+    G4UIcmdWithoutParameter* fReportCmd;
+};
+
+#endif
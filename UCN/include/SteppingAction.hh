@@ -3,6 +3,9 @@
 
 #include "G4UserSteppingAction.hh"
 #include "globals.hh"
+#include "EventTermination.hh"
+
+#include <map>
 
 class EventAction;
 class G4LogicalVolume;
@@ -21,6 +24,7 @@ class SteppingAction : public G4UserSteppingAction
 
   private:
     EventAction*  fEventAction;
+    std::map<G4int, InertTail> fInertTails;	// tracks followed by an EventTermination audit
 
 };
 
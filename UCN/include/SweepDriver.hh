@@ -0,0 +1,65 @@
+#ifndef SweepDriver_h
+#define SweepDriver_h 1
+
+#include "globals.hh"
+#include "G4UImessenger.hh"
+
+class DetectorConstruction;
+class Stringmap;
+class G4UIdirectory;
+class G4UIcmdWithAString;
+class G4UIcmdWithAnInteger;
+class SweepDriverMessenger;
+
+/// Runs a list of parameter points as sub-runs of one process.
+/// Points are read from a QFile-format list, one "point:" line each, e.g.
+///
+///   point:  name = lowV   mwpcV = 2500   fieldScale = 1.0   vacuum = 1e-5   deadLayer = 3.0   events = 10000
+///
+/// (mwpcV in volts, vacuum in torr, deadLayer in um). Keys left out keep the previous
+/// value. Between sub-runs only what changed is updated: the MWPC potential and field
+/// scale on the existing field objects, the vacuum by a material swap, the dead layer by
+/// resizing its solids; geometry and physics are never rebuilt from scratch.
+/// Each point writes to its own output file, <base>_<name>.txt.
+///
+/// CompareFieldAccuracy() is an A/B pair of sub-runs with the same seed, with and without
+/// the energy-aware field tolerances, comparing the scintillator spectra and run times.
+class SweepDriver
+{
+  public:
+    SweepDriver(DetectorConstruction* det);
+    ~SweepDriver();
+
+    void Run(const G4String& pointsFile);
+    void CompareFieldAccuracy(G4int nEvents);
+    void SetEventsPerPoint(G4int n) { fEventsPerPoint = n; }
+    void SetOutputBase(const G4String& b) { fOutputBase = b; }
+
+  private:
+    void ApplyPoint(const Stringmap& point);
+
+    DetectorConstruction* fDetector;
+    G4int fEventsPerPoint;		///< events for points without an "events" key
+    G4String fOutputBase;		///< output file name stem
+    SweepDriverMessenger* fMessenger;
+};
+
+/// UI for SweepDriver
+class SweepDriverMessenger: public G4UImessenger
+{
+  public:
+    SweepDriverMessenger(SweepDriver*);
+    ~SweepDriverMessenger();
+
+    void SetNewValue(G4UIcommand*, G4String);
+
+  private:
+    SweepDriver* fSweep;
+    G4UIdirectory* fSweepDir;		///< '/ucn/sweep/' commands directory
+    G4UIcmdWithAString* fRunCmd;
+    G4UIcmdWithAnInteger* fEventsCmd;
+    G4UIcmdWithAString* fOutputCmd;
+    G4UIcmdWithAnInteger* fCompareAccuracyCmd;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef UniformFieldHelixStepper_h
+#define UniformFieldHelixStepper_h 1
+
+#include "G4MagHelicalStepper.hh"
+
+class GlobalField;
+class G4Mag_EqRhs;
+
+/// Stepper for the solenoid field: where a whole step stays inside one of the flat
+/// sections of the GlobalField profile (1.0 T centre, 0.6 T detector ends), the track
+/// is advanced along the exact helix with the known section field, without any field
+/// evaluations and with zero truncation error. Steps that may reach a cosine transition
+/// or the edge of the field radius go to the fallback stepper.
+class UniformFieldHelixStepper: public G4MagHelicalStepper
+{
+public:
+  UniformFieldHelixStepper(G4Mag_EqRhs* equation, const GlobalField* field, G4MagIntegratorStepper* fallback);
+
+  void Stepper(const G4double yInput[], const G4double dydx[], G4double h, G4double yOutput[], G4double yError[]);
+  void DumbStepper(const G4double yInput[], G4ThreeVector Bfield, G4double h, G4double yOutput[]);
+  G4double DistChord() const;
+  G4int IntegratorOrder() const;
+
+  G4double GetExactFraction() const { return fExactSteps + fFallbackSteps ? fExactSteps/(fExactSteps + fFallbackSteps) : 0; }
+
+private:
+  const GlobalField* fField;
+  G4MagIntegratorStepper* fFallback;	// numerical stepper for the transition regions
+  G4bool fLastExact;			// which stepper made the last step, for DistChord
+  G4double fExactSteps;
+  G4double fFallbackSteps;
+};
+
+#endif
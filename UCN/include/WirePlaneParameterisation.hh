@@ -0,0 +1,24 @@
+#ifndef WirePlaneParameterisation_h
+#define WirePlaneParameterisation_h 1
+
+#include "globals.hh"
+#include "G4VPVParameterisation.hh"
+
+class G4VPhysicalVolume;
+
+/// Places the wires of one MWPC plane as copies of a single volume, spaced along x
+/// and centred in the plane container. Same positions as the G4PVReplica segments
+/// it replaces, without the intermediate segment volume.
+class WirePlaneParameterisation: public G4VPVParameterisation
+{
+public:
+  WirePlaneParameterisation(G4int nWires, G4double spacing);
+
+  void ComputeTransformation(const G4int copyNo, G4VPhysicalVolume* physVol) const;
+
+private:
+  G4int fNWires;
+  G4double fSpacing;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <cmath>
+
+#include "CachedField.hh"
+
+#include "G4Threading.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstdio>
+using   namespace       std;
+
+FieldValueCache::FieldValueCache(G4int nComponents)
+ : fNComponents(nComponents), fDistance2(0), fCheckEvery(0), fGeneration(0)
+{
+}
+
+void FieldValueCache::Evaluate(const G4Field* field, const G4double point[4], G4double* value) const
+{
+  int slot = G4Threading::G4GetThreadId() + 1;
+  if(fDistance2 <= 0 || slot < 0 || slot > kMaxThreads)
+  {
+    field->GetFieldValue(point, value);
+    return;
+  }
+
+  Slot& s = fSlots[slot];
+  s.calls++;
+  long generation = fGeneration.load(memory_order_relaxed);
+  G4double dx = point[0] - s.point[0], dy = point[1] - s.point[1], dz = point[2] - s.point[2];
+  if(s.generation == generation && dx*dx + dy*dy + dz*dz <= fDistance2)
+  {
+    for(int i = 0; i < fNComponents; i++) value[i] = s.value[i];
+    s.hits++;
+    if(fCheckEvery > 0 && s.hits % fCheckEvery == 0)
+    {
+      G4double exact[6];
+      field->GetFieldValue(point, exact);
+      G4double dB = sqrt(pow(value[0]-exact[0], 2) + pow(value[1]-exact[1], 2) + pow(value[2]-exact[2], 2));
+      s.sumDevB += dB;
+      s.maxDevB = max(s.maxDevB, dB);
+      if(fNComponents == 6)
+      {
+	G4double dE = sqrt(pow(value[3]-exact[3], 2) + pow(value[4]-exact[4], 2) + pow(value[5]-exact[5], 2));
+	s.sumDevE += dE;
+	s.maxDevE = max(s.maxDevE, dE);
+      }
+      s.checks++;
+    }
+    return;
+  }
+
+  field->GetFieldValue(point, value);
+  for(int i = 0; i < 3; i++) s.point[i] = point[i];
+  for(int i = 0; i < fNComponents; i++) s.value[i] = value[i];
+  s.generation = generation;
+}
+
+void FieldValueCache::Report(const G4String& name)
+{
+  long long calls = 0, hits = 0, checks = 0;
+  G4double sumDevB = 0, maxDevB = 0, sumDevE = 0, maxDevE = 0;
+  for(int i = 0; i <= kMaxThreads; i++)
+  {
+    Slot& s = fSlots[i];
+    calls += s.calls;
+    hits += s.hits;
+    checks += s.checks;
+    sumDevB += s.sumDevB;
+    maxDevB = max(maxDevB, s.maxDevB);
+    sumDevE += s.sumDevE;
+    maxDevE = max(maxDevE, s.maxDevE);
+    s.calls = s.hits = s.checks = 0;
+    s.sumDevB = s.maxDevB = s.sumDevE = s.maxDevE = 0;
+  }
+
+  char line[256];
+  snprintf(line, sizeof(line), "%s field cache (%.3g um): %lld queries, %.1f%% hits\n", name.c_str(),
+	   GetDistance()/um, calls, calls ? 100.*hits/calls : 0.);
+  G4cout << line;
+  if(!checks) return;
+  snprintf(line, sizeof(line), "  %lld hits checked: |dB| mean %.3g, max %.3g T", checks, sumDevB/checks/tesla, maxDevB/tesla);
+  G4cout << line;
+  if(fNComponents == 6)
+  {
+    snprintf(line, sizeof(line), "; |dE| mean %.3g, max %.3g kV/cm", sumDevE/checks/(kilovolt/cm), maxDevE/(kilovolt/cm));
+    G4cout << line;
+  }
+  G4cout << G4endl;
+}
@@ -1,6 +1,13 @@
 #include "DetectorConstruction.hh"
 #include "GlobalField.hh"
 #include "MWPCField.hh"
+#include "UniformFieldHelixStepper.hh"
+#include "CachedField.hh"
+#include "EnergyAwareFieldManager.hh"
+#include "WirePlaneParameterisation.hh"
+#include "RunTracer.hh"
+#include "QFile.hh"
+#include "PathUtils.hh"
 
 #include "G4RunManager.hh"
 #include "G4NistManager.hh"
@@ -10,9 +17,23 @@
 #include "G4Sphere.hh"
 #include "G4Trd.hh"
 #include "G4LogicalVolume.hh"
+#include "G4LogicalVolumeStore.hh"
 #include "G4PVPlacement.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4AutoDelete.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWith3VectorAndUnit.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIparameter.hh"
+#include "G4PhysicalVolumeStore.hh"
+#ifdef UCN_USE_GDML
+#include "G4GDMLParser.hh"
+#endif
 
 #include <G4UserLimits.hh>		// stole from Michael Mendenhall's code.
 
@@ -31,6 +52,8 @@
 #include <G4SystemOfUnits.hh>
 
 #include <cassert>			// scintillator construction classes
+#include <cstdio>
+#include <fstream>
 #include <G4Polycone.hh>
 
 #include <math.h>			// Used in WirechamberConstruction
@@ -74,15 +97,63 @@
 
 DetectorConstruction::DetectorConstruction()
 : G4VUserDetectorConstruction(),
-  fScintStepLimit(1.0*mm)	// note: fScintStepLimit initialized here
-{ }
+  Vacuum(NULL),
+  experimentalHall_log(NULL),
+  experimentalHall_phys(NULL),
+  fScintStepLimit(1.0*mm),	// note: fScintStepLimit initialized here
+  fMWPCPotential(2700*volt),
+  fFieldScale(1.0),
+  fVacuumPressure(0),
+  fScintDeadLayerThick(3.0*um),
+  fScintThick(3.5*mm),
+  fScintN2Volume_Z(0),
+  fSourceWindowThick(4.7*um),
+  fTrapWindowThick(0.180*um),
+  fTrapCoatingThick(0.150*um),
+  fMWPCWindowThick(6*um),
+  fWireSpacing(2.54*mm),
+  fWirePlaneSpacing(1*cm),
+  fAnodeRadius(5*um),
+  fKevlarSpacing(5.0*mm),
+  fKevlarRadius(0.07*mm),
+  fSourcePosition(0,0,0),
+  fSourceWindowMatName("Mylar"),
+  fTrapWindowMatName("Mylar"),
+  fMWPCWindowMatName("Mylar"),
+  fMWPCGasName("Pentane"),
+  fParameterisedWires(false),
+  fCheckOverlaps(true),
+  fGDMLCacheFile(""),
+  fVoxelFile(""),
+  fGlobalField(NULL),
+  fGlobalFieldManager(NULL),
+  fCachedGlobalField(NULL),
+  fFieldCacheDistance(0.),
+  fFieldCacheCheck(0),
+  fHelixTransport(true),
+  fMWPCBTable(true),
+  fHelixStepper(NULL),
+  fMixedStepper(NULL),
+  fScintDeadLayerTube(NULL),
+  fScintTube(NULL)
+{
+  fMWPCField[0] = fMWPCField[1] = NULL;
+  fCachedMWPCField[0] = fCachedMWPCField[1] = NULL;
+  fMWPCFieldManager[0] = fMWPCFieldManager[1] = NULL;
+  ForgetVolumes();
+  fMessenger = new DetectorConstructionMessenger(this);
+}
 
 
 DetectorConstruction::~DetectorConstruction()
-{ }
+{
+  delete fMessenger;
+}
 
 void DetectorConstruction::DefineMaterials()
 {
+  TraceScope trace("DefineMaterials");
+  if(G4Material::GetMaterial("Scintillator", false) != NULL) return;	// geometry rebuild: materials are kept
   Vacuum = NULL;		//This value is set later using the setVacuumPressure method.
   string name,symbol;
   int z;
@@ -154,23 +225,332 @@ void DetectorConstruction::SetVacuumPressure(G4double pressure)
 {
   // our slightly crappy vacuum: low-pressure air (density @20c; 1.290*mg/cm3 @STP)
   G4cout<<"------------- Detector vacuum is set at "<<pressure/torr<<" Torr"<<G4endl;
-  Vacuum = new G4Material("Vacuum",1.2048*mg/cm3*pressure/atmosphere,2,kStateGas,293*kelvin,pressure);
-  Vacuum->AddElement(G4Element::GetElement("N"),0.78);
-  Vacuum->AddElement(G4Element::GetElement("O"),0.22);
+  fVacuumPressure = pressure;
+  if(G4Element::GetElement("N", false) == NULL) return;	// materials not defined yet; Construct() uses fVacuumPressure
+  if(Vacuum != NULL && Vacuum->GetPressure() == pressure) return;	// unchanged, e.g. on a geometry rebuild
+  G4Material* oldVacuum = Vacuum;
+
+  // materials can't be deleted or re-densified, so each pressure gets its own material, reused when
+  // the pressure comes back. The first keeps the plain name "Vacuum", as in the default geometry and
+  // GDML output; other pressures get "Vacuum_<P>torr".
+  stringstream vacName;
+  vacName << "Vacuum";
+  Vacuum = G4Material::GetMaterial(vacName.str(), false);
+  if(Vacuum != NULL && Vacuum->GetPressure() != pressure)
+  {
+    vacName << "_" << pressure/torr << "torr";
+    Vacuum = G4Material::GetMaterial(vacName.str(), false);
+  }
+  if(Vacuum == NULL)
+  {
+    Vacuum = new G4Material(vacName.str(),1.2048*mg/cm3*pressure/atmosphere,2,kStateGas,293*kelvin,pressure);
+    Vacuum->AddElement(G4Element::GetElement("N"),0.78);
+    Vacuum->AddElement(G4Element::GetElement("O"),0.22);
+  }
+
+  // after construction: swap the material in every volume that used the old vacuum.
+  // Only the new material-cuts couple needs tables, the geometry is untouched.
+  if(experimentalHall_log != NULL && oldVacuum != NULL && oldVacuum != Vacuum)
+  {
+    G4LogicalVolumeStore* lvStore = G4LogicalVolumeStore::GetInstance();
+    for(G4LogicalVolumeStore::iterator it = lvStore->begin(); it != lvStore->end(); it++)
+    {
+      if((*it)->GetMaterial() == oldVacuum) (*it)->SetMaterial(Vacuum);
+    }
+    G4RunManager::GetRunManager()->PhysicsHasBeenModified();
+  }
+}
+
+void DetectorConstruction::SetMWPCPotential(G4double V)
+{
+  fMWPCPotential = V;
+  for(int i = 0; i <= 1; i++)
+  {
+    if(fMWPCField[i] != NULL) fMWPCField[i] -> SetPotential(V);
+    if(fCachedMWPCField[i] != NULL) fCachedMWPCField[i] -> GetCache().Invalidate();
+  }
+}
+
+void DetectorConstruction::SetFieldScale(G4double scale)
+{
+  G4cout << "Setting magnetic field scale to " << scale << G4endl;
+  fFieldScale = scale;
+  if(fGlobalField != NULL) fGlobalField -> SetFieldScale(scale);
+  if(fCachedGlobalField != NULL) fCachedGlobalField -> GetCache().Invalidate();
+  for(int i = 0; i <= 1; i++)
+  {
+    if(fMWPCField[i] != NULL) fMWPCField[i] -> SetFieldScale(scale);
+    if(fCachedMWPCField[i] != NULL) fCachedMWPCField[i] -> GetCache().Invalidate();
+  }
+}
+
+void DetectorConstruction::SetScintThickness(G4double t)
+{
+  if(t <= fScintDeadLayerThick)
+  {
+    G4cout << "Scintillator thickness " << t/um << " um rejected: it must exceed the dead layer thickness of "
+           << fScintDeadLayerThick/um << " um. Keeping " << fScintThick/um << " um." << G4endl;
+    return;
+  }
+  fScintThick = t;
+}
+
+void DetectorConstruction::SetDeadLayerThickness(G4double t)
+{
+  // the active scintillator is what remains of fScintThick; it must stay a real solid
+  if(t <= 0 || t >= fScintThick)
+  {
+    G4cout << "Dead layer thickness " << t/um << " um rejected: it must be above 0 and below the scintillator thickness of "
+           << fScintThick/um << " um. Keeping " << fScintDeadLayerThick/um << " um." << G4endl;
+    return;
+  }
+  G4cout << "Setting scintillator dead layer thickness to " << t/um << " um" << G4endl;
+  fScintDeadLayerThick = t;
+  if(fScintDeadLayerTube == NULL) return;	// not built yet; Construct() picks up the new value
+
+  // same solids and placements as Construct(), resized in place
+  fScintDeadLayerTube -> SetZHalfLength(t/2.);
+  fScintTube -> SetZHalfLength((fScintThick - t)/2.);
+  for(int i = 0; i <= 1; i++)
+  {
+    scint_deadLayer_phys[i] -> SetTranslation(G4ThreeVector(0,0, -(fScintN2Volume_Z - t)/2.));
+    scint_scintillator_phys[i] -> SetTranslation(G4ThreeVector(0,0, -fScintN2Volume_Z/2. + t + (fScintThick - t)/2.));
+  }
+  G4RunManager::GetRunManager()->GeometryHasBeenModified();	// re-voxelize only
+}
+
+G4Material* DetectorConstruction::FindMaterial(const G4String& name, G4Material* fallback)
+{
+  // our own materials first, then the NIST database (e.g. "G4_KAPTON")
+  G4Material* mat = G4Material::GetMaterial(name, false);
+  if(mat == NULL) mat = G4NistManager::Instance()->FindOrBuildMaterial(name);
+  if(mat == NULL)
+  {
+    G4cout << "Material " << name << " not found. Using " << fallback->GetName() << " instead." << G4endl;
+    mat = fallback;
+  }
+  return mat;
+}
+
+void DetectorConstruction::RebuildGeometry()
+{
+  if(experimentalHall_log == NULL)
+  {
+    G4cout << "Geometry not built yet; the new parameters are used at /run/initialize." << G4endl;
+    return;
+  }
+  G4cout << "Rebuilding detector geometry. Physics tables are kept." << G4endl;
+  G4RunManager::GetRunManager()->ReinitializeGeometry(true);	// Construct() is called again at the next BeamOn
+  ForgetVolumes();	// the stores deleted every volume and solid; setters now only record their values
+}
+
+void DetectorConstruction::ForgetVolumes()
+{
+  experimentalHall_log = NULL;
+  experimentalHall_phys = NULL;
+  fScintDeadLayerTube = NULL;
+  fScintTube = NULL;
+  for(int i = 0; i <= 1; i++)
+  {
+    scint_container_log[i] = NULL;
+    scint_deadLayer_log[i] = NULL;
+    scint_scintillator_log[i] = NULL;
+    mwpc_container_log[i] = NULL;
+    scint_deadLayer_phys[i] = NULL;
+    scint_scintillator_phys[i] = NULL;
+  }
+}
+
+/// revision of the hard-coded geometry in Construct(); increase it whenever a fixed dimension,
+/// material or placement changes, so that stored GDML snapshots are rebuilt
+#define GEOMETRY_REVISION 1
+
+G4String DetectorConstruction::GeometryParameters() const
+{
+  // everything Construct() depends on. The revision number stands in for the hard-coded
+  // dimensions, so recompiling alone keeps snapshots valid.
+  stringstream p;
+  p << "revision = " << GEOMETRY_REVISION
+    << "\tscintThick = " << fScintThick/um << "\tdeadLayer = " << fScintDeadLayerThick/um
+    << "\tsourceWindow = " << fSourceWindowThick/um << "\ttrapWindow = " << fTrapWindowThick/um
+    << "\ttrapCoating = " << fTrapCoatingThick/um << "\tmwpcWindow = " << fMWPCWindowThick/um
+    << "\twireSpacing = " << fWireSpacing/um << "\tplaneSpacing = " << fWirePlaneSpacing/um
+    << "\tanodeRadius = " << fAnodeRadius/um << "\tkevSpacing = " << fKevlarSpacing/um
+    << "\tkevRadius = " << fKevlarRadius/um << "\tsourcePos = " << fSourcePosition.x()/um << ","
+    << fSourcePosition.y()/um << "," << fSourcePosition.z()/um << "\tvacuum = " << fVacuumPressure/torr
+    << "\tsourceWindowMat = " << fSourceWindowMatName << "\ttrapWindowMat = " << fTrapWindowMatName
+    << "\tmwpcWindowMat = " << fMWPCWindowMatName << "\tmwpcGas = " << fMWPCGasName
+    << "\twirePlanes = " << (fParameterisedWires ? "parameterised" : "replica");
+  return p.str();
+}
+
+G4String DetectorConstruction::GeometryChecksum() const
+{
+  // 64-bit FNV-1a of the parameter list
+  G4String params = GeometryParameters();
+  unsigned long long h = 14695981039346656037ULL;
+  for(unsigned int i = 0; i < params.size(); i++)
+  {
+    h ^= (unsigned char)params[i];
+    h *= 1099511628211ULL;
+  }
+  stringstream hex;
+  hex << std::hex << h;
+  return hex.str();
+}
+
+void DetectorConstruction::ExportGDML(const G4String& fileName)
+{
+#ifdef UCN_USE_GDML
+  if(experimentalHall_phys == NULL)
+  {
+    G4cout << "No geometry to export yet; run /run/initialize first." << G4endl;
+    return;
+  }
+  remove(fileName.c_str());	// the GDML writer refuses to overwrite
+  G4GDMLParser parser;
+  parser.Write(fileName, experimentalHall_phys);
+#else
+  G4cout << "Cannot export " << fileName << ": built without GDML support." << G4endl;
+#endif
+}
+
+void DetectorConstruction::WriteGDMLCache()
+{
+#ifdef UCN_USE_GDML
+  TraceScope trace("WriteGDMLCache");
+  ExportGDML(fGDMLCacheFile);
+  ofstream sumfile((fGDMLCacheFile + ".checksum").c_str());
+  sumfile << GeometryChecksum() << "\n" << GeometryParameters() << "\n";
+  sumfile.close();
+  G4cout << "Wrote geometry snapshot " << fGDMLCacheFile << " (checksum " << GeometryChecksum() << ")" << G4endl;
+#endif
+}
+
+G4VPhysicalVolume* DetectorConstruction::ReadGDMLCache()
+{
+#ifdef UCN_USE_GDML
+  TraceScope trace("ReadGDMLCache");
+  ifstream sumfile((fGDMLCacheFile + ".checksum").c_str());
+  string storedSum;
+  if(!(sumfile >> storedSum) || !ifstream(fGDMLCacheFile.c_str()).good())
+  {
+    G4cout << "No geometry snapshot at " << fGDMLCacheFile << "; building it." << G4endl;
+    return NULL;
+  }
+  if(storedSum != GeometryChecksum())
+  {
+    G4cout << "Geometry snapshot " << fGDMLCacheFile << " is stale (checksum " << storedSum
+	   << ", expected " << GeometryChecksum() << "); rebuilding it." << G4endl;
+    return NULL;
+  }
+
+  G4cout << "Loading geometry snapshot " << fGDMLCacheFile << ", skipping construction and overlap checks." << G4endl;
+  G4GDMLParser parser;
+  parser.Read(fGDMLCacheFile, false);	// the snapshot was written by us; skip schema validation
+  experimentalHall_phys = parser.GetWorldVolume();
+  RestoreVolumePointers();
+
+  // user limits, voxel settings and fields are not part of GDML
+  ApplyUserLimits();
+  ApplyVoxelSettings();
+  G4VPhysicalVolume* activeReg[2] = { G4PhysicalVolumeStore::GetVolume("mwpc_activeReg_phys_EAST"),
+				      G4PhysicalVolumeStore::GetVolume("mwpc_activeReg_phys_WEST") };
+  if(fGlobalField == NULL) ConstructGlobalField();
+  ConstructEastMWPCField(fWireSpacing, fWirePlaneSpacing, fAnodeRadius, fMWPCPotential, mwpc_container_phys[0]->GetRotation(),
+			activeReg[0]->GetTranslation() + mwpc_container_phys[0]->GetTranslation());
+  ConstructWestMWPCField(fWireSpacing, fWirePlaneSpacing, fAnodeRadius, fMWPCPotential, NULL,
+			activeReg[1]->GetTranslation() + mwpc_container_phys[1]->GetTranslation());
+  return experimentalHall_phys;
+#else
+  G4cout << "Built without GDML support; constructing the geometry instead of reading " << fGDMLCacheFile << G4endl;
+  return NULL;
+#endif
+}
+
+void DetectorConstruction::RestoreVolumePointers()
+{
+  // the materials and volumes the rest of the program reaches through this class, found by name
+  Be = G4Material::GetMaterial("Beryllium", false);
+  Al = G4Material::GetMaterial("Aluminum", false);
+  Si = G4Material::GetMaterial("Silicon", false);
+  Cu = G4Material::GetMaterial("Copper", false);
+  Wu = G4Material::GetMaterial("Tungsten", false);
+  Au = G4Material::GetMaterial("Gold", false);
+  Brass = G4Material::GetMaterial("Brass", false);
+  SS304 = G4Material::GetMaterial("Stainless304", false);
+  Kevlar = G4Material::GetMaterial("Kevlar", false);
+  Mylar = G4Material::GetMaterial("Mylar", false);
+  Polyethylene = G4Material::GetMaterial("Polyethylene", false);
+  WCPentane = G4Material::GetMaterial("Pentane", false);
+  WCNitrogen = G4Material::GetMaterial("MWPC_N2", false);
+  Sci = G4Material::GetMaterial("Scintillator", false);
+
+  experimentalHall_log = experimentalHall_phys->GetLogicalVolume();
+  Vacuum = experimentalHall_log->GetMaterial();
+  source_container_log = G4LogicalVolumeStore::GetVolume("source_container_log");
+  source_window_log = G4LogicalVolumeStore::GetVolume("source_window_log");
+  decayTrap_tube_log = G4LogicalVolumeStore::GetVolume("decayTrap_tube_log");
+  mwpc_container_log[0] = G4LogicalVolumeStore::GetVolume("mwpc_container_log_EAST");
+  mwpc_container_log[1] = G4LogicalVolumeStore::GetVolume("mwpc_container_log_WEST");
+  for(int i = 0; i <= 1; i++)
+  {
+    source_coating_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "source_coating_log"));
+    decayTrap_window_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "trap_win_log_"));
+    decayTrap_mylarWindow_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "mylar_win_log_"));
+    decayTrap_beWindow_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "be_win_log"));
+    decayTrap_collimator_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "collimator_log_"));
+    decayTrap_collimatorBack_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "collimator_back_log_"));
+    decayTrap_innerMonitors_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "trap_monitor_log_"));
+    scint_container_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "N2_Vol_log_"));
+    scint_deadLayer_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "Dead_scint_log_"));
+    scint_scintillator_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "scint_log_"));
+    scint_lightGuide_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "light_guide_log_"));
+    scint_backing_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "backing_log_"));
+    wireVol_gas_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "mwpc_gas_log_"));
+    wireVol_cathSeg_log[i] = fParameterisedWires ? NULL : G4LogicalVolumeStore::GetVolume(Append(i, "cathSeg_log_"));
+    wireVol_anodeSeg_log[i] = fParameterisedWires ? NULL : G4LogicalVolumeStore::GetVolume(Append(i, "anodeSeg_log_"));
+    wireVol_cathodeWire_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "cathode_log_"));
+    wireVol_cathPlate_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "cathode_plate_log_"));
+    wireVol_anodeWire_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "anode_log_"));
+    mwpc_kevContainer_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "kevContainer_log_"));
+    mwpc_kevSeg_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "kevSeg_log_"));
+    mwpc_kevStrip_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "kevStrip_log_"));
+    mwpc_winIn_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "winIn_log_"));
+    mwpc_winOut_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "winOut_log_"));
+    frame_mwpcEntrance_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "mwpc_entrance_log_"));
+    frame_entranceFront_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "entrance_front_log_"));
+    frame_entranceMid_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "entrance_mid_log_"));
+    frame_entranceBack_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "entrance_back_log_"));
+    frame_container_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "frame_container_log_"));
+    frame_mwpcExit_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "mwpc_exit_log_"));
+    frame_mwpcExitGasN2_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "mwpc_exit_N2_log_"));
+    frame_backStuff_log[i] = G4LogicalVolumeStore::GetVolume(Append(i, "backStuff_log_"));
+
+    scint_deadLayer_phys[i] = G4PhysicalVolumeStore::GetVolume(Append(i, "Dead_scint_phys_"));
+    scint_scintillator_phys[i] = G4PhysicalVolumeStore::GetVolume(Append(i, "scint_crystal_phys_"));
+  }
+  mwpc_container_phys[0] = G4PhysicalVolumeStore::GetVolume("mwpc_container_phys_EAST");
+  mwpc_container_phys[1] = G4PhysicalVolumeStore::GetVolume("mwpc_container_phys_West");
+
+  // solids resized in place by SetDeadLayerThickness
+  fScintDeadLayerTube = dynamic_cast<G4Tubs*>(scint_deadLayer_log[0]->GetSolid());
+  fScintTube = dynamic_cast<G4Tubs*>(scint_scintillator_log[0]->GetSolid());
+  fScintN2Volume_Z = 2*dynamic_cast<G4Tubs*>(scint_container_log[0]->GetSolid())->GetZHalfLength();
 }
 
 G4VPhysicalVolume* DetectorConstruction::Construct()
 {
-  DefineMaterials();	// immediate call to define all materials used as class properties (so ~global access)
-  SetVacuumPressure(0);	// this is the set vacuum pressure that was warned about in DefineMaterials()
+  TraceScope trace("Construct");
+  // fast start from a validated snapshot. Only on the first build: the snapshot brings its own materials
+  if(fGDMLCacheFile != "" && G4Material::GetMaterial("Scintillator", false) == NULL)
+  {
+    G4VPhysicalVolume* world = ReadGDMLCache();
+    if(world != NULL) return world;
+  }
 
-  // user step limits
-  G4UserLimits* UserCoarseLimits = new G4UserLimits();
-  UserCoarseLimits->SetMaxAllowedStep(10*m);
-  G4UserLimits* UserGasLimits = new G4UserLimits();
-  UserGasLimits->SetMaxAllowedStep(1*cm);
-  G4UserLimits* UserSolidLimits = new G4UserLimits();
-  UserSolidLimits->SetMaxAllowedStep(fScintStepLimit);	// default value from Messenger class.
+  DefineMaterials();	// immediate call to define all materials used as class properties (so ~global access)
+  SetVacuumPressure(fVacuumPressure);	// this is the set vacuum pressure that was warned about in DefineMaterials()
 
   // Experimental Hall. World volume.
   G4double expHall_x = 2.0*m;
@@ -179,16 +559,15 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   G4Box* experimentalHall_box = new G4Box("expHall_box", expHall_x/2, expHall_y/2, expHall_z/2);
   experimentalHall_log = new G4LogicalVolume(experimentalHall_box, Vacuum, "World_log");
   experimentalHall_log -> SetVisAttributes(G4VisAttributes::Invisible);
-  experimentalHall_log -> SetUserLimits(UserCoarseLimits);
   experimentalHall_phys = new G4PVPlacement(NULL, G4ThreeVector(), "World_phys", experimentalHall_log, 0, false, 0);
 
   //----- Source holder object. Used if it is a calibration source.
-  G4double source_windowThick = 4.7*um;
+  G4double source_windowThick = fSourceWindowThick;
   G4double source_coatingThick = 0.1*um;
-  G4Material* source_windowMaterial = Mylar;
+  G4Material* source_windowMaterial = FindMaterial(fSourceWindowMatName, Mylar);
   G4Material* source_coatingMaterial = Al;
   G4double source_holderThick = (3./16.)*inch;
-  G4ThreeVector source_holderPos(0,0,0);
+  G4ThreeVector source_holderPos = fSourcePosition;
   G4double source_ringRadius = 0.5*inch;
   G4double source_windowRadius = source_ringRadius-3.0*mm;
   G4double source_ringThickness = 3.2*mm;
@@ -233,17 +612,17 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   source_ring_phys = new G4PVPlacement(NULL, G4ThreeVector(), source_ring_log, "source_ring_phys", source_container_log, false, 0);
 
   // place entire source holder object
-  source_phys = new G4PVPlacement(NULL, source_holderPos, source_container_log,"source_container_phys", experimentalHall_log, false, 0, true);
+  source_phys = new G4PVPlacement(NULL, source_holderPos, source_container_log,"source_container_phys", experimentalHall_log, false, 0, fCheckOverlaps);
 
   //----- Decay Trap object (length 3m, main tube)
-  G4double decayTrap_windowThick = 0.180*um;
-  G4double decayTrap_coatingThick = 0.150*um;
+  G4double decayTrap_windowThick = fTrapWindowThick;
+  G4double decayTrap_coatingThick = fTrapCoatingThick;
   G4double decayTrap_innerRadiusOfTrap = 2.45*inch;
   G4double decayTrap_tubeWallThick = 2*mm;
   G4double decayTrap_innerRadiusCollimator = 2.3*inch;
   G4Material* decayTrap_tubeMaterial = Cu;
   G4Material* decayTrap_collimatorMaterial = Polyethylene;
-  G4Material* decayTrap_windowMaterial = Mylar;
+  G4Material* decayTrap_windowMaterial = FindMaterial(fTrapWindowMatName, Mylar);
   G4Material* decayTrap_coatingMaterial = Be;
 
   // decay tube construction
@@ -254,7 +633,7 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 					decayTrap_tube_length/2., 0., 2*M_PI);
   decayTrap_tube_log = new G4LogicalVolume(decayTrap_tube, decayTrap_tubeMaterial, "decayTrap_tube_log");
   decayTrap_tube_log -> SetVisAttributes(new G4VisAttributes(G4Colour(1,1,0,0.5)));
-  new G4PVPlacement(NULL, G4ThreeVector(), decayTrap_tube_log, "decayTrap_tube", experimentalHall_log, false, 0, true);
+  new G4PVPlacement(NULL, G4ThreeVector(), decayTrap_tube_log, "decayTrap_tube", experimentalHall_log, false, 0, fCheckOverlaps);
 
   // decay trap windows, collimator, monitors
   G4double decayTrap_totalWindowThickness = decayTrap_windowThick + decayTrap_coatingThick;
@@ -324,12 +703,13 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   //----- Scintillator construction. Used as Sensitive Volume
   G4double scint_scintRadius = 7.5*cm;
   G4double scint_scintBackingRadius = 10*cm;
-  G4double scint_scintThick = 3.5*mm;
-  G4double scint_deadLayerThick = 3.0*um;
+  G4double scint_scintThick = fScintThick;
+  G4double scint_deadLayerThick = fScintDeadLayerThick;
   G4double scint_scintBackingThick = 1.*inch;
   G4double scint_lightGuideThick = 1.0*cm;
   G4double scint_N2Volume_Z = scint_lightGuideThick + scint_scintBackingThick;
   G4double scint_face_PosZ = -scint_N2Volume_Z/2.;
+  fScintN2Volume_Z = scint_N2Volume_Z;
 
   if((scint_scintBackingRadius < scint_scintRadius) || (scint_lightGuideThick < scint_scintThick))
 	G4cout << "\n\nMajor geometry error! Scintillator measurements don't make sense! \n \n" << G4endl;
@@ -344,6 +724,8 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 
   // scintillator
   G4Tubs* scint_scintTube = new G4Tubs("scint_tube", 0, scint_scintRadius, (scint_scintThick - scint_deadLayerThick)/2., 0., 2*M_PI);
+  fScintDeadLayerTube = scint_deadLayerTube;
+  fScintTube = scint_scintTube;
   G4VisAttributes* visScint= new G4VisAttributes(G4Colour(0.0,1.0,1.0,0.2));
 
   // light guides around and behind detector
@@ -396,22 +778,22 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 
   // Place the two scintillator containers. Rotate the EAST one so they both face towards the center.
   scint_container_phys[0] = new G4PVPlacement(EastSideRot, sideTransScintEast, scint_container_log[0],
-				"scint_container_phys_EAST", experimentalHall_log, false, 0, true);
+				"scint_container_phys_EAST", experimentalHall_log, false, 0, fCheckOverlaps);
   scint_container_phys[1] = new G4PVPlacement(NULL, sideTransScintWest, scint_container_log[1],
-				"scint_container_phys_WEST", experimentalHall_log, false, 0, true);
+				"scint_container_phys_WEST", experimentalHall_log, false, 0, fCheckOverlaps);
 
   //----- Begin Wire volume construction. Active region inside wire chamber.
-  G4double wireVol_anodeRadius = 5*um;
+  G4double wireVol_anodeRadius = fAnodeRadius;
   G4double wireVol_cathodeRadius = 25*um;
   G4double wireVol_platingThick = 0.2*um;
-  G4double wireVol_wireSpacing = 2.54*mm;
+  G4double wireVol_wireSpacing = fWireSpacing;
   G4double wireVol_NbOfWires = 64;
-  G4double wireVol_planeSpacing = 1*cm;
+  G4double wireVol_planeSpacing = fWirePlaneSpacing;
 
   G4Material* wireVol_cathodeWireMat = Al;
   G4Material* wireVol_anodeWireMat = Wu;
   G4Material* wireVol_cathodePlateMat = Au;
-  G4Material* wireVol_activeGas = WCPentane;
+  G4Material* wireVol_activeGas = FindMaterial(fMWPCGasName, WCPentane);
 
   G4double wireVol_wirePlaneWidth = wireVol_NbOfWires*wireVol_wireSpacing;
 
@@ -424,7 +806,8 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   G4Box* wireVol_anodeContainerBox = new G4Box("anodeContainer_Box", wireVol_wirePlaneWidth/2., wireVol_anodeRadius, wireVol_wirePlaneWidth/2.);
 
   // anode, cathode wires and surrouding gas
-  G4Tubs* wireVol_cathPlateTube = new G4Tubs("cathplate_tube", wireVol_cathodeRadius - wireVol_platingThick,
+  // parameterised planes: the plating is a full gold rod holding the aluminium wire, so each cathode is one copy
+  G4Tubs* wireVol_cathPlateTube = new G4Tubs("cathplate_tube", fParameterisedWires ? 0. : wireVol_cathodeRadius - wireVol_platingThick,
 						wireVol_cathodeRadius, wireVol_wirePlaneWidth/2., 0., 2*M_PI);
   G4Tubs* wireVol_cathodeTube = new G4Tubs("cathode_tube", 0, wireVol_cathodeRadius- wireVol_platingThick,
 						wireVol_wirePlaneWidth/2., 0., 2*M_PI);
@@ -446,13 +829,18 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   {
     wireVol_gas_log[i] = new G4LogicalVolume(wireVol_mwpcGasBox, wireVol_activeGas, Append(i, "mwpc_gas_log_"));
     wireVol_gas_log[i] -> SetVisAttributes(G4VisAttributes::Invisible);
-    wireVol_cathSeg_log[i] = new G4LogicalVolume(wireVol_cathSegBox, wireVol_activeGas, Append(i, "cathSeg_log_"));
-    wireVol_anodeSeg_log[i] = new G4LogicalVolume(wireVol_anodeSegBox, wireVol_activeGas, Append(i, "anodeSeg_log_"));
+    wireVol_cathSeg_log[i] = NULL;	// segments only exist for replicated planes
+    wireVol_anodeSeg_log[i] = NULL;
+    if(!fParameterisedWires)
+    {
+      wireVol_cathSeg_log[i] = new G4LogicalVolume(wireVol_cathSegBox, wireVol_activeGas, Append(i, "cathSeg_log_"));
+      wireVol_anodeSeg_log[i] = new G4LogicalVolume(wireVol_anodeSegBox, wireVol_activeGas, Append(i, "anodeSeg_log_"));
+      wireVol_cathSeg_log[i] -> SetVisAttributes(G4VisAttributes::Invisible);
+      wireVol_anodeSeg_log[i] -> SetVisAttributes(G4VisAttributes::Invisible);
+    }
     wireVol_cathodeWire_log[i] = new G4LogicalVolume(wireVol_cathodeTube, wireVol_cathodeWireMat, Append(i, "cathode_log_"));
     wireVol_cathPlate_log[i] = new G4LogicalVolume(wireVol_cathPlateTube, wireVol_cathodePlateMat, Append(i, "cathode_plate_log_"));
     wireVol_anodeWire_log[i] = new G4LogicalVolume(wireVol_anodeTube, wireVol_anodeWireMat, Append(i, "anode_log_"));
-    wireVol_cathSeg_log[i] -> SetVisAttributes(G4VisAttributes::Invisible);
-    wireVol_anodeSeg_log[i] -> SetVisAttributes(G4VisAttributes::Invisible);
     wireVol_cathodeWire_log[i] -> SetVisAttributes(visCathWires);
     wireVol_cathPlate_log[i] -> SetVisAttributes(visCathWires);
     wireVol_anodeWire_log[i] -> SetVisAttributes(visAnodeWires);
@@ -468,32 +856,47 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
     wireVol_anodeContainer_log[i] = new G4LogicalVolume(wireVol_anodeContainerBox, wireVol_activeGas, Append(i, "anodeContainer_log_"));
   }
   // place all the objects sequentially. So far, keep positions same since we will attempt to rotate
+  WirePlaneParameterisation* wireVol_wireParam = new WirePlaneParameterisation((G4int)wireVol_NbOfWires, wireVol_wireSpacing);
   for(int i = 0; i <= 1; i++)
   {
-    new G4PVPlacement(NULL, G4ThreeVector(), wireVol_cathodeWire_log[i], Append(i, "cathode_wire_phys_"), wireVol_cathSeg_log[i], true, 0);
-    new G4PVPlacement(NULL, G4ThreeVector(), wireVol_cathPlate_log[i], Append(i, "cathode_plate_phys_"), wireVol_cathSeg_log[i], true, 0);
-    new G4PVPlacement(NULL, G4ThreeVector(), wireVol_anodeWire_log[i], Append(i, "anode_wire_phys_"), wireVol_anodeSeg_log[i], true, 0);
-
     new G4PVPlacement(xRot90, G4ThreeVector(0., 0., wireVol_cathodeRadius - wireVol_planeSpacing),
 	wireVol_cathContainer1_log[i], Append(i, "cathContainer1_phys_"), wireVol_gas_log[i], false, 0);
     new G4PVPlacement(xzRot90, G4ThreeVector(0., 0., (-1)*(wireVol_cathodeRadius - wireVol_planeSpacing)),
 	wireVol_cathContainer2_log[i], Append(i, "cathContainer2_phys_"), wireVol_gas_log[i], false, 0);
     new G4PVPlacement(xRot90, G4ThreeVector(0,0,0), wireVol_anodeContainer_log[i], Append(i, "anodeContainer_phys_"), wireVol_gas_log[i], false,0);
 
-    // replicate the segments defined above into cathode, anode arrays
-    new G4PVReplica(Append(i, "CathodeArray1_"), wireVol_cathSeg_log[i], wireVol_cathContainer1_log[i], kXAxis, wireVol_NbOfWires, wireVol_wireSpacing);
-    new G4PVReplica(Append(i, "CathodeArray2_"), wireVol_cathSeg_log[i], wireVol_cathContainer2_log[i], kXAxis, wireVol_NbOfWires, wireVol_wireSpacing);
-    new G4PVReplica(Append(i, "AnodeArray_"), wireVol_anodeSeg_log[i], wireVol_anodeContainer_log[i], kXAxis, wireVol_NbOfWires, wireVol_wireSpacing);
+    if(!fParameterisedWires)
+    {
+      new G4PVPlacement(NULL, G4ThreeVector(), wireVol_cathodeWire_log[i], Append(i, "cathode_wire_phys_"), wireVol_cathSeg_log[i], true, 0);
+      new G4PVPlacement(NULL, G4ThreeVector(), wireVol_cathPlate_log[i], Append(i, "cathode_plate_phys_"), wireVol_cathSeg_log[i], true, 0);
+      new G4PVPlacement(NULL, G4ThreeVector(), wireVol_anodeWire_log[i], Append(i, "anode_wire_phys_"), wireVol_anodeSeg_log[i], true, 0);
+
+      // replicate the segments defined above into cathode, anode arrays
+      new G4PVReplica(Append(i, "CathodeArray1_"), wireVol_cathSeg_log[i], wireVol_cathContainer1_log[i], kXAxis, wireVol_NbOfWires, wireVol_wireSpacing);
+      new G4PVReplica(Append(i, "CathodeArray2_"), wireVol_cathSeg_log[i], wireVol_cathContainer2_log[i], kXAxis, wireVol_NbOfWires, wireVol_wireSpacing);
+      new G4PVReplica(Append(i, "AnodeArray_"), wireVol_anodeSeg_log[i], wireVol_anodeContainer_log[i], kXAxis, wireVol_NbOfWires, wireVol_wireSpacing);
+    }
+    else	// wires placed straight into the plane containers, voxelized along x
+    {
+      new G4PVPlacement(NULL, G4ThreeVector(), wireVol_cathodeWire_log[i], Append(i, "cathode_wire_phys_"), wireVol_cathPlate_log[i], false, 0);
+      new G4PVParameterised(Append(i, "CathodeArray1_"), wireVol_cathPlate_log[i], wireVol_cathContainer1_log[i], kXAxis,
+				(G4int)wireVol_NbOfWires, wireVol_wireParam);
+      new G4PVParameterised(Append(i, "CathodeArray2_"), wireVol_cathPlate_log[i], wireVol_cathContainer2_log[i], kXAxis,
+				(G4int)wireVol_NbOfWires, wireVol_wireParam);
+      new G4PVParameterised(Append(i, "AnodeArray_"), wireVol_anodeWire_log[i], wireVol_anodeContainer_log[i], kXAxis,
+				(G4int)wireVol_NbOfWires, wireVol_wireParam);
+    }
   }
 
   //----- Begin wirechamber construction. MWPC used in front of Scintillator.
-  G4double mwpc_windowThick = 6*um;
+  G4double mwpc_windowThick = fMWPCWindowThick;
   G4double mwpc_entranceRadius = 7.0*cm;
   G4double mwpc_exitRadius = 7.5*cm;
   G4double mwpc_entranceToCathodes = 5.0*mm;
   G4double mwpc_exitToCathodes = 5.0*mm;
-  G4double mwpc_fieldE0 = 2700*volt;		// gets passed to MWPC fields and used in SetPotential
+  G4double mwpc_fieldE0 = fMWPCPotential;	// gets passed to MWPC fields and used in SetPotential
   G4Material* mwpc_fillGas = wireVol_activeGas;	// want it to be WCPentane
+  G4Material* mwpc_windowMaterial = FindMaterial(fMWPCWindowMatName, Mylar);
 
   G4double mwpc_containerHalf_Z = 0.5*(mwpc_entranceToCathodes + mwpc_exitToCathodes + 2*cm);
   G4double mwpc_gasVolumeWidth = 8.0*inch;	// MWPC gas box width
@@ -515,8 +918,8 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   new G4PVPlacement(NULL, mwpc_activeRegionTrans, wireVol_gas_log[1], "mwpc_activeReg_phys_WEST", mwpc_container_log[1], false, 0);
 
   // construct kevlay string. Rectangular cross section strings with equal volume to nominal 140um cylinders.
-  G4double mwpc_kevRadius = 0.07*mm;
-  G4double mwpc_kevSpacing = 5.0*mm;
+  G4double mwpc_kevRadius = fKevlarRadius;
+  G4double mwpc_kevSpacing = fKevlarSpacing;
   G4int mwpc_NbKevWires = 32;
   G4double mwpc_kevLength = 15.0*cm;
   double mwpc_kevAspectRatio = 16.0;	// aspect ratio, width:depth.
@@ -540,9 +943,9 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
     mwpc_kevSeg_log[i] = new G4LogicalVolume(mwpc_kevSegBox, Vacuum, Append(i, "kevSeg_log_"));
     mwpc_kevStrip_log[i] = new G4LogicalVolume(mwpc_kevStripBox, Kevlar, Append(i, "kevStrip_log_"));
 
-    mwpc_winIn_log[i] = new G4LogicalVolume(mwpc_winInnerTube, Mylar, Append(i, "winIn_log_"));
+    mwpc_winIn_log[i] = new G4LogicalVolume(mwpc_winInnerTube, mwpc_windowMaterial, Append(i, "winIn_log_"));
     mwpc_winIn_log[i] -> SetVisAttributes(visWindow);
-    mwpc_winOut_log[i] = new G4LogicalVolume(mwpc_winOuterTube, Mylar, Append(i, "winOut_log_"));
+    mwpc_winOut_log[i] = new G4LogicalVolume(mwpc_winOuterTube, mwpc_windowMaterial, Append(i, "winOut_log_"));
     mwpc_winOut_log[i] -> SetVisAttributes(visWindow);
 
     new G4PVPlacement(NULL, G4ThreeVector(0,0, mwpc_kev_PosZ), mwpc_kevContainer_log[i], Append(i, "kevContainer_phys_"),
@@ -563,9 +966,9 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 
   // place the two wire chambers in experimentalHall. Rotate the East one (same as scint) so they both point towards center.
   mwpc_container_phys[0] = new G4PVPlacement(EastSideRot, sideTransMWPCEast, mwpc_container_log[0],
-				"mwpc_container_phys_EAST", experimentalHall_log, false, 0, true);
+				"mwpc_container_phys_EAST", experimentalHall_log, false, 0, fCheckOverlaps);
   mwpc_container_phys[1] = new G4PVPlacement(NULL, sideTransMWPCWest, mwpc_container_log[1],
-				"mwpc_container_phys_West", experimentalHall_log, false, 0, true);
+				"mwpc_container_phys_West", experimentalHall_log, false, 0, fCheckOverlaps);
 
   //----- Begin DetectorPackageConstruction. This is the frame that holds the scintillator and MWPC.
 
@@ -666,18 +1069,12 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   G4ThreeVector frameTransWest = G4ThreeVector(0., 0., 2.2*m);
 
   frame_container_phys[0] = new G4PVPlacement(EastSideRot, frameTransEast, frame_container_log[0],
-				"Detector_Package_Frame_EAST", experimentalHall_log, false, 0, true);
+				"Detector_Package_Frame_EAST", experimentalHall_log, false, 0, fCheckOverlaps);
   frame_container_phys[1] = new G4PVPlacement(NULL, frameTransWest, frame_container_log[1],
-				"Detector_Package_Frame_WEST", experimentalHall_log, false, 0, true);
+				"Detector_Package_Frame_WEST", experimentalHall_log, false, 0, fCheckOverlaps);
 
-  for(int i = 0; i <= 1; i++)			// set user limits in specific volumes
-  {
-    decayTrap_window_log[i] -> SetUserLimits(UserSolidLimits);
-    mwpc_container_log[i] -> SetUserLimits(UserGasLimits);
-    mwpc_winIn_log[i] -> SetUserLimits(UserSolidLimits);
-    mwpc_winOut_log[i] -> SetUserLimits(UserSolidLimits);
-    mwpc_kevStrip_log[i] -> SetUserLimits(UserSolidLimits);
-  }
+  ApplyUserLimits();
+  ApplyVoxelSettings();
 
   // HERE IS WHERE I WOULD SET SCORING VOLUMES.
   // But as of right now, all tracking and accumulation is done via SteppingAction.
@@ -685,15 +1082,143 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
   G4ThreeVector East_EMFieldLocation = mwpc_activeRegionTrans + sideTransMWPCEast;
   G4ThreeVector West_EMFieldLocation = mwpc_activeRegionTrans + sideTransMWPCWest;
 
-  ConstructGlobalField();			// make magnetic and EM fields.
+  if(fGlobalField == NULL) ConstructGlobalField();	// make magnetic and EM fields. The solenoid field doesn't depend on the geometry
   ConstructEastMWPCField(wireVol_wireSpacing, wireVol_planeSpacing, wireVol_anodeRadius,
 			mwpc_fieldE0, EastSideRot, East_EMFieldLocation);
   ConstructWestMWPCField(wireVol_wireSpacing, wireVol_planeSpacing, wireVol_anodeRadius,
 			mwpc_fieldE0, NULL, West_EMFieldLocation);
 
+  if(fGDMLCacheFile != "") WriteGDMLCache();
+
   return experimentalHall_phys;
 }
 
+void DetectorConstruction::ApplyUserLimits()
+{
+  // user step limits
+  G4UserLimits* UserCoarseLimits = new G4UserLimits();
+  UserCoarseLimits->SetMaxAllowedStep(10*m);
+  G4UserLimits* UserGasLimits = new G4UserLimits();
+  UserGasLimits->SetMaxAllowedStep(1*cm);
+  G4UserLimits* UserSolidLimits = new G4UserLimits();
+  UserSolidLimits->SetMaxAllowedStep(fScintStepLimit);	// default value from Messenger class.
+
+  experimentalHall_log -> SetUserLimits(UserCoarseLimits);
+  for(int i = 0; i <= 1; i++)			// set user limits in specific volumes
+  {
+    decayTrap_window_log[i] -> SetUserLimits(UserSolidLimits);
+    mwpc_container_log[i] -> SetUserLimits(UserGasLimits);
+    mwpc_winIn_log[i] -> SetUserLimits(UserSolidLimits);
+    mwpc_winOut_log[i] -> SetUserLimits(UserSolidLimits);
+    mwpc_kevStrip_log[i] -> SetUserLimits(UserSolidLimits);
+  }
+}
+
+G4bool DetectorConstruction::ApplySmartless(const G4String& logVolName, G4double smartless)
+{
+  G4LogicalVolume* logVol = G4LogicalVolumeStore::GetVolume(logVolName, false);
+  if(logVol == NULL) return false;
+  logVol->SetOptimisation(smartless > 0);
+  if(smartless > 0) logVol->SetSmartless(smartless);
+  return true;
+}
+
+void DetectorConstruction::ApplyVoxelSettings()
+{
+  // the file first, so explicit /ucn/geometry/smartless settings win
+  if(fVoxelFile != "")
+  {
+    if(!fileExists(fVoxelFile))
+      G4cout << "Voxel settings file " << fVoxelFile << " not found; using G4 defaults." << G4endl;
+    else
+    {
+      vector<Stringmap> settings = QFile(fVoxelFile).retrieve("voxel");
+      for(unsigned int i = 0; i < settings.size(); i++)
+      {
+	G4String name = settings[i].getDefault("volume", "");
+	if(fSmartless.count(name)) continue;
+	if(!ApplySmartless(name, settings[i].getDefault("smartless", 2.)))
+	  G4cout << "Voxel settings: no logical volume " << name << G4endl;
+      }
+      G4cout << "Applied " << settings.size() << " voxel settings from " << fVoxelFile << G4endl;
+    }
+  }
+  for(map<G4String, G4double>::const_iterator it = fSmartless.begin(); it != fSmartless.end(); it++)
+    if(!ApplySmartless(it->first, it->second))
+      G4cout << "Voxel settings: no logical volume " << it->first << G4endl;
+}
+
+void DetectorConstruction::SetSmartless(const G4String& logVolName, G4double smartless)
+{
+  fSmartless[logVolName] = smartless;
+  if(experimentalHall_log == NULL) return;	// not built yet; Construct() applies it
+  if(ApplySmartless(logVolName, smartless))
+    G4RunManager::GetRunManager()->GeometryHasBeenModified();	// voxels are rebuilt when the geometry is next closed
+  else
+    G4cout << "Voxel settings: no logical volume " << logVolName << G4endl;
+}
+
+void DetectorConstruction::SetHelixTransport(G4bool b)
+{
+  fHelixTransport = b;
+  if(fGlobalField != NULL) ConfigureGlobalStepper();	// otherwise ConstructGlobalField() picks it up
+}
+
+void DetectorConstruction::ConfigureGlobalStepper()
+{
+  G4FieldManager* globalFieldManager = G4TransportationManager::GetTransportationManager()->GetFieldManager();
+  if(fHelixTransport)
+    globalFieldManager -> GetChordFinder() -> GetIntegrationDriver() -> RenewStepperAndAdjust(fHelixStepper);
+  else
+    globalFieldManager -> GetChordFinder() -> GetIntegrationDriver() -> RenewStepperAndAdjust(fMixedStepper);
+}
+
+void DetectorConstruction::SetFieldCacheDistance(G4double d)
+{
+  fFieldCacheDistance = d;
+  if(fCachedGlobalField != NULL) fCachedGlobalField -> GetCache().SetDistance(d);
+  for(int i = 0; i <= 1; i++)
+    if(fCachedMWPCField[i] != NULL) fCachedMWPCField[i] -> GetCache().SetDistance(d);
+}
+
+void DetectorConstruction::SetFieldCacheCheck(G4int n)
+{
+  fFieldCacheCheck = n;
+  if(fCachedGlobalField != NULL) fCachedGlobalField -> GetCache().SetCheckInterval(n);
+  for(int i = 0; i <= 1; i++)
+    if(fCachedMWPCField[i] != NULL) fCachedMWPCField[i] -> GetCache().SetCheckInterval(n);
+}
+
+void DetectorConstruction::ReportFieldCache()
+{
+  if(fCachedGlobalField != NULL) fCachedGlobalField -> GetCache().Report("Solenoid");
+  if(fCachedMWPCField[0] != NULL) fCachedMWPCField[0] -> GetCache().Report("East MWPC");
+  if(fCachedMWPCField[1] != NULL) fCachedMWPCField[1] -> GetCache().Report("West MWPC");
+}
+
+void DetectorConstruction::SetMWPCBTable(G4bool b)
+{
+  fMWPCBTable = b;
+  for(int i = 0; i <= 1; i++)
+  {
+    if(fMWPCField[i] != NULL) fMWPCField[i] -> SetBTable(b);
+    if(fCachedMWPCField[i] != NULL) fCachedMWPCField[i] -> GetCache().Invalidate();
+  }
+}
+
+void DetectorConstruction::CheckMWPCField(G4int nPoints)
+{
+  for(int i = 0; i <= 1; i++)
+    if(fMWPCField[i] != NULL) fMWPCField[i] -> CheckBTable(nPoints);
+}
+
+void DetectorConstruction::ReportFieldAccuracy()
+{
+  if(fGlobalFieldManager != NULL) fGlobalFieldManager -> Report("Solenoid");
+  if(fMWPCFieldManager[0] != NULL) fMWPCFieldManager[0] -> Report("East MWPC");
+  if(fMWPCFieldManager[1] != NULL) fMWPCFieldManager[1] -> Report("West MWPC");
+}
+
 string DetectorConstruction::Append(int i, string str)
 {
   stringstream newString;
@@ -703,15 +1228,23 @@ string DetectorConstruction::Append(int i, string str)
 
 void DetectorConstruction::ConstructGlobalField()
 {
+  TraceScope trace("ConstructGlobalField");
   G4cout << "Setting up global magnetic field. Call to global field object." << G4endl;
 
   GlobalField* magField = new GlobalField();
-  G4FieldManager* globalFieldManager = G4TransportationManager::GetTransportationManager()->GetFieldManager();
-  globalFieldManager -> SetDetectorField(magField);
-  globalFieldManager -> CreateChordFinder(magField);
+  magField -> SetFieldScale(fFieldScale);
+  fGlobalField = magField;
+  fCachedGlobalField = new CachedMagneticField(magField);	// steppers see the field through its cache
+  fCachedGlobalField -> GetCache().SetDistance(fFieldCacheDistance);
+  fCachedGlobalField -> GetCache().SetCheckInterval(fFieldCacheCheck);
+  // tolerances chosen per track (see SetAccuracyPolicy)
+  EnergyAwareFieldManager* globalFieldManager = new EnergyAwareFieldManager(fCachedGlobalField, &fAccuracyPolicy);
+  G4TransportationManager::GetTransportationManager()->SetFieldManager(globalFieldManager);
+  fGlobalFieldManager = globalFieldManager;
+  globalFieldManager -> CreateChordFinder(fCachedGlobalField);
 
   G4MagIntegratorStepper* pStepper;
-  G4Mag_UsualEqRhs* equationOfMotion = new G4Mag_UsualEqRhs(magField);
+  G4Mag_UsualEqRhs* equationOfMotion = new G4Mag_UsualEqRhs(fCachedGlobalField);
   //pStepper = new G4ClassicalRK4 (fEquation); // general case for "smooth" EM fields
   //pStepper = new G4SimpleHeum( fEquation ); // for slightly less smooth EM fields
   //pStepper = new G4HelixHeum( fEquation ); // for "smooth" pure-B fields
@@ -719,12 +1252,12 @@ void DetectorConstruction::ConstructGlobalField()
   //pStepper = new G4HelixSimpleRunge( fEquation ); // similar speed to above
   //pStepper = new G4HelixExplicitEuler( fEquation ); // about twice as fast as above
   pStepper = new G4HelixMixedStepper(equationOfMotion,6); // avoids "Stepsize underflow in Stepper" errors
-  globalFieldManager -> GetChordFinder() -> GetIntegrationDriver() -> RenewStepperAndAdjust(pStepper);
+  fMixedStepper = pStepper;
+  // exact helices in the flat field sections, the mixed stepper in the transitions
+  fHelixStepper = new UniformFieldHelixStepper(equationOfMotion, magField, fMixedStepper);
+  ConfigureGlobalStepper();
 
-  globalFieldManager -> GetChordFinder() -> SetDeltaChord(100.0*um);
-  globalFieldManager -> SetMinimumEpsilonStep(1e-6);
-  globalFieldManager -> SetMaximumEpsilonStep(1e-5);
-  globalFieldManager -> SetDeltaOneStep(0.1*um);
+  globalFieldManager -> SetBaseAccuracy(100.0*um, 0.1*um, 1e-6, 1e-5);	// delta chord, delta one step, epsilon range
   G4TransportationManager::GetTransportationManager()->GetPropagatorInField()->SetMaxLoopCount(INT_MAX);
 
   return;
@@ -732,58 +1265,420 @@ void DetectorConstruction::ConstructGlobalField()
 
 void DetectorConstruction::ConstructEastMWPCField(G4double a, G4double b, G4double c, G4double d, G4RotationMatrix* e, G4ThreeVector f)
 {
-  G4cout << "Setting up East wirechamber electromagnetic field." << G4endl;
-  MWPCField* eastLocalField = new MWPCField();
+  TraceScope trace("ConstructEastMWPCField");
+  if(fMWPCField[0] == NULL)	// on a geometry rebuild the existing field and field manager are reused
+  {
+    G4cout << "Setting up East wirechamber electromagnetic field." << G4endl;
+    MWPCField* eastLocalField = new MWPCField();
+    eastLocalField -> SetFieldScale(fFieldScale);
+    eastLocalField -> SetBTable(fMWPCBTable);
+    fMWPCField[0] = eastLocalField;
+    fCachedMWPCField[0] = new CachedElectroMagneticField(eastLocalField);	// steppers see the field through its cache
+    fCachedMWPCField[0] -> GetCache().SetDistance(fFieldCacheDistance);
+    fCachedMWPCField[0] -> GetCache().SetCheckInterval(fFieldCacheCheck);
+
+    EnergyAwareFieldManager* eastLocalFieldManager = new EnergyAwareFieldManager(fCachedMWPCField[0], &fAccuracyPolicy);
+
+    G4EqMagElectricField* eastlocalEquation = new G4EqMagElectricField(fCachedMWPCField[0]);
+    G4ClassicalRK4* eastlocalStepper = new G4ClassicalRK4(eastlocalEquation,8);
+    G4MagInt_Driver* eastlocalIntgrDriver = new G4MagInt_Driver(0.01*um,eastlocalStepper,eastlocalStepper->GetNumberOfVariables());
+    G4ChordFinder* eastlocalChordFinder = new G4ChordFinder(eastlocalIntgrDriver);
+    eastLocalFieldManager -> SetChordFinder(eastlocalChordFinder);
+
+    eastLocalFieldManager -> SetBaseAccuracy(10*um, 0.1*um, 1e-6, 1e-5);	// delta chord, delta one step, epsilon range
+    fMWPCFieldManager[0] = eastLocalFieldManager;
+  }
+
+  MWPCField* eastLocalField = fMWPCField[0];
   eastLocalField -> SetActiveReg_d(a);
   eastLocalField -> SetActiveReg_L(b);
   eastLocalField -> SetActiveReg_r(c);
   eastLocalField -> SetSideRot(e);
   eastLocalField -> SetSideTrans(f);
   eastLocalField -> SetPotential(d);
+  fCachedMWPCField[0] -> GetCache().Invalidate();
 
-  G4FieldManager* eastLocalFieldManager = new G4FieldManager();
-  eastLocalFieldManager -> SetDetectorField(eastLocalField);
-
-  G4EqMagElectricField* eastlocalEquation = new G4EqMagElectricField(eastLocalField);
-  G4ClassicalRK4* eastlocalStepper = new G4ClassicalRK4(eastlocalEquation,8);
-  G4MagInt_Driver* eastlocalIntgrDriver = new G4MagInt_Driver(0.01*um,eastlocalStepper,eastlocalStepper->GetNumberOfVariables());
-  G4ChordFinder* eastlocalChordFinder = new G4ChordFinder(eastlocalIntgrDriver);
-  eastLocalFieldManager -> SetChordFinder(eastlocalChordFinder);
-
-  eastLocalFieldManager -> GetChordFinder() -> SetDeltaChord(10*um);
-  eastLocalFieldManager -> SetMinimumEpsilonStep(1e-6);
-  eastLocalFieldManager -> SetMaximumEpsilonStep(1e-5);
-  eastLocalFieldManager -> SetDeltaOneStep(0.1*um);
-
-  mwpc_container_log[0] -> SetFieldManager(eastLocalFieldManager, true);
+  mwpc_container_log[0] -> SetFieldManager(fMWPCFieldManager[0], true);
   return;
 }
 
 void DetectorConstruction::ConstructWestMWPCField(G4double a, G4double b, G4double c, G4double d, G4RotationMatrix* e, G4ThreeVector f)
 {
-  G4cout << "Setting up West wirechamber electromagnetic field." << G4endl;
-  MWPCField* westLocalField = new MWPCField();
+  TraceScope trace("ConstructWestMWPCField");
+  if(fMWPCField[1] == NULL)	// on a geometry rebuild the existing field and field manager are reused
+  {
+    G4cout << "Setting up West wirechamber electromagnetic field." << G4endl;
+    MWPCField* westLocalField = new MWPCField();
+    westLocalField -> SetFieldScale(fFieldScale);
+    westLocalField -> SetBTable(fMWPCBTable);
+    fMWPCField[1] = westLocalField;
+    fCachedMWPCField[1] = new CachedElectroMagneticField(westLocalField);	// steppers see the field through its cache
+    fCachedMWPCField[1] -> GetCache().SetDistance(fFieldCacheDistance);
+    fCachedMWPCField[1] -> GetCache().SetCheckInterval(fFieldCacheCheck);
+
+    EnergyAwareFieldManager* westLocalFieldManager = new EnergyAwareFieldManager(fCachedMWPCField[1], &fAccuracyPolicy);
+
+    G4EqMagElectricField* westlocalEquation = new G4EqMagElectricField(fCachedMWPCField[1]);
+    G4ClassicalRK4* westlocalStepper = new G4ClassicalRK4(westlocalEquation,8);
+    G4MagInt_Driver* westlocalIntgrDriver = new G4MagInt_Driver(0.01*um,westlocalStepper,westlocalStepper->GetNumberOfVariables());
+    G4ChordFinder* westlocalChordFinder = new G4ChordFinder(westlocalIntgrDriver);
+    westLocalFieldManager -> SetChordFinder(westlocalChordFinder);
+
+    westLocalFieldManager -> SetBaseAccuracy(10*um, 0.1*um, 1e-6, 1e-5);	// delta chord, delta one step, epsilon range
+    fMWPCFieldManager[1] = westLocalFieldManager;
+  }
+
+  MWPCField* westLocalField = fMWPCField[1];
   westLocalField -> SetActiveReg_d(a);
   westLocalField -> SetActiveReg_L(b);
   westLocalField -> SetActiveReg_r(c);
   westLocalField -> SetSideRot(e);
   westLocalField -> SetSideTrans(f);
   westLocalField -> SetPotential(d);
+  fCachedMWPCField[1] -> GetCache().Invalidate();
 
-  G4FieldManager* westLocalFieldManager = new G4FieldManager();
-  westLocalFieldManager -> SetDetectorField(westLocalField);
+  mwpc_container_log[1] -> SetFieldManager(fMWPCFieldManager[1], true);
+  return;
+}
 
-  G4EqMagElectricField* westlocalEquation = new G4EqMagElectricField(westLocalField);
-  G4ClassicalRK4* westlocalStepper = new G4ClassicalRK4(westlocalEquation,8);
-  G4MagInt_Driver* westlocalIntgrDriver = new G4MagInt_Driver(0.01*um,westlocalStepper,westlocalStepper->GetNumberOfVariables());
-  G4ChordFinder* westlocalChordFinder = new G4ChordFinder(westlocalIntgrDriver);
-  westLocalFieldManager -> SetChordFinder(westlocalChordFinder);
+//----------------------------------------------------------------
 
-  westLocalFieldManager -> GetChordFinder() -> SetDeltaChord(10*um);
-  westLocalFieldManager -> SetMinimumEpsilonStep(1e-6);
-  westLocalFieldManager -> SetMaximumEpsilonStep(1e-5);
-  westLocalFieldManager -> SetDeltaOneStep(0.1*um);
+DetectorConstructionMessenger::DetectorConstructionMessenger(DetectorConstruction* D): fDetector(D)
+{
+  fGeometryDir = new G4UIdirectory("/ucn/geometry/");
+  fGeometryDir->SetGuidance("Detector dimensions and materials.");
+  fGeometryDir->SetGuidance("Changes apply at /run/initialize, or after it with /ucn/geometry/rebuild.");
+
+  fScintThickCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/scintThickness", this);
+  fScintThickCmd->SetGuidance("Scintillator thickness, including the dead layer (which it must exceed)");
+  fScintThickCmd->SetDefaultValue(3.5);
+  fScintThickCmd->SetDefaultUnit("mm");
+  fScintThickCmd->SetRange("scintThickness>0");
+  fScintThickCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fDeadLayerCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/deadLayer", this);
+  fDeadLayerCmd->SetGuidance("Scintillator dead layer thickness (applied immediately, no rebuild needed)");
+  fDeadLayerCmd->SetGuidance("Must be below the scintillator thickness; other values are rejected.");
+  fDeadLayerCmd->SetDefaultValue(3.0);
+  fDeadLayerCmd->SetDefaultUnit("um");
+  fDeadLayerCmd->SetRange("deadLayer>0");
+  fDeadLayerCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fStepLimitCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/solidStepLimit", this);
+  fStepLimitCmd->SetGuidance("Maximum step in the windows and kevlar strings");
+  fStepLimitCmd->SetDefaultValue(1.0);
+  fStepLimitCmd->SetDefaultUnit("mm");
+  fStepLimitCmd->SetRange("solidStepLimit>0");
+  fStepLimitCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fSourceWindowThickCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/sourceWindowThickness", this);
+  fSourceWindowThickCmd->SetGuidance("Sealed source foil thickness");
+  fSourceWindowThickCmd->SetDefaultValue(4.7);
+  fSourceWindowThickCmd->SetDefaultUnit("um");
+  fSourceWindowThickCmd->SetRange("sourceWindowThickness>0");
+  fSourceWindowThickCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fTrapWindowThickCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/trapWindowThickness", this);
+  fTrapWindowThickCmd->SetGuidance("Decay trap window thickness");
+  fTrapWindowThickCmd->SetDefaultValue(0.180);
+  fTrapWindowThickCmd->SetDefaultUnit("um");
+  fTrapWindowThickCmd->SetRange("trapWindowThickness>0");
+  fTrapWindowThickCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fTrapCoatingThickCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/trapCoatingThickness", this);
+  fTrapCoatingThickCmd->SetGuidance("Decay trap window Be coating thickness");
+  fTrapCoatingThickCmd->SetDefaultValue(0.150);
+  fTrapCoatingThickCmd->SetDefaultUnit("um");
+  fTrapCoatingThickCmd->SetRange("trapCoatingThickness>0");
+  fTrapCoatingThickCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fMWPCWindowThickCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/mwpcWindowThickness", this);
+  fMWPCWindowThickCmd->SetGuidance("Wirechamber entrance and exit window thickness");
+  fMWPCWindowThickCmd->SetDefaultValue(6);
+  fMWPCWindowThickCmd->SetDefaultUnit("um");
+  fMWPCWindowThickCmd->SetRange("mwpcWindowThickness>0");
+  fMWPCWindowThickCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fWireSpacingCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/wireSpacing", this);
+  fWireSpacingCmd->SetGuidance("Anode and cathode wire spacing (64 wires per plane)");
+  fWireSpacingCmd->SetDefaultValue(2.54);
+  fWireSpacingCmd->SetDefaultUnit("mm");
+  fWireSpacingCmd->SetRange("wireSpacing>0");
+  fWireSpacingCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fKevlarSpacingCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/kevlarSpacing", this);
+  fKevlarSpacingCmd->SetGuidance("Spacing of the 32 kevlar window support strings");
+  fKevlarSpacingCmd->SetDefaultValue(5.0);
+  fKevlarSpacingCmd->SetDefaultUnit("mm");
+  fKevlarSpacingCmd->SetRange("kevlarSpacing>0");
+  fKevlarSpacingCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fKevlarRadiusCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/kevlarRadius", this);
+  fKevlarRadiusCmd->SetGuidance("Nominal kevlar string radius (modelled as an equal-area strip)");
+  fKevlarRadiusCmd->SetDefaultValue(0.07);
+  fKevlarRadiusCmd->SetDefaultUnit("mm");
+  fKevlarRadiusCmd->SetRange("kevlarRadius>0");
+  fKevlarRadiusCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fSourcePosCmd = new G4UIcmdWith3VectorAndUnit("/ucn/geometry/sourcePosition", this);
+  fSourcePosCmd->SetGuidance("Source holder position; generated vertices follow it");
+  fSourcePosCmd->SetParameterName("x", "y", "z", false);
+  fSourcePosCmd->SetDefaultUnit("mm");
+  fSourcePosCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fVacuumCmd = new G4UIcmdWithADoubleAndUnit("/ucn/geometry/vacuum", this);
+  fVacuumCmd->SetGuidance("Residual gas pressure (applied immediately, no rebuild needed)");
+  fVacuumCmd->SetDefaultValue(0);
+  fVacuumCmd->SetDefaultUnit("torr");
+  fVacuumCmd->SetRange("vacuum>=0");
+  fVacuumCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fSourceWindowMatCmd = new G4UIcmdWithAString("/ucn/geometry/sourceWindowMaterial", this);
+  fSourceWindowMatCmd->SetGuidance("Sealed source foil material (this geometry's or a NIST name)");
+  fSourceWindowMatCmd->SetDefaultValue("Mylar");
+  fSourceWindowMatCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fTrapWindowMatCmd = new G4UIcmdWithAString("/ucn/geometry/trapWindowMaterial", this);
+  fTrapWindowMatCmd->SetGuidance("Decay trap window material (this geometry's or a NIST name)");
+  fTrapWindowMatCmd->SetDefaultValue("Mylar");
+  fTrapWindowMatCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fMWPCWindowMatCmd = new G4UIcmdWithAString("/ucn/geometry/mwpcWindowMaterial", this);
+  fMWPCWindowMatCmd->SetGuidance("Wirechamber window material (this geometry's or a NIST name)");
+  fMWPCWindowMatCmd->SetDefaultValue("Mylar");
+  fMWPCWindowMatCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fMWPCGasCmd = new G4UIcmdWithAString("/ucn/geometry/mwpcGas", this);
+  fMWPCGasCmd->SetGuidance("Wirechamber fill gas, e.g. Pentane or MWPC_N2");
+  fMWPCGasCmd->SetDefaultValue("Pentane");
+  fMWPCGasCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fRebuildCmd = new G4UIcmdWithoutParameter("/ucn/geometry/rebuild", this);
+  fRebuildCmd->SetGuidance("Rebuild the geometry from the current parameters, keeping the physics tables");
+  fRebuildCmd->AvailableForStates(G4State_Idle);
+
+  fWirePlanesCmd = new G4UIcmdWithAString("/ucn/geometry/wirePlanes", this);
+  fWirePlanesCmd->SetGuidance("MWPC wire plane implementation: replicated segments or parameterised wires");
+  fWirePlanesCmd->SetCandidates("replica parameterised");
+  fWirePlanesCmd->SetDefaultValue("replica");
+  fWirePlanesCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCheckOverlapsCmd = new G4UIcmdWithABool("/ucn/geometry/checkOverlaps", this);
+  fCheckOverlapsCmd->SetGuidance("Check the top-level placements for overlaps while constructing");
+  fCheckOverlapsCmd->SetDefaultValue(true);
+  fCheckOverlapsCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fExportGDMLCmd = new G4UIcmdWithAString("/ucn/geometry/exportGDML", this);
+  fExportGDMLCmd->SetGuidance("Write the built geometry to a GDML file");
+  fExportGDMLCmd->SetParameterName("file", false);
+  fExportGDMLCmd->AvailableForStates(G4State_Idle);
+
+  fGDMLCacheCmd = new G4UIcmdWithAString("/ucn/geometry/gdmlCache", this);
+  fGDMLCacheCmd->SetGuidance("Fast start: load this GDML snapshot (no construction, no overlap checks) when");
+  fGDMLCacheCmd->SetGuidance("its checksum matches the current parameters; otherwise build and rewrite it.");
+  fGDMLCacheCmd->SetParameterName("file", false);
+  fGDMLCacheCmd->AvailableForStates(G4State_PreInit);
+
+  fSmartlessCmd = new G4UIcommand("/ucn/geometry/smartless", this);
+  fSmartlessCmd->SetGuidance("Smart voxel density for the daughters of a logical volume (G4 default 2).");
+  fSmartlessCmd->SetGuidance("0 turns voxelization off for that volume.");
+  G4UIparameter* volParam = new G4UIparameter("logVolume", 's', false);
+  fSmartlessCmd->SetParameter(volParam);
+  G4UIparameter* smartlessParam = new G4UIparameter("smartless", 'd', false);
+  smartlessParam->SetParameterRange("smartless>=0");
+  fSmartlessCmd->SetParameter(smartlessParam);
+  fSmartlessCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fVoxelFileCmd = new G4UIcmdWithAString("/ucn/geometry/voxelFile", this);
+  fVoxelFileCmd->SetGuidance("Voxel settings file read at construction, e.g. written by /ucn/validate/tuneVoxels");
+  fVoxelFileCmd->SetParameterName("file", false);
+  fVoxelFileCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fFieldDir = new G4UIdirectory("/ucn/field/");
+  fFieldDir->SetGuidance("Field transport settings.");
+
+  fHelixTransportCmd = new G4UIcmdWithABool("/ucn/field/helixTransport", this);
+  fHelixTransportCmd->SetGuidance("Exact helix steps in the flat sections of the solenoid field,");
+  fHelixTransportCmd->SetGuidance("numerical integration only in the transitions (false: numerical everywhere)");
+  fHelixTransportCmd->SetDefaultValue(true);
+  fHelixTransportCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCacheDistanceCmd = new G4UIcmdWithADoubleAndUnit("/ucn/field/cacheDistance", this);
+  fCacheDistanceCmd->SetGuidance("Reuse a thread's previous field value for queries within this distance of it");
+  fCacheDistanceCmd->SetGuidance("(solenoid and MWPC fields; 0 evaluates every query)");
+  fCacheDistanceCmd->SetDefaultValue(0.);
+  fCacheDistanceCmd->SetDefaultUnit("um");
+  fCacheDistanceCmd->SetRange("cacheDistance>=0");
+  fCacheDistanceCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCacheCheckCmd = new G4UIcmdWithAnInteger("/ucn/field/cacheCheck", this);
+  fCacheCheckCmd->SetGuidance("Also evaluate every Nth cache hit exactly, to measure the cache error (0: never)");
+  fCacheCheckCmd->SetDefaultValue(0);
+  fCacheCheckCmd->SetRange("N>=0");
+  fCacheCheckCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCacheReportCmd = new G4UIcmdWithoutParameter("/ucn/field/cacheReport", this);
+  fCacheReportCmd->SetGuidance("Print field cache hit rates and measured errors since the last report");
+  fCacheReportCmd->AvailableForStates(G4State_Idle);
+
+  fMWPCBTableCmd = new G4UIcmdWithABool("/ucn/field/mwpcBTable", this);
+  fMWPCBTableCmd->SetGuidance("Solenoid field inside the wirechambers from a fine table around each chamber");
+  fMWPCBTableCmd->SetGuidance("(false: evaluate the field profile on every call)");
+  fMWPCBTableCmd->SetDefaultValue(true);
+  fMWPCBTableCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCheckMWPCFieldCmd = new G4UIcmdWithAnInteger("/ucn/field/checkMWPCField", this);
+  fCheckMWPCFieldCmd->SetGuidance("Compare the tabulated wirechamber B field with the profile at random points,");
+  fCheckMWPCFieldCmd->SetGuidance("and time the field with either B and the E field alone");
+  fCheckMWPCFieldCmd->SetDefaultValue(1000000);
+  fCheckMWPCFieldCmd->SetRange("points>0");
+  fCheckMWPCFieldCmd->AvailableForStates(G4State_Idle);
+
+  fEnergyAwareCmd = new G4UIcmdWithABool("/ucn/field/energyAware", this);
+  fEnergyAwareCmd->SetGuidance("Looser integration tolerances for low-energy secondary electrons;");
+  fEnergyAwareCmd->SetGuidance("primaries, other species and energetic secondaries keep the base ones");
+  fEnergyAwareCmd->SetDefaultValue(true);
+  fEnergyAwareCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fLowEnergyCmd = new G4UIcmdWithADoubleAndUnit("/ucn/field/coarseBelow", this);
+  fLowEnergyCmd->SetGuidance("Secondary e-/e+ below this kinetic energy get coarseFactor looser tolerances");
+  fLowEnergyCmd->SetDefaultValue(1.);
+  fLowEnergyCmd->SetDefaultUnit("keV");
+  fLowEnergyCmd->SetRange("coarseBelow>=0");
+  fLowEnergyCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fHighEnergyCmd = new G4UIcmdWithADoubleAndUnit("/ucn/field/tightAbove", this);
+  fHighEnergyCmd->SetGuidance("Secondary e-/e+ above this kinetic energy keep the base tolerances;");
+  fHighEnergyCmd->SetGuidance("in between they get sqrt(coarseFactor) looser ones");
+  fHighEnergyCmd->SetDefaultValue(10.);
+  fHighEnergyCmd->SetDefaultUnit("keV");
+  fHighEnergyCmd->SetRange("tightAbove>=0");
+  fHighEnergyCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCoarseFactorCmd = new G4UIcmdWithADouble("/ucn/field/coarseFactor", this);
+  fCoarseFactorCmd->SetGuidance("Factor on delta chord, delta one step and epsilons for the coarse tier");
+  fCoarseFactorCmd->SetDefaultValue(10.);
+  fCoarseFactorCmd->SetRange("coarseFactor>=1");
+  fCoarseFactorCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fAccuracyReportCmd = new G4UIcmdWithoutParameter("/ucn/field/accuracyReport", this);
+  fAccuracyReportCmd->SetGuidance("Print the share of field steps in each tolerance tier since the last report");
+  fAccuracyReportCmd->AvailableForStates(G4State_Idle);
+}
 
-  mwpc_container_log[1] -> SetFieldManager(westLocalFieldManager, true);
-  return;
+DetectorConstructionMessenger::~DetectorConstructionMessenger()
+{
+  delete fScintThickCmd;
+  delete fDeadLayerCmd;
+  delete fStepLimitCmd;
+  delete fSourceWindowThickCmd;
+  delete fTrapWindowThickCmd;
+  delete fTrapCoatingThickCmd;
+  delete fMWPCWindowThickCmd;
+  delete fWireSpacingCmd;
+  delete fKevlarSpacingCmd;
+  delete fKevlarRadiusCmd;
+  delete fSourcePosCmd;
+  delete fVacuumCmd;
+  delete fSourceWindowMatCmd;
+  delete fTrapWindowMatCmd;
+  delete fMWPCWindowMatCmd;
+  delete fMWPCGasCmd;
+  delete fRebuildCmd;
+  delete fWirePlanesCmd;
+  delete fCheckOverlapsCmd;
+  delete fExportGDMLCmd;
+  delete fGDMLCacheCmd;
+  delete fSmartlessCmd;
+  delete fVoxelFileCmd;
+  delete fHelixTransportCmd;
+  delete fCacheDistanceCmd;
+  delete fCacheCheckCmd;
+  delete fCacheReportCmd;
+  delete fMWPCBTableCmd;
+  delete fCheckMWPCFieldCmd;
+  delete fEnergyAwareCmd;
+  delete fLowEnergyCmd;
+  delete fHighEnergyCmd;
+  delete fCoarseFactorCmd;
+  delete fAccuracyReportCmd;
+  delete fFieldDir;
+  delete fGeometryDir;
+}
+
+void DetectorConstructionMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fScintThickCmd)
+    fDetector->SetScintThickness(fScintThickCmd->GetNewDoubleValue(newValue));
+  else if(command == fDeadLayerCmd)
+    fDetector->SetDeadLayerThickness(fDeadLayerCmd->GetNewDoubleValue(newValue));
+  else if(command == fStepLimitCmd)
+    fDetector->SetScintStepLimit(fStepLimitCmd->GetNewDoubleValue(newValue));
+  else if(command == fSourceWindowThickCmd)
+    fDetector->SetSourceWindowThickness(fSourceWindowThickCmd->GetNewDoubleValue(newValue));
+  else if(command == fTrapWindowThickCmd)
+    fDetector->SetTrapWindowThickness(fTrapWindowThickCmd->GetNewDoubleValue(newValue));
+  else if(command == fTrapCoatingThickCmd)
+    fDetector->SetTrapCoatingThickness(fTrapCoatingThickCmd->GetNewDoubleValue(newValue));
+  else if(command == fMWPCWindowThickCmd)
+    fDetector->SetMWPCWindowThickness(fMWPCWindowThickCmd->GetNewDoubleValue(newValue));
+  else if(command == fWireSpacingCmd)
+    fDetector->SetWireSpacing(fWireSpacingCmd->GetNewDoubleValue(newValue));
+  else if(command == fKevlarSpacingCmd)
+    fDetector->SetKevlarSpacing(fKevlarSpacingCmd->GetNewDoubleValue(newValue));
+  else if(command == fKevlarRadiusCmd)
+    fDetector->SetKevlarRadius(fKevlarRadiusCmd->GetNewDoubleValue(newValue));
+  else if(command == fSourcePosCmd)
+    fDetector->SetSourcePosition(fSourcePosCmd->GetNew3VectorValue(newValue));
+  else if(command == fVacuumCmd)
+    fDetector->SetVacuumPressure(fVacuumCmd->GetNewDoubleValue(newValue));
+  else if(command == fSourceWindowMatCmd)
+    fDetector->SetSourceWindowMaterial(newValue);
+  else if(command == fTrapWindowMatCmd)
+    fDetector->SetTrapWindowMaterial(newValue);
+  else if(command == fMWPCWindowMatCmd)
+    fDetector->SetMWPCWindowMaterial(newValue);
+  else if(command == fMWPCGasCmd)
+    fDetector->SetMWPCFillGas(newValue);
+  else if(command == fRebuildCmd)
+    fDetector->RebuildGeometry();
+  else if(command == fWirePlanesCmd)
+    fDetector->SetParameterisedWires(newValue == "parameterised");
+  else if(command == fCheckOverlapsCmd)
+    fDetector->SetCheckOverlaps(fCheckOverlapsCmd->GetNewBoolValue(newValue));
+  else if(command == fExportGDMLCmd)
+    fDetector->ExportGDML(newValue);
+  else if(command == fGDMLCacheCmd)
+    fDetector->SetGDMLCache(newValue);
+  else if(command == fSmartlessCmd)
+  {
+    G4String volume;
+    G4double smartless;
+    istringstream(newValue) >> volume >> smartless;
+    fDetector->SetSmartless(volume, smartless);
+  }
+  else if(command == fVoxelFileCmd)
+    fDetector->SetVoxelFile(newValue);
+  else if(command == fHelixTransportCmd)
+    fDetector->SetHelixTransport(fHelixTransportCmd->GetNewBoolValue(newValue));
+  else if(command == fCacheDistanceCmd)
+    fDetector->SetFieldCacheDistance(fCacheDistanceCmd->GetNewDoubleValue(newValue));
+  else if(command == fCacheCheckCmd)
+    fDetector->SetFieldCacheCheck(fCacheCheckCmd->GetNewIntValue(newValue));
+  else if(command == fCacheReportCmd)
+    fDetector->ReportFieldCache();
+  else if(command == fMWPCBTableCmd)
+    fDetector->SetMWPCBTable(fMWPCBTableCmd->GetNewBoolValue(newValue));
+  else if(command == fCheckMWPCFieldCmd)
+    fDetector->CheckMWPCField(fCheckMWPCFieldCmd->GetNewIntValue(newValue));
+  else if(command == fEnergyAwareCmd)
+    fDetector->GetAccuracyPolicy().enabled = fEnergyAwareCmd->GetNewBoolValue(newValue);
+  else if(command == fLowEnergyCmd)
+    fDetector->GetAccuracyPolicy().lowEnergy = fLowEnergyCmd->GetNewDoubleValue(newValue);
+  else if(command == fHighEnergyCmd)
+    fDetector->GetAccuracyPolicy().highEnergy = fHighEnergyCmd->GetNewDoubleValue(newValue);
+  else if(command == fCoarseFactorCmd)
+    fDetector->GetAccuracyPolicy().coarseFactor = fCoarseFactorCmd->GetNewDoubleValue(newValue);
+  else if(command == fAccuracyReportCmd)
+    fDetector->ReportFieldAccuracy();
 }
@@ -0,0 +1,72 @@
+#include <cmath>
+
+#include "EnergyAwareFieldManager.hh"
+
+#include "G4ChordFinder.hh"
+#include "G4Track.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstdio>
+using   namespace       std;
+
+EnergyAwareFieldManager::EnergyAwareFieldManager(G4Field* field, const FieldAccuracyPolicy* policy)
+ : G4FieldManager(field), fPolicy(policy), fDeltaChord(0), fDeltaOneStep(0), fEpsMin(0), fEpsMax(0), fTier(kTight)
+{
+  for(int i = 0; i < 3; i++) fSteps[i] = 0;
+}
+
+void EnergyAwareFieldManager::SetBaseAccuracy(G4double deltaChord, G4double deltaOneStep, G4double epsMin, G4double epsMax)
+{
+  fDeltaChord = deltaChord;
+  fDeltaOneStep = deltaOneStep;
+  fEpsMin = epsMin;
+  fEpsMax = epsMax;
+  fTier = -1;
+  ApplyTier(kTight);
+}
+
+void EnergyAwareFieldManager::ConfigureForTrack(const G4Track* track)
+{
+  G4int tier = kTight;
+  if(fPolicy->enabled && track->GetParentID() != 0 && abs(track->GetDefinition()->GetPDGEncoding()) == 11)
+  {
+    G4double E = track->GetKineticEnergy();
+    if(E < fPolicy->lowEnergy) tier = kCoarse;
+    else if(E < fPolicy->highEnergy) tier = kMedium;
+  }
+  fSteps[tier]++;
+  if(tier != fTier) ApplyTier(tier);
+}
+
+void EnergyAwareFieldManager::ApplyTier(G4int tier)
+{
+  G4double f = 1.;
+  if(tier == kCoarse) f = fPolicy->coarseFactor;
+  else if(tier == kMedium) f = sqrt(fPolicy->coarseFactor);
+
+  GetChordFinder() -> SetDeltaChord(fDeltaChord*f);
+  SetDeltaOneStep(fDeltaOneStep*f);
+  // G4FieldManager rejects a minimum above the maximum, so move them in the right order
+  if(tier > fTier)
+  {
+    SetMaximumEpsilonStep(min(fEpsMax*f, 0.05));
+    SetMinimumEpsilonStep(min(fEpsMin*f, 0.05));
+  }
+  else
+  {
+    SetMinimumEpsilonStep(fEpsMin*f);
+    SetMaximumEpsilonStep(fEpsMax*f);
+  }
+  fTier = tier;
+}
+
+void EnergyAwareFieldManager::Report(const G4String& name)
+{
+  long long total = fSteps[kTight] + fSteps[kMedium] + fSteps[kCoarse];
+  char line[256];
+  snprintf(line, sizeof(line), "%s field steps: %lld, tight %.1f%%, medium %.1f%%, coarse %.1f%%\n", name.c_str(), total,
+	   total ? 100.*fSteps[kTight]/total : 0., total ? 100.*fSteps[kMedium]/total : 0., total ? 100.*fSteps[kCoarse]/total : 0.);
+  G4cout << line;
+  for(int i = 0; i < 3; i++) fSteps[i] = 0;
+}
@@ -1,4 +1,9 @@
 #include "EventAction.hh"
+#include "RunAction.hh"
+#include "RunTracer.hh"
+#include "ProgressMonitor.hh"
+#include "PrimaryGeneratorAction.hh"
+#include "ImportanceSplitting.hh"
 
 #include "G4Event.hh"
 #include "G4EventManager.hh"
@@ -15,10 +20,12 @@
 #include <cmath>
 using   namespace       std;
 
-#define	OUTPUT_FILE	"FinalSim_EnergyOutput.txt"
+#define	OUTPUT_FILE	(RunAction::GetOutputFileName().c_str())	// set per sweep point by SweepDriver
 
 EventAction::EventAction()
-: G4UserEventAction()
+: G4UserEventAction(),
+  fNSteps(0),
+  fTraceEventBegin(0)
 {}
 
 
@@ -32,27 +39,66 @@ void EventAction::BeginOfEventAction(const G4Event* evt)
   fEdep_West_Scint = 0;
   fEdep_East_MWPC = 0;
   fEdep_West_MWPC = 0;
+  fBranchEdep.clear();
+  fNSteps = 0;
 
-  if((evt->GetEventID())%1000 == 0)
-  {
-    G4cout << "\n -------------- Begin of event: " << evt->GetEventID() << G4endl;
-  }
+  if(RunTracer::TraceEvents()) fTraceEventBegin = RunTracer::Instance()->Now();
 }
 
 
 void EventAction::EndOfEventAction(const G4Event* evt)
 {
+  G4bool traceEvents = RunTracer::TraceEvents();
+  double tWrite = traceEvents ? RunTracer::Instance()->Now() : 0;
+
+  // the weight column is only written when splitting is on, so unbiased output keeps its format
+  G4bool weighted = ImportanceSplitting::Instance()->IsEnabled();
   ofstream outfile;
   outfile.open(OUTPUT_FILE, ios::app);
-  outfile << fEdep_East_Scint/keV << "\t \t" << fEdep_East_MWPC/keV << "\t \t"
-	  << fEdep_West_Scint/keV << "\t \t" << fEdep_West_MWPC/keV << "\n";
+  if(fBranchEdep.empty())
+  {
+    outfile << fEdep_East_Scint/keV << "\t \t" << fEdep_East_MWPC/keV << "\t \t"
+	    << fEdep_West_Scint/keV << "\t \t" << fEdep_West_MWPC/keV;
+    if(weighted) outfile << "\t \t" << 1;
+    outfile << "\n";
+  }
+  else
+  {
+    // one row per branch: trunk + branch deposits, weight 1/nBranches. The primary
+    // generator already wrote the first row's primary columns; repeat them for the others.
+    const PrimaryGeneratorAction* generator =
+      static_cast<const PrimaryGeneratorAction*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    int nBranches = fBranchEdep.size()/4;
+    for(int b = 0; b < nBranches; b++)
+    {
+      if(b > 0) outfile << generator->GetRowPrefix();
+      outfile << (fEdep_East_Scint + fBranchEdep[4*b])/keV << "\t \t" << (fEdep_East_MWPC + fBranchEdep[4*b+1])/keV << "\t \t"
+	      << (fEdep_West_Scint + fBranchEdep[4*b+2])/keV << "\t \t" << (fEdep_West_MWPC + fBranchEdep[4*b+3])/keV << "\t \t"
+	      << 1./nBranches << "\n";
+    }
+  }
   outfile.close();
+
+  if(traceEvents)
+  {
+    RunTracer* tracer = RunTracer::Instance();
+    double tEnd = tracer->Now();
+    tracer->Record("Event", "event", fTraceEventBegin, tWrite);
+    tracer->Record("WriteEvent", "output", tWrite, tEnd);
+  }
+
+  ProgressMonitor::Instance()->EventDone(fNSteps);
 }
 
 // typeFlag = 0 -> Scint
 //	      1 -> MWPC
-void EventAction::AddEdep(G4double edep, int typeFlag, int locFlag)
+void EventAction::AddEdep(G4double edep, int typeFlag, int locFlag, int branch)
 {
+  if(branch >= 0)
+  {
+    fBranchEdep[4*branch + 2*locFlag + typeFlag] += edep;
+    return;
+  }
   if(locFlag == 0)
   {
     if(typeFlag == 0)
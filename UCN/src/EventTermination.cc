@@ -0,0 +1,249 @@
+#include "EventTermination.hh"
+#include "DetectorConstruction.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Gamma.hh"
+#include "G4Material.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4VSolid.hh"
+#include "G4VisExtent.hh"
+#include "G4EmCalculator.hh"
+#include "G4EventManager.hh"
+#include "G4StackManager.hh"
+#include "G4TrackingManager.hh"
+#include "G4TransportationManager.hh"
+#include "G4Navigator.hh"
+#include "G4Threading.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+using   namespace       std;
+
+namespace
+{
+  double SteadySeconds()
+  {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+  }
+}
+
+EventTermination* EventTermination::Instance()
+{
+  static EventTermination* theTermination = new EventTermination();	// never deleted, like RunTracer
+  return theTermination;
+}
+
+EventTermination::EventTermination()
+: fMode(kOff), fGammaLengths(10.), fRegionRadius(0), fRegionHalfZ(0),
+  fEventsEnded(0), fTailNanoseconds(0), fTailSteps(0), fTails(0), fViolations(0), fViolationEdep(0),
+  fRunStart(SteadySeconds()), fAuditTailPerTrack(0)
+{
+  for(int i = 0; i < kNReasons; i++) fInert[i] = 0;
+  fMessenger = new EventTerminationMessenger(this);
+}
+
+void EventTermination::SetMode(const G4String& mode)
+{
+  if(mode == "kill") fMode = kKill;
+  else if(mode == "audit") fMode = kAudit;
+  else fMode = kOff;
+}
+
+void EventTermination::BeginRun()
+{
+  // nothing lies beyond the bounding cylinder of the world's daughters
+  fRegionRadius = fRegionHalfZ = 0;
+  G4VPhysicalVolume* world = G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume();
+  G4LogicalVolume* worldLog = world->GetLogicalVolume();
+  for(int i = 0; i < worldLog->GetNoDaughters(); i++)
+  {
+    G4VPhysicalVolume* daughter = worldLog->GetDaughter(i);
+    G4VisExtent extent = daughter->GetLogicalVolume()->GetSolid()->GetExtent();
+    G4double x = max(fabs(extent.GetXmin()), fabs(extent.GetXmax()));
+    G4double y = max(fabs(extent.GetYmin()), fabs(extent.GetYmax()));
+    G4double z = max(fabs(extent.GetZmin()), fabs(extent.GetZmax()));
+    G4double reach = sqrt(x*x + y*y + z*z);	// any rotation stays inside this sphere
+    G4ThreeVector centre = daughter->GetTranslation();
+    fRegionRadius = max(fRegionRadius, centre.perp() + reach);
+    fRegionHalfZ = max(fRegionHalfZ, fabs(centre.z()) + reach);
+  }
+
+  for(int i = 0; i < kNReasons; i++) fInert[i] = 0;
+  fEventsEnded = 0;
+  fTailNanoseconds = 0;
+  fTailSteps = 0;
+  fTails = 0;
+  fViolations = 0;
+  fViolationEdep = 0;
+  fRunStart = SteadySeconds();
+}
+
+void EventTermination::EndRun()
+{
+  if(fMode == kOff) return;
+  long long nInert = 0;
+  for(int i = 1; i < kNReasons; i++) nInert += fInert[i];
+
+  char line[256];
+  snprintf(line, sizeof(line), "Event termination (%s): %lld inert tracks (%lld stopped, %lld absorbed, %lld escaping), "
+	   "%lld events %s by it, run %.1f s\n", fMode == kKill ? "kill" : "audit", nInert, fInert[kStopped].load(),
+	   fInert[kAbsorbed].load(), fInert[kEscaping].load(), fEventsEnded.load(),
+	   fMode == kKill ? "ended" : "would have ended", SteadySeconds() - fRunStart);
+  G4cout << line;
+  if(fMode == kAudit)
+  {
+    long long nTails = fTails;
+    double tailSeconds = fTailNanoseconds*1e-9;
+    if(nTails) fAuditTailPerTrack = tailSeconds/nTails;
+    snprintf(line, sizeof(line), "  kill would save %.2f s of stepping (%.1f us, %.1f steps per track); "
+	     "%lld flagged tracks still deposited, %.1f keV in total\n", tailSeconds,
+	     1e6*fAuditTailPerTrack, nTails ? fTailSteps/(double)nTails : 0., fViolations.load(), fViolationEdep*1e-3);
+    G4cout << line;
+  }
+  else if(fAuditTailPerTrack > 0)
+  {
+    snprintf(line, sizeof(line), "  about %.2f s of stepping saved (%.1f us per track, from the last audit run)\n",
+	     nInert*fAuditTailPerTrack, 1e6*fAuditTailPerTrack);
+    G4cout << line;
+  }
+}
+
+G4bool EventTermination::Escaping(const G4Track* track) const
+{
+  // on a straight line, a growing distance from the axis (or the mid-plane) keeps growing
+  G4ThreeVector pos = track->GetPosition();
+  G4ThreeVector dir = track->GetMomentumDirection();
+  if(pos.perp() > fRegionRadius && pos.x()*dir.x() + pos.y()*dir.y() >= 0) return true;
+  if(fabs(pos.z()) > fRegionHalfZ && pos.z()*dir.z() >= 0) return true;
+  return false;
+}
+
+EventTermination::Reason EventTermination::Classify(const G4Step* step, const DetectorConstruction* detector) const
+{
+  const G4StepPoint* post = step->GetPostStepPoint();
+  return ClassifyAt(step->GetTrack(), post->GetPhysicalVolume(), post->GetSafety(), detector);
+}
+
+EventTermination::Reason EventTermination::ClassifyAt(const G4Track* track, G4VPhysicalVolume* volume, G4double safety,
+						      const DetectorConstruction* detector) const
+{
+  if(volume == NULL) return kNotInert;		// leaving the world anyway
+  G4LogicalVolume* logical = volume->GetLogicalVolume();
+  for(int i = 0; i <= 1; i++)
+    if(logical == detector->scint_scintillator_log[i] || logical == detector->mwpc_container_log[i]) return kNotInert;
+
+  const G4ParticleDefinition* particle = track->GetDefinition();
+  if(particle->GetPDGCharge() == 0 && volume->GetMotherLogical() == NULL && Escaping(track)) return kEscaping;
+
+  if(safety <= 0) return kNotInert;
+  const G4Material* material = logical->GetMaterial();
+  static G4ThreadLocal G4EmCalculator* calculator = 0;
+  if(!calculator) calculator = new G4EmCalculator();
+  // electrons only: a stopped positron still sends two 511 keV gammas off
+  if(particle->GetPDGEncoding() == 11)
+  {
+    G4double range = calculator->GetRangeFromRestricteDEDX(track->GetKineticEnergy(), particle, material);
+    if(range < safety) return kStopped;
+  }
+  else if(particle == G4Gamma::Gamma())
+  {
+    G4double length = calculator->ComputeGammaAttenuationLength(track->GetKineticEnergy(), material);
+    if(fGammaLengths*length < safety) return kAbsorbed;
+  }
+  return kNotInert;
+}
+
+void EventTermination::Apply(const G4Step* step, const DetectorConstruction* detector, G4double sensitiveEdep,
+			     map<G4int, InertTail>& tails)
+{
+  G4Track* track = step->GetTrack();
+  if(track->GetCurrentStepNumber() == 1) tails.erase(track->GetTrackID());	// left over from an aborted event
+
+  map<G4int, InertTail>::iterator tail = tails.find(track->GetTrackID());
+  if(tail != tails.end())
+  {
+    // audit: follow the flagged track to its end
+    tail->second.steps++;
+    tail->second.edep += sensitiveEdep;
+    if(track->GetTrackStatus() == fAlive) return;
+    fTailNanoseconds += (long long)(1e9*(SteadySeconds() - tail->second.start));
+    fTailSteps += tail->second.steps;
+    fTails++;
+    if(tail->second.edep > 0)
+    {
+      fViolations++;
+      fViolationEdep += (long long)(tail->second.edep/eV);
+    }
+    tails.erase(tail);
+    return;
+  }
+
+  if(track->GetTrackStatus() != fAlive) return;
+  Reason reason = Classify(step, detector);
+  if(reason == kNotInert) return;
+  fInert[reason]++;
+
+  // the event ends with this track if nothing is stacked and it made no secondaries
+  G4EventManager* eventManager = G4EventManager::GetEventManager();
+  if(eventManager->GetStackManager()->GetNTotalTrack() == 0 && eventManager->GetTrackingManager()->GimmeSecondaries()->empty())
+    fEventsEnded++;
+
+  if(fMode == kKill)
+  {
+    track->SetTrackStatus(fStopAndKill);
+    return;
+  }
+  InertTail flagged;
+  flagged.start = SteadySeconds();
+  flagged.steps = 0;
+  flagged.edep = 0;
+  flagged.reason = reason;
+  tails[track->GetTrackID()] = flagged;
+}
+
+//----------------------------------------------------------------
+
+EventTerminationMessenger::EventTerminationMessenger(EventTermination* T): fTermination(T)
+{
+  fTerminationDir = new G4UIdirectory("/ucn/termination/");
+  fTerminationDir->SetGuidance("Early end of tracks that can no longer reach a scintillator or MWPC");
+
+  fModeCmd = new G4UIcmdWithAString("/ucn/termination/mode", this);
+  fModeCmd->SetGuidance("off (default), audit (flag inert tracks, follow them and time the remainder) or kill");
+  fModeCmd->SetCandidates("off audit kill");
+  fModeCmd->SetDefaultValue("off");
+  fModeCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fGammaLengthsCmd = new G4UIcmdWithADouble("/ucn/termination/gammaLengths", this);
+  fGammaLengthsCmd->SetGuidance("Attenuation lengths to the nearest boundary for a gamma to count as absorbed");
+  fGammaLengthsCmd->SetDefaultValue(10.);
+  fGammaLengthsCmd->SetRange("gammaLengths>0");
+  fGammaLengthsCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+EventTerminationMessenger::~EventTerminationMessenger()
+{
+  delete fModeCmd;
+  delete fGammaLengthsCmd;
+  delete fTerminationDir;
+}
+
+void EventTerminationMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fModeCmd)
+  {
+    fTermination->SetMode(newValue);
+  }
+  else if(command == fGammaLengthsCmd)
+  {
+    fTermination->SetGammaLengths(fGammaLengthsCmd->GetNewDoubleValue(newValue));
+  }
+}
@@ -0,0 +1,603 @@
+#include "GeometryValidator.hh"
+#include "DetectorConstruction.hh"
+#include "RunTracer.hh"
+#include "QFile.hh"
+#include "PathUtils.hh"
+
+#include "G4PhysicalVolumeStore.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4LogicalVolume.hh"
+#include "G4Material.hh"
+#include "G4Box.hh"
+#include "G4Navigator.hh"
+#include "G4GeometryManager.hh"
+#include "G4TransportationManager.hh"
+#include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+#include "geomdefs.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIparameter.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <sstream>
+using   namespace       std;
+
+namespace
+{
+  double SteadySeconds()
+  {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  //----- ray casting
+  struct RayTally
+  {
+    RayTally(): length(0), areal(0), rays(0), lastRay(-1), material(NULL) {}
+    double length;		// summed path length
+    double areal;		// summed path length * density
+    long long rays;		// rays that entered the volume
+    long long lastRay;
+    const G4Material* material;
+  };
+  typedef map<G4VPhysicalVolume*, RayTally> TallyMap;
+
+  bool MoreDaughters(const G4LogicalVolume* a, const G4LogicalVolume* b)
+  {
+    return a->GetNoDaughters() > b->GetNoDaughters();
+  }
+
+  bool ProfileOrder(const ThicknessEntry& a, const ThicknessEntry& b)
+  {
+    if(a.direction != b.direction) return a.direction < b.direction;
+    return a.volume < b.volume;
+  }
+}
+
+GeometryValidator::GeometryValidator(DetectorConstruction* det)
+: fDetector(det), fRadius(5*cm), fTolerance(1e-3)
+{
+  fMessenger = new GeometryValidatorMessenger(this);
+}
+
+GeometryValidator::~GeometryValidator()
+{
+  delete fMessenger;
+}
+
+G4VPhysicalVolume* GeometryValidator::World() const
+{
+  // after a /ucn/geometry/rebuild the navigator still points at the deleted world until the next BeamOn
+  G4VPhysicalVolume* world = NULL;
+  if(fDetector->IsBuilt())
+    world = G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume();
+  if(world == NULL) G4cout << "GeometryValidator: no geometry built; run /run/initialize (or /run/beamOn 0 after a rebuild) first." << G4endl;
+  return world;
+}
+
+G4int GeometryValidator::CheckOverlaps(G4int nPoints)
+{
+  TraceScope trace("CheckOverlaps", "validate");
+  if(World() == NULL) return 0;
+
+  // placements and parameterised volumes (G4PVParameterised::CheckOverlaps tests every copy, e.g.
+  // wires spaced closer than their diameter); only true replicas can't overlap by construction
+  vector<G4VPhysicalVolume*> volumes;
+  G4PhysicalVolumeStore* pvStore = G4PhysicalVolumeStore::GetInstance();
+  for(G4PhysicalVolumeStore::iterator it = pvStore->begin(); it != pvStore->end(); it++)
+  {
+    if((*it)->GetMotherLogical() == NULL) continue;
+    if(!(*it)->IsReplicated() || (*it)->IsParameterised()) volumes.push_back(*it);
+  }
+
+  // on this (master) thread: threads not started by the run manager lack Geant4's per-thread
+  // geometry copies, random engine, output buffering and exception handling
+  vector<char> overlapping(volumes.size(), 0);
+  double tStart = SteadySeconds();
+  for(unsigned int i = 0; i < volumes.size(); i++)
+    overlapping[i] = volumes[i]->CheckOverlaps(nPoints, 0., false);
+
+  G4int nOverlapping = 0;
+  for(unsigned int i = 0; i < volumes.size(); i++)
+  {
+    if(!overlapping[i]) continue;
+    nOverlapping++;
+    G4cout << "  overlap: " << volumes[i]->GetName() << " in " << volumes[i]->GetMotherLogical()->GetName() << G4endl;
+  }
+  G4cout << "GeometryValidator: checked " << volumes.size() << " placements and parameterisations (" << nPoints << " points each) in "
+	 << SteadySeconds() - tStart << " s: " << nOverlapping << " overlapping." << G4endl;
+  return nOverlapping;
+}
+
+void GeometryValidator::CastDirection(G4VPhysicalVolume* world, G4bool axial, G4int nRays)
+{
+  G4Box* worldBox = dynamic_cast<G4Box*>(world->GetLogicalVolume()->GetSolid());
+  if(worldBox == NULL)
+  {
+    G4cout << "GeometryValidator: ray casting expects a box world." << G4endl;
+    return;
+  }
+
+  const G4double halfX = worldBox->GetXHalfLength(), halfZ = worldBox->GetZHalfLength();
+  const double eps = 1*um;	// start just inside the world
+  G4ThreeVector dir = axial ? G4ThreeVector(0,0,1) : G4ThreeVector(1,0,0);
+  G4Navigator nav;
+  nav.SetWorldVolume(world);
+  mt19937_64 rng(axial ? 0 : 1);	// fixed seeds: repeated profiles of one geometry agree exactly
+  uniform_real_distribution<double> flat(0., 1.);
+
+  TallyMap tallies;
+  for(long long ray = 0; ray < nRays; ray++)
+  {
+    G4ThreeVector p;
+    if(axial)	// uniform over a disk around the axis
+    {
+      double r = fRadius*sqrt(flat(rng));
+      double phi = 2*M_PI*flat(rng);
+      p = G4ThreeVector(r*cos(phi), r*sin(phi), -halfZ + eps);
+    }
+    else		// uniform over the full length, within the bundle height
+      p = G4ThreeVector(-halfX + eps, fRadius*(2*flat(rng) - 1), halfZ*(2*flat(rng) - 1));
+
+    G4VPhysicalVolume* pv = nav.LocateGlobalPointAndSetup(p, &dir, false, false);
+    for(int nSteps = 0; pv != NULL && nSteps < 100000; nSteps++)
+    {
+      double safety;
+      double step = nav.ComputeStep(p, dir, kInfinity, safety);
+      if(step >= kInfinity) break;
+      if(step > 0)	// zero steps only relocate across a boundary
+      {
+	RayTally& t = tallies[pv];
+	if(t.lastRay != ray)
+	{
+	  t.lastRay = ray;
+	  t.rays++;
+	  t.material = pv->GetLogicalVolume()->GetMaterial();
+	}
+	t.length += step;
+	t.areal += step*t.material->GetDensity();
+	p += step*dir;
+      }
+      nav.SetGeometricallyLimitedStep();
+      pv = nav.LocateGlobalPointAndSetup(p, &dir, true);
+    }
+  }
+
+  for(TallyMap::const_iterator it = tallies.begin(); it != tallies.end(); it++)
+  {
+    ThicknessEntry e;
+    e.volume = it->first->GetName();
+    e.material = it->second.material->GetName();
+    e.direction = axial ? "axial" : "transverse";
+    e.hitFraction = it->second.rays/(double)nRays;
+    e.thickness = it->second.length/it->second.rays;
+    e.arealDensity = it->second.areal/it->second.rays;
+    fProfile.push_back(e);
+  }
+}
+
+void GeometryValidator::CastRays(G4int nRays)
+{
+  TraceScope trace("CastRays", "validate");
+  G4VPhysicalVolume* world = World();
+  if(world == NULL) return;
+  G4GeometryManager::GetInstance()->CloseGeometry(true);	// voxelized navigation; no-op if already closed
+
+  double tStart = SteadySeconds();
+  fProfile.clear();
+  CastDirection(world, true, nRays);
+  CastDirection(world, false, nRays);
+  sort(fProfile.begin(), fProfile.end(), ProfileOrder);
+  G4cout << "GeometryValidator: cast 2 x " << nRays << " rays in " << SteadySeconds() - tStart << " s." << G4endl;
+  WriteProfile("");
+}
+
+void GeometryValidator::WriteProfile(const G4String& fileName) const
+{
+  char line[256];
+  snprintf(line, sizeof(line), "%-11s %-30s %-14s %9s %14s %14s\n", "direction", "volume", "material", "hit frac", "thickness[um]", "rho*t[mg/cm2]");
+  G4cout << line;
+  QFile qOut;
+  for(unsigned int i = 0; i < fProfile.size(); i++)
+  {
+    const ThicknessEntry& e = fProfile[i];
+    snprintf(line, sizeof(line), "%-11s %-30s %-14s %9.5f %14.5g %14.5g\n", e.direction.c_str(), e.volume.c_str(),
+	     e.material.c_str(), e.hitFraction, e.thickness/um, e.arealDensity/(mg/cm2));
+    G4cout << line;
+
+    Stringmap m;
+    m.insert("direction", e.direction);
+    m.insert("volume", e.volume);
+    m.insert("material", e.material);
+    m.insert("hitFraction", e.hitFraction);
+    m.insert("thickness_um", e.thickness/um);
+    m.insert("areal_mg_cm2", e.arealDensity/(mg/cm2));
+    qOut.insert("thickness", m);
+  }
+  if(fileName == "") return;
+  qOut.commit(fileName);
+  G4cout << "GeometryValidator: wrote thickness profile to " << fileName << G4endl;
+}
+
+G4int GeometryValidator::CompareToReference(const G4String& fileName) const
+{
+  if(!fileExists(fileName))
+  {
+    G4cout << "GeometryValidator: reference " << fileName << " not found." << G4endl;
+    return -1;
+  }
+  if(fProfile.empty())
+  {
+    G4cout << "GeometryValidator: no profile to compare; run /ucn/validate/rays first." << G4endl;
+    return -1;
+  }
+
+  map<string, const ThicknessEntry*> current;
+  for(unsigned int i = 0; i < fProfile.size(); i++)
+    current[fProfile[i].direction + " " + fProfile[i].volume] = &fProfile[i];
+
+  G4int nDiff = 0;
+  vector<Stringmap> ref = QFile(fileName).retrieve("thickness");
+  map<string, bool> seen;
+  for(unsigned int i = 0; i < ref.size(); i++)
+  {
+    string key = ref[i].getDefault("direction", "") + " " + ref[i].getDefault("volume", "");
+    seen[key] = true;
+    map<string, const ThicknessEntry*>::const_iterator it = current.find(key);
+    if(it == current.end())
+    {
+      G4cout << "  missing:  " << key << G4endl;
+      nDiff++;
+      continue;
+    }
+    const ThicknessEntry& e = *it->second;
+    double refThick = ref[i].getDefault("thickness_um", 0);
+    double refAreal = ref[i].getDefault("areal_mg_cm2", 0);
+    double dThick = fabs(e.thickness/um - refThick)/max(refThick, 1e-12);
+    double dAreal = fabs(e.arealDensity/(mg/cm2) - refAreal)/max(refAreal, 1e-12);
+    if(dThick > fTolerance || dAreal > fTolerance || e.material != ref[i].getDefault("material", ""))
+    {
+      G4cout << "  changed:  " << key << ": " << ref[i].getDefault("material", "") << " " << refThick << " um, "
+	     << refAreal << " mg/cm2 -> " << e.material << " " << e.thickness/um << " um, "
+	     << e.arealDensity/(mg/cm2) << " mg/cm2" << G4endl;
+      nDiff++;
+    }
+  }
+  for(map<string, const ThicknessEntry*>::const_iterator it = current.begin(); it != current.end(); it++)
+  {
+    if(seen.count(it->first)) continue;
+    G4cout << "  new:      " << it->first << G4endl;
+    nDiff++;
+  }
+  G4cout << "GeometryValidator: " << nDiff << " of " << fProfile.size() << " profile entries differ from "
+	 << fileName << " (relative tolerance " << fTolerance << ")." << G4endl;
+  return nDiff;
+}
+
+NavigationTiming GeometryValidator::BenchmarkNavigation(G4int nCrossings)
+{
+  TraceScope trace("BenchmarkNavigation", "validate");
+  NavigationTiming timing = { 0, 0, 0 };
+  G4VPhysicalVolume* world = World();
+  if(world == NULL) return timing;
+  G4GeometryManager::GetInstance()->CloseGeometry(true);
+
+  // the West chamber is unrotated: cross it along +z from just before its entrance window
+  G4VPhysicalVolume* chamber = G4PhysicalVolumeStore::GetVolume("mwpc_container_phys_West", false);
+  G4Box* chamberBox = chamber ? dynamic_cast<G4Box*>(chamber->GetLogicalVolume()->GetSolid()) : NULL;
+  if(chamberBox == NULL)
+  {
+    G4cout << "GeometryValidator: West wirechamber not found." << G4endl;
+    return timing;
+  }
+  G4double zIn = chamber->GetTranslation().z() - chamberBox->GetZHalfLength() - 1*mm;
+  G4double zOut = chamber->GetTranslation().z() + chamberBox->GetZHalfLength() + 1*mm;
+
+  G4Navigator nav;
+  nav.SetWorldVolume(world);
+  mt19937_64 rng(1);		// same crossings for every geometry
+  uniform_real_distribution<double> flat(0., 1.);
+  chrono::steady_clock::duration tLocate(0), tStep(0);
+  long long nSteps = 0;
+  for(G4int n = 0; n < nCrossings; n++)
+  {
+    // inside the 7 cm entrance window, up to ~45 degrees off axis like spiralling decay electrons
+    double r = 6.5*cm*sqrt(flat(rng));
+    double phi = 2*M_PI*flat(rng);
+    double cosTheta = 0.7 + 0.3*flat(rng);
+    double sinTheta = sqrt(1 - cosTheta*cosTheta);
+    double psi = 2*M_PI*flat(rng);
+    G4ThreeVector p(r*cos(phi), r*sin(phi), zIn);
+    G4ThreeVector dir(sinTheta*cos(psi), sinTheta*sin(psi), cosTheta);
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    G4VPhysicalVolume* pv = nav.LocateGlobalPointAndSetup(p, &dir, false, false);
+    tLocate += chrono::steady_clock::now() - t0;
+    for(int i = 0; pv != NULL && p.z() < zOut && i < 100000; i++)
+    {
+      double safety;
+      t0 = chrono::steady_clock::now();
+      double step = nav.ComputeStep(p, dir, kInfinity, safety);
+      tStep += chrono::steady_clock::now() - t0;
+      if(step >= kInfinity) break;
+      p += step*dir;
+      nav.SetGeometricallyLimitedStep();
+      t0 = chrono::steady_clock::now();
+      pv = nav.LocateGlobalPointAndSetup(p, &dir, true);
+      tLocate += chrono::steady_clock::now() - t0;
+      nSteps++;
+    }
+  }
+
+  timing.locateTime = chrono::duration<double>(tLocate).count()/nCrossings;
+  timing.stepTime = chrono::duration<double>(tStep).count()/nCrossings;
+  timing.steps = nSteps/(double)nCrossings;
+  char line[256];
+  snprintf(line, sizeof(line), "Navigation (%s wire planes): %d crossings, %.1f steps/crossing, locate %.2f us, step %.2f us per crossing\n",
+	   fDetector->GetParameterisedWires() ? "parameterised" : "replica", nCrossings, timing.steps,
+	   timing.locateTime/1e-6, timing.stepTime/1e-6);
+  G4cout << line;
+  return timing;
+}
+
+G4bool GeometryValidator::RebuildNow()
+{
+  // rebuild immediately instead of at the next BeamOn, so the navigator sees the new volumes.
+  // RebuildGeometry() drops the detector's volume pointers; Construct() sets them again here.
+  fDetector->RebuildGeometry();
+  G4RunManager::GetRunManager()->InitializeGeometry();
+  return World() != NULL;
+}
+
+void GeometryValidator::CompareWirePlanes(G4int nCrossings)
+{
+  if(World() == NULL) return;
+  G4bool original = fDetector->GetParameterisedWires();
+  NavigationTiming timing[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+  for(int mode = 0; mode <= 1; mode++)
+  {
+    fDetector->SetParameterisedWires(mode == 1);
+    if(!RebuildNow()) break;
+    timing[mode] = BenchmarkNavigation(nCrossings);
+  }
+  fDetector->SetParameterisedWires(original);
+  if(!RebuildNow() || timing[0].steps == 0 || timing[1].steps == 0)
+  {
+    G4cout << "GeometryValidator: wire plane comparison incomplete (rebuild or benchmark failed)." << G4endl;
+    return;
+  }
+
+  char line[256];
+  snprintf(line, sizeof(line), "Parameterised/replica per crossing: locate x%.2f, step x%.2f, total x%.2f\n",
+	   timing[1].locateTime/timing[0].locateTime, timing[1].stepTime/timing[0].stepTime,
+	   (timing[1].locateTime + timing[1].stepTime)/(timing[0].locateTime + timing[0].stepTime));
+  G4cout << line;
+}
+
+G4double GeometryValidator::TimeRays(G4VPhysicalVolume* world, G4int nRays) const
+{
+  // voxels are rebuilt with the current settings first
+  G4GeometryManager::GetInstance()->OpenGeometry();
+  G4GeometryManager::GetInstance()->CloseGeometry(true);
+
+  // isotropic rays from points spread through the bundle around the axis, over the full length,
+  // so that no one direction's voxel slicing is favoured
+  G4double halfZ = static_cast<G4Box*>(world->GetLogicalVolume()->GetSolid())->GetZHalfLength();
+  G4Navigator nav;
+  nav.SetWorldVolume(world);
+  double best = 0;
+  for(int repeat = 0; repeat < 3; repeat++)	// fastest of three, to beat scheduler noise
+  {
+    mt19937_64 rng(3);
+    uniform_real_distribution<double> flat(0., 1.);
+    double tStart = SteadySeconds();
+    for(G4int n = 0; n < nRays; n++)
+    {
+      double r = fRadius*sqrt(flat(rng));
+      double phi = 2*M_PI*flat(rng);
+      double cosTheta = 2*flat(rng) - 1;
+      double sinTheta = sqrt(1 - cosTheta*cosTheta);
+      double psi = 2*M_PI*flat(rng);
+      G4ThreeVector p(r*cos(phi), r*sin(phi), (2*flat(rng) - 1)*(halfZ - 1*um));
+      G4ThreeVector dir(sinTheta*cos(psi), sinTheta*sin(psi), cosTheta);
+      G4VPhysicalVolume* pv = nav.LocateGlobalPointAndSetup(p, &dir, false, false);
+      for(int i = 0; pv != NULL && i < 100000; i++)
+      {
+	double safety;
+	double step = nav.ComputeStep(p, dir, kInfinity, safety);
+	if(step >= kInfinity) break;
+	p += step*dir;
+	nav.SetGeometricallyLimitedStep();
+	pv = nav.LocateGlobalPointAndSetup(p, &dir, true);
+      }
+    }
+    double t = SteadySeconds() - tStart;
+    if(repeat == 0 || t < best) best = t;
+  }
+  return best;
+}
+
+void GeometryValidator::TuneVoxels(G4int nRays, const G4String& fileName)
+{
+  TraceScope trace("TuneVoxels", "validate");
+  G4VPhysicalVolume* world = World();
+  if(world == NULL) return;
+  if(dynamic_cast<G4Box*>(world->GetLogicalVolume()->GetSolid()) == NULL)
+  {
+    G4cout << "GeometryValidator: voxel tuning expects a box world." << G4endl;
+    return;
+  }
+
+  vector<G4LogicalVolume*> targets;
+  G4LogicalVolumeStore* lvStore = G4LogicalVolumeStore::GetInstance();
+  for(G4LogicalVolumeStore::iterator it = lvStore->begin(); it != lvStore->end(); it++)
+    if((*it)->GetNoDaughters() >= 3) targets.push_back(*it);
+  sort(targets.begin(), targets.end(), MoreDaughters);	// largest gains first
+
+  // one volume at a time, keeping the best value found for the ones before
+  const G4double candidates[] = { 0., 0.5, 1., 2., 4., 8., 16. };
+  const int nCandidates = sizeof(candidates)/sizeof(candidates[0]);
+  G4double tInitial = TimeRays(world, nRays);
+  G4double tCurrent = tInitial;
+  QFile qOut;
+  for(unsigned int i = 0; i < targets.size(); i++)
+  {
+    G4String name = targets[i]->GetName();
+    G4double current = targets[i]->IsToOptimise() ? targets[i]->GetSmartless() : 0.;
+    G4double best = current;
+    G4double tBest = tCurrent;
+    for(int c = 0; c < nCandidates; c++)
+    {
+      if(candidates[c] == current) continue;
+      fDetector->SetSmartless(name, candidates[c]);
+      G4double t = TimeRays(world, nRays);
+      if(t < 0.99*tBest)	// only move for a clear gain
+      {
+	tBest = t;
+	best = candidates[c];
+      }
+    }
+    fDetector->SetSmartless(name, best);
+    tCurrent = tBest;
+
+    char line[256];
+    snprintf(line, sizeof(line), "  %-40s %4d daughters: smartless %s -> %s, %.2f us/ray\n", name.c_str(),
+	     targets[i]->GetNoDaughters(), current > 0 ? G4UIcommand::ConvertToString(current).c_str() : "off",
+	     best > 0 ? G4UIcommand::ConvertToString(best).c_str() : "off", tBest/nRays/1e-6);
+    G4cout << line;
+
+    Stringmap m;
+    m.insert("volume", name);
+    m.insert("smartless", best);
+    m.insert("daughters", targets[i]->GetNoDaughters());
+    qOut.insert("voxel", m);
+  }
+  G4GeometryManager::GetInstance()->OpenGeometry();
+  G4GeometryManager::GetInstance()->CloseGeometry(true);
+
+  G4cout << "GeometryValidator: tuned " << targets.size() << " volumes, isotropic rays " << tInitial/nRays/1e-6
+	 << " -> " << tCurrent/nRays/1e-6 << " us/ray" << G4endl;
+  if(fileName != "")
+  {
+    qOut.commit(fileName);
+    G4cout << "Wrote voxel settings to " << fileName << G4endl;
+  }
+}
+
+//----------------------------------------------------------------
+
+GeometryValidatorMessenger::GeometryValidatorMessenger(GeometryValidator* V): fValidator(V)
+{
+  fValidateDir = new G4UIdirectory("/ucn/validate/");
+  fValidateDir->SetGuidance("Geometry validation: overlap checks and ray-cast thickness profiles");
+
+  fOverlapsCmd = new G4UIcmdWithAnInteger("/ucn/validate/overlaps", this);
+  fOverlapsCmd->SetGuidance("Overlap-check every placement using this many surface points each");
+  fOverlapsCmd->SetDefaultValue(1000);
+  fOverlapsCmd->SetRange("points>0");
+  fOverlapsCmd->AvailableForStates(G4State_Idle);
+
+  fRaysCmd = new G4UIcmdWithAnInteger("/ucn/validate/rays", this);
+  fRaysCmd->SetGuidance("Cast this many rays along and across the solenoid axis and print the thickness profile");
+  fRaysCmd->SetDefaultValue(1000000);
+  fRaysCmd->SetRange("rays>0");
+  fRaysCmd->AvailableForStates(G4State_Idle);
+
+  fRadiusCmd = new G4UIcmdWithADoubleAndUnit("/ucn/validate/radius", this);
+  fRadiusCmd->SetGuidance("Half-width of the ray bundle around the axis");
+  fRadiusCmd->SetDefaultValue(5.);
+  fRadiusCmd->SetDefaultUnit("cm");
+  fRadiusCmd->SetRange("radius>0");
+  fRadiusCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fToleranceCmd = new G4UIcmdWithADouble("/ucn/validate/tolerance", this);
+  fToleranceCmd->SetGuidance("Relative thickness difference reported by /ucn/validate/compare");
+  fToleranceCmd->SetDefaultValue(1e-3);
+  fToleranceCmd->SetRange("tolerance>0");
+  fToleranceCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fWriteCmd = new G4UIcmdWithAString("/ucn/validate/writeReference", this);
+  fWriteCmd->SetGuidance("Store the current thickness profile as a reference file");
+  fWriteCmd->SetParameterName("file", false);
+  fWriteCmd->AvailableForStates(G4State_Idle);
+
+  fCompareCmd = new G4UIcmdWithAString("/ucn/validate/compare", this);
+  fCompareCmd->SetGuidance("Diff the current thickness profile against a stored reference");
+  fCompareCmd->SetParameterName("file", false);
+  fCompareCmd->AvailableForStates(G4State_Idle);
+
+  fNavBenchCmd = new G4UIcmdWithAnInteger("/ucn/validate/navBench", this);
+  fNavBenchCmd->SetGuidance("Time locate and step calls for straight crossings of the West wirechamber");
+  fNavBenchCmd->SetDefaultValue(100000);
+  fNavBenchCmd->SetRange("crossings>0");
+  fNavBenchCmd->AvailableForStates(G4State_Idle);
+
+  fWirePlanesCmd = new G4UIcmdWithAnInteger("/ucn/validate/compareWirePlanes", this);
+  fWirePlanesCmd->SetGuidance("Run navBench with replicated and with parameterised wire planes");
+  fWirePlanesCmd->SetGuidance("(rebuilds the geometry twice, then restores the current choice)");
+  fWirePlanesCmd->SetDefaultValue(100000);
+  fWirePlanesCmd->SetRange("crossings>0");
+  fWirePlanesCmd->AvailableForStates(G4State_Idle);
+
+  fTuneVoxelsCmd = new G4UIcommand("/ucn/validate/tuneVoxels", this);
+  fTuneVoxelsCmd->SetGuidance("Time isotropic rays for a range of smartless values on each volume with 3+ daughters,");
+  fTuneVoxelsCmd->SetGuidance("keep the fastest and write them for /ucn/geometry/voxelFile");
+  G4UIparameter* raysParam = new G4UIparameter("rays", 'i', true);
+  raysParam->SetDefaultValue("2000");
+  raysParam->SetParameterRange("rays>0");
+  fTuneVoxelsCmd->SetParameter(raysParam);
+  G4UIparameter* fileParam = new G4UIparameter("file", 's', true);
+  fileParam->SetDefaultValue("VoxelSettings.txt");
+  fTuneVoxelsCmd->SetParameter(fileParam);
+  fTuneVoxelsCmd->AvailableForStates(G4State_Idle);
+}
+
+GeometryValidatorMessenger::~GeometryValidatorMessenger()
+{
+  delete fOverlapsCmd;
+  delete fRaysCmd;
+  delete fRadiusCmd;
+  delete fToleranceCmd;
+  delete fWriteCmd;
+  delete fCompareCmd;
+  delete fNavBenchCmd;
+  delete fWirePlanesCmd;
+  delete fTuneVoxelsCmd;
+  delete fValidateDir;
+}
+
+void GeometryValidatorMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fOverlapsCmd)
+    fValidator->CheckOverlaps(fOverlapsCmd->GetNewIntValue(newValue));
+  else if(command == fRaysCmd)
+    fValidator->CastRays(fRaysCmd->GetNewIntValue(newValue));
+  else if(command == fRadiusCmd)
+    fValidator->SetRadius(fRadiusCmd->GetNewDoubleValue(newValue));
+  else if(command == fToleranceCmd)
+    fValidator->SetTolerance(fToleranceCmd->GetNewDoubleValue(newValue));
+  else if(command == fWriteCmd)
+    fValidator->WriteProfile(newValue);
+  else if(command == fCompareCmd)
+    fValidator->CompareToReference(newValue);
+  else if(command == fNavBenchCmd)
+    fValidator->BenchmarkNavigation(fNavBenchCmd->GetNewIntValue(newValue));
+  else if(command == fWirePlanesCmd)
+    fValidator->CompareWirePlanes(fWirePlanesCmd->GetNewIntValue(newValue));
+  else if(command == fTuneVoxelsCmd)
+  {
+    G4int nRays;
+    G4String fileName;
+    istringstream(newValue) >> nRays >> fileName;
+    fValidator->TuneVoxels(nRays, fileName);
+  }
+}
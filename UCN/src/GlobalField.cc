@@ -50,6 +50,17 @@ void GlobalField::AddPoint(G4double zPositions, G4double BValues)
   Bpoints.push_back(BValues);
 }
 
+G4bool GlobalField::UniformSection(G4double z, G4double& zMin, G4double& zMax, G4double& Bz) const
+{
+  // same section lookup as GetFieldValue
+  unsigned int zindex = int(lower_bound(Zpoints.begin(), Zpoints.end(), z)-Zpoints.begin());
+  if((zindex==0) || (zindex>=Zpoints.size()) || (Bpoints[zindex-1] != Bpoints[zindex])) return false;
+  zMin = Zpoints[zindex-1];
+  zMax = Zpoints[zindex];
+  Bz = Bpoints[zindex]*fFieldScale;
+  return true;
+}
+
 void GlobalField::GetFieldValue(const G4double Point[3], G4double *Bfield) const
 {
   G4double z = Point[2]; // point z
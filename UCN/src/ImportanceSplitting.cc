@@ -0,0 +1,139 @@
+#include "ImportanceSplitting.hh"
+#include "DetectorConstruction.hh"
+
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4DynamicParticle.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4SystemOfUnits.hh"
+
+using   namespace       std;
+
+ImportanceSplitting* ImportanceSplitting::Instance()
+{
+  static ImportanceSplitting* theSplitting = new ImportanceSplitting();	// never deleted, like RunTracer
+  return theSplitting;
+}
+
+ImportanceSplitting::ImportanceSplitting()
+: fSplitFactor(1), fMinEnergy(10*keV), fAtMWPC(true), fAtScint(true)
+{
+  fMessenger = new ImportanceSplittingMessenger(this);
+}
+
+void ImportanceSplitting::SetSplitVolumes(const G4String& where)
+{
+  fAtMWPC = (where == "mwpc" || where == "both");
+  fAtScint = (where == "scint" || where == "both");
+}
+
+G4bool ImportanceSplitting::IsSplitPoint(const G4Step* step, const DetectorConstruction* detector) const
+{
+  const G4StepPoint* pre = step->GetPreStepPoint();
+  const G4StepPoint* post = step->GetPostStepPoint();
+  if(post->GetStepStatus() != fGeomBoundary || post->GetPhysicalVolume() == NULL || pre->GetPhysicalVolume() == NULL) return false;
+  const G4Track* track = step->GetTrack();
+  if(track->GetDefinition()->GetPDGEncoding() != 11 || track->GetKineticEnergy() < fMinEnergy) return false;
+  if(track->GetUserInformation() != NULL) return false;	// already on a branch
+
+  // backscatter: leaving a detector container (not into one of its daughters) heading back towards
+  // the decay trap at the centre, i.e. on the way to the other detector
+  if(post->GetPosition().z()*post->GetMomentumDirection().z() >= 0) return false;
+  G4LogicalVolume* left = pre->GetPhysicalVolume()->GetLogicalVolume();
+  if(left->IsDaughter(post->GetPhysicalVolume())) return false;
+  for(int i = 0; i <= 1; i++)
+  {
+    if(fAtMWPC && left == detector->mwpc_container_log[i]) return true;
+    if(fAtScint && left == detector->scint_container_log[i]) return true;
+  }
+  return false;
+}
+
+void ImportanceSplitting::Split(const G4Step* step) const
+{
+  G4Track* track = step->GetTrack();
+  G4double weight = track->GetWeight()/fSplitFactor;
+  track->SetWeight(weight);
+  track->SetUserInformation(new BranchInfo(0));
+
+  // the copies go out with this step's secondaries and are stacked like them
+  G4TrackVector* secondaries = const_cast<G4Step*>(step)->GetfSecondary();
+  for(int b = 1; b < fSplitFactor; b++)
+  {
+    G4Track* copy = new G4Track(new G4DynamicParticle(*track->GetDynamicParticle()), track->GetGlobalTime(), track->GetPosition());
+    copy->SetTouchableHandle(step->GetPostStepPoint()->GetTouchableHandle());
+    copy->SetParentID(track->GetParentID());	// a twin of the track, not its secondary: same field accuracy tier etc.
+    copy->SetWeight(weight);
+    copy->SetUserInformation(new BranchInfo(b));
+    secondaries->push_back(copy);
+  }
+}
+
+void ImportanceSplitting::PropagateBranch(const G4Step* step)
+{
+  const BranchInfo* info = static_cast<const BranchInfo*>(step->GetTrack()->GetUserInformation());
+  if(info == NULL) return;
+  const vector<const G4Track*>* secondaries = step->GetSecondaryInCurrentStep();
+  for(unsigned int i = 0; i < secondaries->size(); i++)
+  {
+    G4Track* secondary = const_cast<G4Track*>((*secondaries)[i]);
+    if(secondary->GetUserInformation() == NULL) secondary->SetUserInformation(new BranchInfo(info->GetBranch()));
+  }
+}
+
+//----------------------------------------------------------------
+
+ImportanceSplittingMessenger::ImportanceSplittingMessenger(ImportanceSplitting* S): fSplitting(S)
+{
+  fBiasDir = new G4UIdirectory("/ucn/bias/");
+  fBiasDir->SetGuidance("Importance splitting for backscatter studies (output rows carry weights)");
+
+  fSplitCmd = new G4UIcmdWithAnInteger("/ucn/bias/split", this);
+  fSplitCmd->SetGuidance("Split the first electron per event backscattering out of a detector (leaving it towards");
+  fSplitCmd->SetGuidance("the decay trap) into N weighted copies (1: off)");
+  fSplitCmd->SetDefaultValue(1);
+  fSplitCmd->SetRange("N>=1");
+  fSplitCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fMinEnergyCmd = new G4UIcmdWithADoubleAndUnit("/ucn/bias/minEnergy", this);
+  fMinEnergyCmd->SetGuidance("Electrons below this kinetic energy are not split");
+  fMinEnergyCmd->SetDefaultValue(10.);
+  fMinEnergyCmd->SetDefaultUnit("keV");
+  fMinEnergyCmd->SetRange("minEnergy>=0");
+  fMinEnergyCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fVolumesCmd = new G4UIcmdWithAString("/ucn/bias/splitAt", this);
+  fVolumesCmd->SetGuidance("Split on backscattering out of the MWPCs, the scintillators, or both");
+  fVolumesCmd->SetCandidates("mwpc scint both");
+  fVolumesCmd->SetDefaultValue("both");
+  fVolumesCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+ImportanceSplittingMessenger::~ImportanceSplittingMessenger()
+{
+  delete fSplitCmd;
+  delete fMinEnergyCmd;
+  delete fVolumesCmd;
+  delete fBiasDir;
+}
+
+void ImportanceSplittingMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fSplitCmd)
+  {
+    fSplitting->SetSplitFactor(fSplitCmd->GetNewIntValue(newValue));
+  }
+  else if(command == fMinEnergyCmd)
+  {
+    fSplitting->SetMinEnergy(fMinEnergyCmd->GetNewDoubleValue(newValue));
+  }
+  else if(command == fVolumesCmd)
+  {
+    fSplitting->SetSplitVolumes(newValue);
+  }
+}
@@ -24,14 +24,22 @@
 #include "G4PhysicalConstants.hh"
 #include "G4SystemOfUnits.hh"
 
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+static const G4double kBTableHalfLength = 10*cm;	// covers the whole MWPC container
+static const int kBTableNodes = 2001;			// 0.1 mm spacing
+
 MWPCField::MWPCField()
- : fE0(0), fSqOfMaxRadius((20*cm)*(20*cm)), fFieldScale(1.0)
+ : fE0(0), fSqOfMaxRadius((20*cm)*(20*cm)), fFieldScale(1.0), fUseBTable(true), fTableZ0(0), fTableStep(0)
 {
   G4cout << "Creating MWPC electromagnetic field objects." << G4endl;
   fChamberRot = NULL;	// initialize some class members
   fChamberTrans = G4ThreeVector(0,0,0);
 
   LoadFieldMap();
+  BuildBTable();
 }
 
 void MWPCField::LoadFieldMap()
@@ -60,7 +68,57 @@ void MWPCField::SetPotential(G4double Vanode)
   G4cout << "Wirechamber voltage set to " << Vanode/volt <<" V => fE0 = " << fE0/(volt/cm) << " V/cm" << G4endl;
 }
 
+void MWPCField::ProfileBz(G4double z, G4double& Bz, G4double& dBzdz) const
+{
+  // unscaled B_z of the profile and its derivative, same interpolation as ProfileB
+  unsigned int zindex = int(lower_bound(Zpoints.begin(), Zpoints.end(), z)-Zpoints.begin());
+  Bz = dBzdz = 0;
+  if((zindex==0) || (zindex>=Zpoints.size())) return;
+  G4double base = 0.5*(Bpoints[zindex-1]+Bpoints[zindex]);
+  G4double amp = 0.5*(Bpoints[zindex-1]-Bpoints[zindex]);
+  G4double dz = Zpoints[zindex]-Zpoints[zindex-1];
+  G4double l = (z-Zpoints[zindex-1])/dz;
+  Bz = base + amp*cos(l*M_PI);
+  dBzdz = -amp*M_PI*sin(l*M_PI)/dz;
+}
+
+void MWPCField::BuildBTable()
+{
+  // the chamber sits where the profile has just levelled off, so B is nearly constant
+  // over it; a fine table with exact derivatives reproduces it to well below 1e-6 T
+  fTableZ0 = fChamberTrans.z() - kBTableHalfLength;
+  fTableStep = 2*kBTableHalfLength/(kBTableNodes - 1);
+  fTableBz.resize(kBTableNodes);
+  fTableDBz.resize(kBTableNodes);
+  for(int i = 0; i < kBTableNodes; i++)
+    ProfileBz(fTableZ0 + i*fTableStep, fTableBz[i], fTableDBz[i]);
+}
+
 void MWPCField::GetFieldValue(const G4double Point[4], G4double *Bfield) const
+{
+  G4double u = (Point[2] - fTableZ0)/fTableStep;
+  int i = int(u);
+  if(!fUseBTable || u < 0 || i >= kBTableNodes - 1 || Point[0]*Point[0]+Point[1]*Point[1] > fSqOfMaxRadius)
+  {
+    ProfileB(Point, Bfield);	// outside the table (or the field radius) use the profile
+  }
+  else
+  {
+    // cubic Hermite interpolation of B_z; B_r = -r/2 dB_z/dz from the same cubic
+    G4double t = u - i;
+    G4double t2 = t*t, t3 = t2*t;
+    G4double p0 = fTableBz[i], p1 = fTableBz[i+1];
+    G4double m0 = fTableDBz[i]*fTableStep, m1 = fTableDBz[i+1]*fTableStep;
+    G4double Bz = (2*t3-3*t2+1)*p0 + (t3-2*t2+t)*m0 + (-2*t3+3*t2)*p1 + (t3-t2)*m1;
+    G4double dBzdz = ((6*t2-6*t)*(p0-p1) + (3*t2-4*t+1)*m0 + (3*t2-2*t)*m1)/fTableStep;
+    Bfield[0] = -0.5*Point[0]*dBzdz*fFieldScale;
+    Bfield[1] = -0.5*Point[1]*dBzdz*fFieldScale;
+    Bfield[2] = Bz*fFieldScale;
+  }
+  ElectricField(Point, Bfield);
+}
+
+void MWPCField::ProfileB(const G4double Point[4], G4double *Bfield) const
 {
   // magnetic field components computed below. Same code as in the GlobalField GetFieldValue(...)
   G4double z = Point[2]; // point z
@@ -96,7 +154,10 @@ void MWPCField::GetFieldValue(const G4double Point[4], G4double *Bfield) const
       Bfield[1] = 0.0;
     }
   }
+}
 
+void MWPCField::ElectricField(const G4double Point[4], G4double *Bfield) const
+{
   if(!fE0)	// if no electric potential, then set the E-field parts to 0 and leave
   {
     Bfield[3] = 0;
@@ -137,6 +198,56 @@ void MWPCField::GetFieldValue(const G4double Point[4], G4double *Bfield) const
 
 }
 
+void MWPCField::CheckBTable(G4int nPoints)
+{
+  std::mt19937_64 rng(5);
+  std::uniform_real_distribution<double> flat(-1., 1.);
+  std::vector<G4double> points(4*nPoints);
+  for(int n = 0; n < nPoints; n++)	// inside the chamber gas, around the active region
+  {
+    points[4*n] = 6*cm*flat(rng);
+    points[4*n+1] = 6*cm*flat(rng);
+    points[4*n+2] = fChamberTrans.z() + 3*cm*flat(rng);
+    points[4*n+3] = 0;
+  }
 
+  G4bool useTable = fUseBTable;
+  G4double maxDev = 0, maxB = 0;
+  for(int n = 0; n < nPoints; n++)
+  {
+    G4double tabulated[6], profile[6];
+    fUseBTable = true;
+    GetFieldValue(&points[4*n], tabulated);
+    fUseBTable = false;
+    GetFieldValue(&points[4*n], profile);
+    G4double dB2 = 0;
+    for(int k = 0; k < 3; k++) dB2 += (tabulated[k]-profile[k])*(tabulated[k]-profile[k]);
+    maxDev = std::max(maxDev, sqrt(dB2));
+    maxB = std::max(maxB, fabs(profile[2]));
+  }
 
-
+  G4double timing[3];	// profile, table, E only
+  volatile G4double sink = 0;	// keeps the timed calls from being optimised away
+  for(int mode = 0; mode < 3; mode++)
+  {
+    fUseBTable = (mode == 1);
+    G4double value[6];
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for(int n = 0; n < nPoints; n++)
+    {
+      if(mode == 2) ElectricField(&points[4*n], value);
+      else GetFieldValue(&points[4*n], value);
+      sink = sink + value[5];
+    }
+    timing[mode] = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count()/nPoints;
+  }
+  fUseBTable = useTable;
+
+  char line[256];
+  snprintf(line, sizeof(line), "MWPC field at z = %.4f m: max |B table - B profile| = %.3g T (|B| %.4f T) at %d points\n",
+	   fChamberTrans.z()/m, maxDev/tesla, maxB/tesla, nPoints);
+  G4cout << line;
+  snprintf(line, sizeof(line), "  per call: profile B + E %.1f ns, table B + E %.1f ns, E alone %.1f ns\n",
+	   timing[0]/1e-9, timing[1]/1e-9, timing[2]/1e-9);
+  G4cout << line;
+}
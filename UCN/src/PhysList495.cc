@@ -1,4 +1,5 @@
 #include "PhysList495.hh"
+#include "RunTracer.hh"
 
 #include <cassert>
 
@@ -47,11 +48,13 @@ void PhysList495::setPhysicsList(const G4String& plname) {
 
 // Construct Particles /////////////////////////////////////////////////////
 void PhysList495::ConstructParticle() {
+	TraceScope trace("ConstructParticle");
 	assert(emPhysicsList);
 	emPhysicsList->ConstructParticle();
 }
 
 void PhysList495::ConstructProcess() {
+	TraceScope trace("ConstructProcess");
 	assert(emPhysicsList);
 	// transportation process
 	AddTransportation();
@@ -60,6 +63,7 @@ void PhysList495::ConstructProcess() {
 }
 
 void PhysList495::SetCuts() {
+	TraceScope trace("SetCuts");
 	if (verboseLevel >0) {
 		G4cout << "PhysicsList::SetCuts:";
 		G4cout << "CutLength : " << G4BestUnit(defaultCutValue,"Length") << G4endl;
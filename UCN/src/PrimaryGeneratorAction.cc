@@ -1,8 +1,10 @@
 #include "PrimaryGeneratorAction.hh"
+#include "RunAction.hh"
 #include "BetaSpectrum.hh"
 #include "Enums.hh"
 #include "PathUtils.hh"
 #include "SMExcept.hh"
+#include "SamplingKernels.hh"
 
 #include "G4LogicalVolumeStore.hh"
 #include "G4LogicalVolume.hh"
@@ -11,65 +13,141 @@
 #include "G4ParticleGun.hh"
 #include "G4ParticleTable.hh"
 #include "G4ParticleDefinition.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
 #include "G4SystemOfUnits.hh"
 #include "Randomize.hh"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <math.h>
 #include <cmath>
 using   namespace       std;
 
-#define	OUTPUT_FILE	"FinalSim_EnergyOutput.txt"
+#define	OUTPUT_FILE	(RunAction::GetOutputFileName().c_str())	// set per sweep point by SweepDriver
 
 PrimaryGeneratorAction::PrimaryGeneratorAction(DetectorConstruction* myDC)
 : G4VUserPrimaryGeneratorAction(),
   fParticleGun(0),
   fMyDetector(myDC),
-  fSourceRadius(3.*mm)
+  fSourceRadius(3.*mm),
+  fEventFile(NULL)
 {
   G4int n_particle = 1;
   fParticleGun  = new G4ParticleGun(n_particle);
+  fMessenger = new PrimaryGeneratorActionMessenger(this);
 }
 
 
 PrimaryGeneratorAction::~PrimaryGeneratorAction()
 {
+  delete fMessenger;
+  delete fEventFile;
   delete fParticleGun;
 }
 
+void PrimaryGeneratorAction::SetEventFile(const G4String& fileName)
+{
+  delete fEventFile;
+  fEventFile = NULL;
+  if(fileName == "none") return;
+  try
+  {
+    fEventFile = new CompactEventFile(fileName);
+  }
+  catch(SMExcept& e)
+  {
+    G4cout << "PrimaryGeneratorAction: cannot read event file " << fileName << "; " << e.what() << G4endl;
+    return;
+  }
+  G4cout << "PrimaryGeneratorAction: " << fEventFile->getNEvents() << " events (" << fEventFile->getNPrimaries()
+	 << " primaries) from " << fileName << G4endl;
+  fEventFile->getMeta().display("  ");
+}
+
 
 void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
 {
 
-  Set_113SnSource();	// Set all variables for an isotropic 113Sn source run
+  if(fEventFile)
+    LoadFileEvent();
+  else
+    Set_113SnSource();	// Set all variables for an isotropic 113Sn source run
 
 //  DisplayGunStatus();
 
-  ofstream outfile;
-  outfile.open(OUTPUT_FILE, ios::app);
-  outfile << fParticleGun -> GetParticleDefinition() -> GetParticleName() << "\t"
+  // primary columns of the output row; EventAction repeats them for split-event branch rows.
+  // The "cm /t" separators are the established format that the analysis scripts parse.
+  ostringstream prefix;
+  prefix << fParticleGun -> GetParticleDefinition() -> GetParticleName() << "\t"
 	<< fParticleGun -> GetParticleMomentumDirection().x() << "\t"
         << fParticleGun -> GetParticleMomentumDirection().y() << "\t"
         << fParticleGun -> GetParticleMomentumDirection().z() << "\t"
 	<< fParticleGun -> GetParticlePosition().x()/cm << "cm /t"
         << fParticleGun -> GetParticlePosition().y()/cm << "cm /t"
         << fParticleGun -> GetParticlePosition().z()/cm << "cm /t";
+  fRowPrefix = prefix.str();
+
+  ofstream outfile;
+  outfile.open(OUTPUT_FILE, ios::app);
+  outfile << fRowPrefix;
   outfile.close();
 
-  fParticleGun->GeneratePrimaryVertex(anEvent);
+  if(fEventFile)
+    AddFilePrimaries(anEvent);
+  else
+    fParticleGun->GeneratePrimaryVertex(anEvent);
 }
 
-void PrimaryGeneratorAction::DiskRandom(G4double radius, G4double& x, G4double& y)
+void PrimaryGeneratorAction::LoadFileEvent()
 {
-  while(true)
+  G4bool firstPass = fEventFile->firstpass;
+  fFileEvent.clear();
+  fEventFile->loadEvt(fFileEvent);
+  if(firstPass && !fEventFile->firstpass)
+    G4cout << "PrimaryGeneratorAction: end of event file reached, starting over." << G4endl;
+
+  // the gun only describes the first primary, for the output line
+  if(fFileEvent.empty()) return;
+  const NucDecayEvent& first = fFileEvent[0];
+  G4ParticleDefinition* particle = G4ParticleTable::GetParticleTable()->FindParticle(first.d);
+  if(particle) fParticleGun->SetParticleDefinition(particle);
+  fParticleGun->SetParticleEnergy(first.E*keV);
+  fParticleGun->SetParticleMomentumDirection(G4ThreeVector(first.p[0], first.p[1], first.p[2]));
+  fParticleGun->SetParticlePosition(G4ThreeVector(first.x[0], first.x[1], first.x[2])*m + fMyDetector->GetSourcePosition());
+}
+
+void PrimaryGeneratorAction::AddFilePrimaries(G4Event* anEvent)
+{
+  G4ParticleTable* particleTable = G4ParticleTable::GetParticleTable();
+  for(unsigned int i = 0; i < fFileEvent.size(); i++)
   {
-    x = (2.0*G4UniformRand()-1.)*radius;
-    y = (2.0*G4UniformRand()-1.)*radius;
-    if(x*x+y*y<=radius*radius) break;
+    const NucDecayEvent& e = fFileEvent[i];
+    G4ParticleDefinition* particle = particleTable->FindParticle(e.d);
+    if(e.d == D_NEUTRINO || particle == NULL) continue;	// neutrinos leave without a trace
+    G4ThreeVector position = G4ThreeVector(e.x[0], e.x[1], e.x[2])*m + fMyDetector->GetSourcePosition();
+    G4PrimaryVertex* vertex = new G4PrimaryVertex(position, e.t*s);
+    G4PrimaryParticle* primary = new G4PrimaryParticle(particle);
+    primary->SetKineticEnergy(e.E*keV);
+    primary->SetMomentumDirection(G4ThreeVector(e.p[0], e.p[1], e.p[2]));
+    primary->SetWeight(e.w);
+    vertex->SetPrimary(primary);
+    anEvent->AddPrimaryVertex(vertex);
   }
 }
 
+void PrimaryGeneratorAction::DiskRandom(G4double radius, G4double& x, G4double& y)
+{
+  // rejection-free: fixed two random numbers per call
+  G4double u[2];
+  u[0] = G4UniformRand();
+  u[1] = G4UniformRand();
+  uniformDisk(1, u, u+1, radius, &x, &y);
+}
+
 void PrimaryGeneratorAction::DisplayGunStatus()
 {
   G4cout
@@ -134,20 +212,11 @@ void PrimaryGeneratorAction::Set_113SnSource()	// don't need additional argument
   fParticleGun->SetParticleTime(0.0*ns);        // Michael's has this line. Idk why.
 
   //----- Setting isotropic particle momentum direction
-  G4double alphaMin = 0*deg;    // alpha is apex angle
-  G4double alphaMax = 180*deg;  // 180* ensures cone -> full sphere
-  G4double cosAlphaMin = cos(alphaMin);
-  G4double cosAlphaMax = cos(alphaMax);
-  G4double phiMin = 0*deg;      // phi in 0 to 2pi
-  G4double phiMax = 360.*deg;   // Presumably the rotation angle. 2pi makes it a cone.
-
-  G4double cosAlpha = cosAlphaMin-G4UniformRand()*(cosAlphaMin-cosAlphaMax);
-  G4double sinAlpha = sqrt(1. - cosAlpha*cosAlpha);
-  G4double phi = phiMin + G4UniformRand()*(phiMax - phiMin);
-
-  G4double ux = sinAlpha*cos(phi);
-  G4double uy = sinAlpha*sin(phi);
-  G4double uz = cosAlpha;
+  G4double u[2];
+  u[0] = 1. - G4UniformRand();  // cos(alpha) = 1 - 2*rand, as for the full 0-180 deg cone
+  u[1] = G4UniformRand();       // phi in 0 to 2pi
+  G4double ux, uy, uz;
+  isotropicDirections(1, u, u+1, &ux, &uy, &uz);
   fParticleGun->SetParticleMomentumDirection(G4ThreeVector(ux,uy,uz));
 
 /*  G4ThreeVector newUz;        // fires isotropic cone where cone axis can be rotated.
@@ -182,6 +251,34 @@ void PrimaryGeneratorAction::Set_113SnSource()	// don't need additional argument
     DiskRandom(fSourceRadius, x0, y0);
   }
 
-  fParticleGun->SetParticlePosition(G4ThreeVector(x0,y0,z0));
+  fParticleGun->SetParticlePosition(G4ThreeVector(x0,y0,z0) + fMyDetector->GetSourcePosition());	// follows /ucn/geometry/sourcePosition
+
+}
+
+//----------------------------------------------------------------
+
+PrimaryGeneratorActionMessenger::PrimaryGeneratorActionMessenger(PrimaryGeneratorAction* P): fGenerator(P)
+{
+  fGunDir = new G4UIdirectory("/ucn/gun/");
+  fGunDir->SetGuidance("Primary particle source");
 
+  fEventFileCmd = new G4UIcmdWithAString("/ucn/gun/eventFile", this);
+  fEventFileCmd->SetGuidance("Fire the events of a compact event file (from MC_EventGen) instead of the 113Sn source;");
+  fEventFileCmd->SetGuidance("'none' returns to the 113Sn source");
+  fEventFileCmd->SetParameterName("eventFile", false);
+  fEventFileCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+PrimaryGeneratorActionMessenger::~PrimaryGeneratorActionMessenger()
+{
+  delete fEventFileCmd;
+  delete fGunDir;
+}
+
+void PrimaryGeneratorActionMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fEventFileCmd)
+  {
+    fGenerator->SetEventFile(newValue);
+  }
 }
@@ -0,0 +1,185 @@
+#include "ProgressMonitor.hh"
+
+#include "G4Threading.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <fstream>
+#include <unistd.h>
+#include <sys/resource.h>
+using   namespace       std;
+
+namespace
+{
+  double SteadySeconds()
+  {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // resident and peak resident memory [MB]
+  void MemoryUsage(double& rss, double& peak)
+  {
+    rss = peak = 0;
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if(f)
+    {
+      if(fscanf(f, "%ld %ld", &pages, &resident) == 2) rss = resident*(double)sysconf(_SC_PAGESIZE)/(1024.*1024.);
+      fclose(f);
+    }
+    struct rusage usage;
+    if(!getrusage(RUSAGE_SELF, &usage)) peak = usage.ru_maxrss/1024.;	// ru_maxrss is in kB on Linux
+  }
+}
+
+ProgressMonitor* ProgressMonitor::Instance()
+{
+  static ProgressMonitor* theMonitor = new ProgressMonitor();	// never deleted, like RunTracer
+  return theMonitor;
+}
+
+ProgressMonitor::ProgressMonitor()
+: fEnabled(true), fInterval(10.), fFileName("FinalSim_Progress.json"), fEventsToProcess(0), fRunStart(SteadySeconds()),
+  fEvents(0), fSteps(0), fNextReport(0)
+{
+  for(int i = 0; i < kMaxThreads; i++) fThreadEvents[i] = 0;
+  fMessenger = new ProgressMonitorMessenger(this);
+}
+
+double ProgressMonitor::Elapsed() const
+{
+  return SteadySeconds() - fRunStart;
+}
+
+void ProgressMonitor::BeginRun(G4int nEvents)
+{
+  fEventsToProcess = nEvents;
+  fRunStart = SteadySeconds();
+  fEvents = 0;
+  fSteps = 0;
+  for(int i = 0; i < kMaxThreads; i++) fThreadEvents[i] = 0;
+  fNextReport = (long long)(fInterval*1000);
+}
+
+void ProgressMonitor::EventDone(G4long nSteps)
+{
+  fEvents.fetch_add(1, memory_order_relaxed);
+  fSteps.fetch_add(nSteps, memory_order_relaxed);
+  int slot = G4Threading::G4GetThreadId();
+  if(slot < 0) slot = 0;
+  if(slot >= kMaxThreads) slot = kMaxThreads-1;
+  fThreadEvents[slot].fetch_add(1, memory_order_relaxed);
+
+  if(!fEnabled) return;
+  long long now = (long long)(Elapsed()*1000);
+  long long next = fNextReport.load(memory_order_relaxed);
+  if(now < next) return;
+  // only the thread that moves the report time forward prints this report
+  if(fNextReport.compare_exchange_strong(next, now + (long long)(fInterval*1000)))
+    Report(false);
+}
+
+void ProgressMonitor::EndRun()
+{
+  if(fEnabled) Report(true);
+}
+
+void ProgressMonitor::Report(G4bool final)
+{
+  double elapsed = Elapsed();
+  long long nEvents = fEvents.load();
+  long long nSteps = fSteps.load();
+  double rate = elapsed > 0 ? nEvents/elapsed : 0;
+  double eta = (rate > 0 && fEventsToProcess > nEvents) ? (fEventsToProcess - nEvents)/rate : 0;
+  double stepsPerEvent = nEvents ? nSteps/(double)nEvents : 0;
+  double rss, peak;
+  MemoryUsage(rss, peak);
+
+  // one formatted write so concurrent output cannot interleave mid-line
+  char line[256];
+  snprintf(line, sizeof(line), "%s %lld/%d events (%.1f%%), %.1f evt/s, ETA %.0f s, %.1f steps/evt, RSS %.0f MB (peak %.0f MB)\n",
+	   final ? "Run complete:" : "Progress:", nEvents, fEventsToProcess,
+	   fEventsToProcess ? 100.*nEvents/fEventsToProcess : 0., rate, eta, stepsPerEvent, rss, peak);
+  fputs(line, stdout);
+  fflush(stdout);
+
+  if(fFileName == "") return;
+
+  ostringstream json;
+  json << "{\"final\": " << (final ? "true" : "false") << ", \"events\": " << nEvents
+       << ", \"total\": " << fEventsToProcess << ", \"elapsed_s\": " << elapsed << ", \"events_per_s\": " << rate
+       << ", \"eta_s\": " << eta << ", \"steps_per_event\": " << stepsPerEvent
+       << ", \"rss_mb\": " << rss << ", \"peak_rss_mb\": " << peak << ", \"thread_events\": [";
+  int nThreads = 0;
+  for(int i = 0; i < kMaxThreads; i++)
+  {
+    long long n = fThreadEvents[i].load(memory_order_relaxed);
+    if(!n) continue;
+    if(nThreads++) json << ", ";
+    json << "{\"thread\": " << i << ", \"events\": " << n << "}";
+  }
+  json << "]}\n";
+
+  // write a temporary file and rename it over the old one, so pollers never see a partial file
+  string tmpName = fFileName + ".tmp";
+  ofstream outfile(tmpName.c_str());
+  outfile << json.str();
+  outfile.close();
+  rename(tmpName.c_str(), fFileName.c_str());
+}
+
+//----------------------------------------------------------------
+
+ProgressMonitorMessenger::ProgressMonitorMessenger(ProgressMonitor* M): fMonitor(M)
+{
+  fProgressDir = new G4UIdirectory("/ucn/progress/");
+  fProgressDir->SetGuidance("Throughput and ETA reporting");
+
+  fEnableCmd = new G4UIcmdWithABool("/ucn/progress/enable", this);
+  fEnableCmd->SetGuidance("Enable periodic progress reports");
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fIntervalCmd = new G4UIcmdWithADoubleAndUnit("/ucn/progress/interval", this);
+  fIntervalCmd->SetGuidance("Time between progress reports");
+  fIntervalCmd->SetDefaultValue(10.);
+  fIntervalCmd->SetUnitCategory("Time");
+  fIntervalCmd->SetDefaultUnit("s");
+  fIntervalCmd->SetRange("interval>0");
+  fIntervalCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fFileCmd = new G4UIcmdWithAString("/ucn/progress/file", this);
+  fFileCmd->SetGuidance("Machine-readable progress file (JSON), \"none\" to disable");
+  fFileCmd->SetDefaultValue("FinalSim_Progress.json");
+  fFileCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+ProgressMonitorMessenger::~ProgressMonitorMessenger()
+{
+  delete fEnableCmd;
+  delete fIntervalCmd;
+  delete fFileCmd;
+  delete fProgressDir;
+}
+
+void ProgressMonitorMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fEnableCmd)
+  {
+    fMonitor->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));
+  }
+  else if(command == fIntervalCmd)
+  {
+    fMonitor->SetInterval(fIntervalCmd->GetNewDoubleValue(newValue)/s);
+  }
+  else if(command == fFileCmd)
+  {
+    fMonitor->SetFileName(newValue == "none" ? G4String("") : newValue);
+  }
+}
@@ -1,6 +1,11 @@
 #include "RunAction.hh"
 #include "PrimaryGeneratorAction.hh"
 #include "DetectorConstruction.hh"
+#include "RunTracer.hh"
+#include "ProgressMonitor.hh"
+#include "EventTermination.hh"
+#include "StackingAction.hh"
+#include "ImportanceSplitting.hh"
 
 #include "G4Run.hh"
 #include "G4RunManager.hh"
@@ -15,7 +20,9 @@
 #include <cmath>
 using   namespace       std;
 
-#define	OUTPUT_FILE	"FinalSim_EnergyOutput.txt"
+#define	OUTPUT_FILE	(RunAction::GetOutputFileName().c_str())	// set per sweep point by SweepDriver
+
+G4String RunAction::fOutputFileName = "FinalSim_EnergyOutput.txt";
 
 RunAction::RunAction()
 : G4UserRunAction()
@@ -27,11 +34,21 @@ RunAction::~RunAction()
 
 void RunAction::BeginOfRunAction(const G4Run* run)
 {
+  if(RunTracer::IsEnabled()) RunTracer::Instance()->AttachToThread();	// worker threads follow their own states
+
   ofstream outfile;
   outfile.open(OUTPUT_FILE, ios::app);
-  outfile << "Particle species \t Momentum Direction: x \t y \t z \t Initial placement: x \t y \t z \t Energy Deposited (keV): East Scint \t East MWPC \t West Scint \t West MWPC \n";
+  outfile << "Particle species \t Momentum Direction: x \t y \t z \t Initial placement: x \t y \t z \t Energy Deposited (keV): East Scint \t East MWPC \t West Scint \t West MWPC";
+  if(ImportanceSplitting::Instance()->IsEnabled()) outfile << " \t Weight";	// EventAction writes it only then
+  outfile << " \n";
   outfile.close();
 
+  if(IsMaster())
+  {
+    ProgressMonitor::Instance()->BeginRun(run->GetNumberOfEventToBeProcessed());
+    EventTermination::Instance()->BeginRun();
+  }
+
   //inform the runManager to save random number seed
   G4RunManager::GetRunManager()->SetRandomNumberStore(false);
 }
@@ -43,6 +60,10 @@ void RunAction::EndOfRunAction(const G4Run* run)
   if (nofEvents == 0) return;
 
   if (IsMaster()) {
+    ProgressMonitor::Instance()->EndRun();
+    EventTermination::Instance()->EndRun();
+    const StackingAction* stacking = static_cast<const StackingAction*>(G4RunManager::GetRunManager()->GetUserStackingAction());
+    if(stacking && stacking->IsActive()) stacking->Report();
     G4cout
      << G4endl
      << "--------------------End of Global Run-----------------------";
@@ -53,6 +74,7 @@ void RunAction::EndOfRunAction(const G4Run* run)
      << "--------------------End of Local Run------------------------";
   }
 
+  TraceScope trace("EndOfRunOutput", "output");
   ofstream outfile;
   outfile.open(OUTPUT_FILE, ios::app);
   outfile << "Total number of simulated events during this run: " << run -> GetNumberOfEvent() << "\n";
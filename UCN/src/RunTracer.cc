@@ -0,0 +1,227 @@
+#include "RunTracer.hh"
+
+#include "G4AutoLock.hh"
+#include "G4StateManager.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4ios.hh"
+
+#include <chrono>
+#include <fstream>
+#include <unistd.h>
+using   namespace       std;
+
+namespace
+{
+  G4Mutex tracerMutex = G4MUTEX_INITIALIZER;
+  const chrono::steady_clock::time_point tracerEpoch = chrono::steady_clock::now();
+
+  G4ThreadLocal vector<TraceSpan>* localSpans = 0;
+  G4ThreadLocal RunTracerStateObserver* localObserver = 0;
+
+  const char* StateName(G4ApplicationState s)
+  {
+    switch(s)
+    {
+      case G4State_PreInit: return "PreInit";
+      case G4State_Init: return "Init";
+      case G4State_Idle: return "Idle";
+      case G4State_GeomClosed: return "GeomClosed";
+      case G4State_EventProc: return "EventProc";
+      case G4State_Quit: return "Quit";
+      case G4State_Abort: return "Abort";
+    }
+    return "Unknown";
+  }
+
+  string JsonEscape(const string& s)
+  {
+    string out;
+    for(unsigned int i = 0; i < s.size(); i++)
+    {
+      if(s[i] == '"' || s[i] == '\\') out += '\\';
+      out += s[i];
+    }
+    return out;
+  }
+}
+
+G4bool RunTracer::fEnabled = false;
+G4bool RunTracer::fTraceEvents = false;
+
+RunTracer* RunTracer::Instance()
+{
+  // intentionally never deleted, so its UI commands are not removed after the UI manager is gone
+  static RunTracer* theTracer = new RunTracer();
+  return theTracer;
+}
+
+RunTracer::RunTracer()
+: fFileName("FinalSim_Trace.json")
+{
+  fMessenger = new RunTracerMessenger(this);
+}
+
+RunTracer::~RunTracer()
+{
+  delete fMessenger;
+  for(unsigned int i = 0; i < fThreadSpans.size(); i++)
+    delete fThreadSpans[i];
+}
+
+void RunTracer::SetEnabled(G4bool b)
+{
+  fEnabled = b;
+  if(fEnabled) AttachToThread();
+}
+
+double RunTracer::Now() const
+{
+  return chrono::duration<double, micro>(chrono::steady_clock::now() - tracerEpoch).count();
+}
+
+vector<TraceSpan>* RunTracer::LocalSpans()
+{
+  if(!localSpans)	// first span on this thread: register its buffer once, no locking afterwards
+  {
+    localSpans = new vector<TraceSpan>();
+    localSpans->reserve(1024);
+    G4AutoLock lock(&tracerMutex);
+    fThreadSpans.push_back(localSpans);
+  }
+  return localSpans;
+}
+
+void RunTracer::Record(const char* name, const char* cat, double tBegin, double tEnd)
+{
+  if(!fEnabled) return;
+  TraceSpan s;
+  s.name = name;
+  s.cat = cat;
+  s.ts = tBegin;
+  s.dur = tEnd - tBegin;
+  s.tid = G4Threading::G4GetThreadId() + 1;	// master is -1 in MT mode
+  LocalSpans()->push_back(s);
+}
+
+void RunTracer::AttachToThread()
+{
+  if(!localObserver) localObserver = new RunTracerStateObserver();	// registers itself with this thread's state manager
+}
+
+void RunTracer::Write()
+{
+  G4AutoLock lock(&tracerMutex);
+  ofstream outfile(fFileName.c_str());
+  if(!outfile.good())
+  {
+    G4cout << "RunTracer: unable to write trace file " << fFileName << G4endl;
+    return;
+  }
+
+  int pid = getpid();
+  unsigned int nSpans = 0;
+  outfile << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  for(unsigned int t = 0; t < fThreadSpans.size(); t++)
+  {
+    const vector<TraceSpan>& spans = *fThreadSpans[t];
+    for(unsigned int i = 0; i < spans.size(); i++)
+    {
+      if(nSpans++) outfile << ",\n";
+      outfile << "{\"name\": \"" << JsonEscape(spans[i].name) << "\", \"cat\": \"" << spans[i].cat
+	      << "\", \"ph\": \"X\", \"ts\": " << fixed << spans[i].ts << ", \"dur\": " << spans[i].dur
+	      << ", \"pid\": " << pid << ", \"tid\": " << spans[i].tid << "}";
+    }
+  }
+  // name the thread lanes
+  for(unsigned int t = 0; t < fThreadSpans.size(); t++)
+  {
+    if(fThreadSpans[t]->empty()) continue;
+    G4int tid = fThreadSpans[t]->front().tid;
+    if(nSpans++) outfile << ",\n";
+    outfile << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << tid
+	    << ", \"args\": {\"name\": \"" << (tid ? "worker " : "master") << (tid ? tid-1 : 0) << "\"}}";
+  }
+  outfile << "\n]}\n";
+  outfile.close();
+
+  G4cout << "RunTracer: wrote " << nSpans << " trace entries to " << fFileName << G4endl;
+}
+
+//----------------------------------------------------------------
+
+RunTracerStateObserver::RunTracerStateObserver()
+: G4VStateDependent(),
+  fState(G4StateManager::GetStateManager()->GetCurrentState()),
+  fStateBegin(RunTracer::Instance()->Now())
+{}
+
+G4bool RunTracerStateObserver::Notify(G4ApplicationState requestedState)
+{
+  RunTracer* tracer = RunTracer::Instance();
+  double now = tracer->Now();
+  // Idle/PreInit time is just waiting on the UI; keep only the states where work happens
+  if(fState != G4State_Idle && fState != G4State_PreInit)
+    tracer->Record(StateName(fState), "state", fStateBegin, now);
+  fState = requestedState;
+  fStateBegin = now;
+  return true;
+}
+
+//----------------------------------------------------------------
+
+RunTracerMessenger::RunTracerMessenger(RunTracer* T): fTracer(T)
+{
+  fTraceDir = new G4UIdirectory("/ucn/trace/");
+  fTraceDir->SetGuidance("Chrome trace-event timeline of the run phases");
+
+  fEnableCmd = new G4UIcmdWithABool("/ucn/trace/enable", this);
+  fEnableCmd->SetGuidance("Record initialization, state and output spans");
+  fEnableCmd->SetDefaultValue(true);
+  fEnableCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fEventsCmd = new G4UIcmdWithABool("/ucn/trace/events", this);
+  fEventsCmd->SetGuidance("Also record one span per event (large traces for long runs)");
+  fEventsCmd->SetDefaultValue(true);
+  fEventsCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fFileCmd = new G4UIcmdWithAString("/ucn/trace/file", this);
+  fFileCmd->SetGuidance("Output file for the JSON trace");
+  fFileCmd->SetDefaultValue("FinalSim_Trace.json");
+  fFileCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fWriteCmd = new G4UIcmdWithoutParameter("/ucn/trace/write", this);
+  fWriteCmd->SetGuidance("Write the spans recorded so far (also done automatically at exit)");
+  fWriteCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+RunTracerMessenger::~RunTracerMessenger()
+{
+  delete fEnableCmd;
+  delete fEventsCmd;
+  delete fFileCmd;
+  delete fWriteCmd;
+  delete fTraceDir;
+}
+
+void RunTracerMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fEnableCmd)
+  {
+    fTracer->SetEnabled(fEnableCmd->GetNewBoolValue(newValue));
+  }
+  else if(command == fEventsCmd)
+  {
+    fTracer->SetTraceEvents(fEventsCmd->GetNewBoolValue(newValue));
+  }
+  else if(command == fFileCmd)
+  {
+    fTracer->SetFileName(newValue);
+  }
+  else if(command == fWriteCmd)
+  {
+    fTracer->Write();
+  }
+}
@@ -0,0 +1,195 @@
+#include "StackingAction.hh"
+#include "DetectorConstruction.hh"
+#include "EventTermination.hh"
+
+#include "G4Track.hh"
+#include "G4Gamma.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
+#include "G4VTouchable.hh"
+#include "G4LogicalVolume.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4Navigator.hh"
+#include "G4TransportationManager.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstdio>
+using   namespace       std;
+
+namespace
+{
+  G4ClassificationOfNewTrack StackFromName(const G4String& stack)
+  {
+    if(stack == "waiting") return fWaiting;
+    if(stack == "kill") return fKill;
+    return fUrgent;
+  }
+}
+
+StackingAction::StackingAction(DetectorConstruction* det)
+: G4UserStackingAction(),
+  fDetector(det), fChargedStack(fUrgent), fLowGammaStack(fUrgent), fLowGammaEnergy(50*keV), fRunID(-1)
+{
+  fNavigator = new G4Navigator();
+  StartRun(-1);
+  fMessenger = new StackingActionMessenger(this);
+}
+
+StackingAction::~StackingAction()
+{
+  delete fMessenger;
+  delete fNavigator;
+}
+
+void StackingAction::SetChargedStack(const G4String& stack)
+{
+  fChargedStack = StackFromName(stack);
+}
+
+void StackingAction::SetLowGammaStack(const G4String& stack)
+{
+  fLowGammaStack = StackFromName(stack);
+}
+
+void StackingAction::StartRun(G4int runID)
+{
+  fRunID = runID;
+  for(int i = 0; i < kNClasses; i++)
+  {
+    fNTracks[i] = fNWaiting[i] = fNKilled[i] = 0;
+    fEnergy[i] = 0;
+  }
+  // the geometry may have been rebuilt since the last run
+  if(runID >= 0) fNavigator->SetWorldVolume(G4TransportationManager::GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume());
+}
+
+G4bool StackingAction::InDetector(const G4Track* track) const
+{
+  const G4VTouchable* touchable = track->GetTouchable();
+  if(touchable == NULL) return false;
+  for(int depth = 0; depth <= touchable->GetHistoryDepth(); depth++)
+  {
+    G4LogicalVolume* volume = touchable->GetVolume(depth)->GetLogicalVolume();
+    for(int i = 0; i <= 1; i++)
+      if(volume == fDetector->scint_container_log[i] || volume == fDetector->mwpc_container_log[i]) return true;
+  }
+  return false;
+}
+
+G4bool StackingAction::Escaping(const G4Track* track)
+{
+  // only the deterministic rule: "absorbed" gammas keep a small chance to get out and score
+  G4ThreeVector pos = track->GetPosition();
+  G4VPhysicalVolume* volume = fNavigator->LocateGlobalPointAndSetup(pos, 0, false, true);
+  G4double safety = fNavigator->ComputeSafety(pos);
+  return EventTermination::Instance()->ClassifyAt(track, volume, safety, fDetector) == EventTermination::kEscaping;
+}
+
+StackingAction::TrackClass StackingAction::Classify(const G4Track* track) const
+{
+  if(track->GetParentID() == 0) return kPrimary;
+  if(track->GetDefinition()->GetPDGCharge() != 0) return InDetector(track) ? kDetectorCharged : kCharged;
+  if(track->GetDefinition() == G4Gamma::Gamma() && track->GetKineticEnergy() < fLowGammaEnergy && !InDetector(track))
+    return kLowGamma;
+  return kOther;
+}
+
+G4ClassificationOfNewTrack StackingAction::ClassifyNewTrack(const G4Track* track)
+{
+  const G4Run* run = G4RunManager::GetRunManager()->GetCurrentRun();
+  if(run != NULL && run->GetRunID() != fRunID) StartRun(run->GetRunID());
+
+  TrackClass trackClass = Classify(track);
+  fNTracks[trackClass]++;
+  fEnergy[trackClass] += track->GetKineticEnergy();
+
+  G4ClassificationOfNewTrack stack = fUrgent;
+  if(trackClass == kCharged) stack = fChargedStack;
+  else if(trackClass == kLowGamma)
+  {
+    stack = fLowGammaStack;
+    if(stack == fKill && !Escaping(track)) stack = fWaiting;	// never drop a gamma that might still score
+  }
+  if(stack == fWaiting) fNWaiting[trackClass]++;
+  else if(stack == fKill) fNKilled[trackClass]++;
+  return stack;
+}
+
+void StackingAction::Report() const
+{
+  static const char* names[kNClasses] = { "primary", "detectorCharged", "charged", "lowGamma", "other" };
+  char line[256];
+  G4cout << "Stacking: class \t tracks \t waiting \t killed \t mean energy (keV)" << G4endl;
+  for(int i = 0; i < kNClasses; i++)
+  {
+    snprintf(line, sizeof(line), "  %-16s %10ld %10ld %10ld %10.2f\n", names[i], (long)fNTracks[i], (long)fNWaiting[i],
+	     (long)fNKilled[i], fNTracks[i] ? fEnergy[i]/keV/fNTracks[i] : 0.);
+    G4cout << line;
+  }
+}
+
+//----------------------------------------------------------------
+
+StackingActionMessenger::StackingActionMessenger(StackingAction* S): fStacking(S)
+{
+  fStackDir = new G4UIdirectory("/ucn/stack/");
+  fStackDir->SetGuidance("Track stacking order and pruning of low-energy gammas");
+
+  fChargedCmd = new G4UIcmdWithAString("/ucn/stack/charged", this);
+  fChargedCmd->SetGuidance("Stack for charged secondaries outside the scintillator and MWPC containers");
+  fChargedCmd->SetCandidates("urgent waiting");
+  fChargedCmd->SetDefaultValue("urgent");
+  fChargedCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fLowGammaCmd = new G4UIcmdWithAString("/ucn/stack/lowGamma", this);
+  fLowGammaCmd->SetGuidance("Stack for low-energy gammas outside the detector containers;");
+  fLowGammaCmd->SetGuidance("kill drops those born outside the detector region moving away from it (the escaping rule of");
+  fLowGammaCmd->SetGuidance("/ucn/termination/) and delays the rest, so it does not change the scored energy");
+  fLowGammaCmd->SetCandidates("urgent waiting kill");
+  fLowGammaCmd->SetDefaultValue("urgent");
+  fLowGammaCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fLowGammaEnergyCmd = new G4UIcmdWithADoubleAndUnit("/ucn/stack/lowGammaEnergy", this);
+  fLowGammaEnergyCmd->SetGuidance("Gammas below this energy count as low-energy");
+  fLowGammaEnergyCmd->SetDefaultValue(50.);
+  fLowGammaEnergyCmd->SetDefaultUnit("keV");
+  fLowGammaEnergyCmd->SetRange("lowGammaEnergy>0");
+  fLowGammaEnergyCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fReportCmd = new G4UIcmdWithoutParameter("/ucn/stack/report", this);
+  fReportCmd->SetGuidance("Print the per-class track statistics of the last run");
+  fReportCmd->AvailableForStates(G4State_Idle);
+}
+
+StackingActionMessenger::~StackingActionMessenger()
+{
+  delete fChargedCmd;
+  delete fLowGammaCmd;
+  delete fLowGammaEnergyCmd;
+  delete fReportCmd;
+  delete fStackDir;
+}
+
+void StackingActionMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fChargedCmd)
+  {
+    fStacking->SetChargedStack(newValue);
+  }
+  else if(command == fLowGammaCmd)
+  {
+    fStacking->SetLowGammaStack(newValue);
+  }
+  else if(command == fLowGammaEnergyCmd)
+  {
+    fStacking->SetLowGammaEnergy(fLowGammaEnergyCmd->GetNewDoubleValue(newValue));
+  }
+  else if(command == fReportCmd)
+  {
+    fStacking->Report();
+  }
+}
@@ -1,6 +1,8 @@
 #include "SteppingAction.hh"
 #include "EventAction.hh"
 #include "DetectorConstruction.hh"
+#include "ImportanceSplitting.hh"
+#include "EventTermination.hh"
 
 #include "G4Step.hh"
 #include "G4Event.hh"
@@ -36,24 +38,48 @@ void SteppingAction::UserSteppingAction(const G4Step* step)
   G4LogicalVolume* volume = step->GetPreStepPoint()->GetTouchableHandle()->GetVolume()->GetLogicalVolume();
 
   G4double edepStep = step->GetTotalEnergyDeposit();
+  fEventAction -> CountStep();
 
+  // with importance splitting, deposits go to the track's branch (-1: trunk)
+  const BranchInfo* branchInfo = static_cast<const BranchInfo*>(step->GetTrack()->GetUserInformation());
+  G4int branch = branchInfo ? branchInfo->GetBranch() : -1;
+
+  G4double sensitiveEdep = 0;
   // check if the volume we are in is one of the logical volumes we're interested in
   if(volume == (*detectorConstruction).scint_scintillator_log[0])
   {
-    fEventAction -> AddEdep(edepStep, 0, 0);
+    fEventAction -> AddEdep(edepStep, 0, 0, branch);
+    sensitiveEdep = edepStep;
   }
   if(volume == (*detectorConstruction).mwpc_container_log[0])
   {
-    fEventAction -> AddEdep(edepStep, 1, 0);
+    fEventAction -> AddEdep(edepStep, 1, 0, branch);
+    sensitiveEdep = edepStep;
   }
   if(volume == (*detectorConstruction).scint_scintillator_log[1])
   {
-    fEventAction -> AddEdep(edepStep, 0, 1);
+    fEventAction -> AddEdep(edepStep, 0, 1, branch);
+    sensitiveEdep = edepStep;
   }
   if(volume == (*detectorConstruction).mwpc_container_log[1])
   {
-    fEventAction -> AddEdep(edepStep, 1, 1);
+    fEventAction -> AddEdep(edepStep, 1, 1, branch);
+    sensitiveEdep = edepStep;
+  }
+
+  ImportanceSplitting* splitting = ImportanceSplitting::Instance();
+  if(branch >= 0)
+  {
+    ImportanceSplitting::PropagateBranch(step);
   }
+  else if(splitting->IsEnabled() && !fEventAction->HasBranches() && splitting->IsSplitPoint(step, detectorConstruction))
+  {
+    fEventAction -> StartBranches(splitting->GetSplitFactor());	// one split level per event
+    splitting->Split(step);
+  }
+
+  EventTermination* termination = EventTermination::Instance();
+  if(termination->IsEnabled()) termination->Apply(step, detectorConstruction, sensitiveEdep, fInertTails);
 
 }
 
@@ -0,0 +1,272 @@
+#include "SweepDriver.hh"
+#include "DetectorConstruction.hh"
+#include "RunAction.hh"
+#include "QFile.hh"
+#include "PathUtils.hh"
+
+#include "G4RunManager.hh"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+using   namespace       std;
+
+namespace
+{
+  typedef vector< pair<double,double> > Spectrum;	///< (energy [keV], event weight), one per output row
+
+  // Scintillator energies of the events in an output file, for events depositing in that
+  // scintillator. Event lines are the primary generator's prefix, ending with its last
+  // "cm /t", then the four EventAction energy columns (East scint, East MWPC, West scint,
+  // West MWPC) and, when importance splitting was enabled, the branch weight.
+  void ReadScintSpectra(const G4String& fileName, Spectrum& east, Spectrum& west)
+  {
+    ifstream infile(fileName.c_str());
+    string line;
+    while(getline(infile, line))
+    {
+      size_t sep = line.rfind("cm /t");
+      if(sep == string::npos) continue;	// header and other lines
+      istringstream columns(line.substr(sep + 5));
+      vector<double> values;
+      double x;
+      while(columns >> x) values.push_back(x);
+      if(!columns.eof() || (values.size() != 4 && values.size() != 5)) continue;
+      double weight = values.size() == 5 ? values[4] : 1.;
+      if(values[0] > 0) east.push_back(make_pair(values[0], weight));
+      if(values[2] > 0) west.push_back(make_pair(values[2], weight));
+    }
+  }
+
+  // sum of weights and Kish effective number of entries (sum w)^2/(sum w^2)
+  void Weights(const Spectrum& v, double& sumW, double& nEff)
+  {
+    double sumW2 = 0;
+    sumW = 0;
+    for(size_t i = 0; i < v.size(); i++) { sumW += v[i].second; sumW2 += v[i].second*v[i].second; }
+    nEff = sumW2 > 0 ? sumW*sumW/sumW2 : 0;
+  }
+
+  // two-sample Kolmogorov-Smirnov distance between the weighted distributions,
+  // with the asymptotic p-value for the effective numbers of entries
+  void KolmogorovSmirnov(Spectrum a, Spectrum b, double& D, double& p)
+  {
+    D = 0;
+    p = 1;
+    double sumA, sumB, nA, nB;
+    Weights(a, sumA, nA);
+    Weights(b, sumB, nB);
+    if(sumA <= 0 || sumB <= 0) return;
+    sort(a.begin(), a.end());
+    sort(b.begin(), b.end());
+    size_t i = 0, j = 0;
+    double cdfA = 0, cdfB = 0;
+    while(i < a.size() && j < b.size())
+    {
+      double x = min(a[i].first, b[j].first);
+      while(i < a.size() && a[i].first <= x) cdfA += a[i++].second/sumA;
+      while(j < b.size() && b[j].first <= x) cdfB += b[j++].second/sumB;
+      D = max(D, fabs(cdfA - cdfB));
+    }
+    double ne = nA*nB/(nA + nB);
+    double lambda = (sqrt(ne) + 0.12 + 0.11/sqrt(ne))*D;
+    if(lambda < 0.2) return;	// series does not converge; p = 1 to well below 1e-6
+    p = 0;
+    for(int k = 1; k <= 100; k++) p += (k % 2 ? 2 : -2)*exp(-2*k*k*lambda*lambda);
+    p = max(0., min(1., p));
+  }
+
+  // weighted mean and its error for the effective number of entries
+  void MeanAndError(const Spectrum& v, double& mean, double& err)
+  {
+    mean = err = 0;
+    double sumW, nEff;
+    Weights(v, sumW, nEff);
+    if(sumW <= 0 || nEff <= 1) return;
+    double sum = 0, sum2 = 0;
+    for(size_t i = 0; i < v.size(); i++) { sum += v[i].second*v[i].first; sum2 += v[i].second*v[i].first*v[i].first; }
+    mean = sum/sumW;
+    err = sqrt(max(0., sum2/sumW - mean*mean)/(nEff - 1));
+  }
+}
+
+SweepDriver::SweepDriver(DetectorConstruction* det)
+: fDetector(det),
+  fEventsPerPoint(1000),
+  fOutputBase("FinalSim_EnergyOutput")
+{
+  fMessenger = new SweepDriverMessenger(this);
+}
+
+SweepDriver::~SweepDriver()
+{
+  delete fMessenger;
+}
+
+void SweepDriver::ApplyPoint(const Stringmap& point)
+{
+  // compare against the current detector state and only touch what differs
+  G4double V = point.getDefault("mwpcV", fDetector->GetMWPCPotential()/volt)*volt;
+  if(V != fDetector->GetMWPCPotential()) fDetector->SetMWPCPotential(V);
+
+  G4double scale = point.getDefault("fieldScale", fDetector->GetFieldScale());
+  if(scale != fDetector->GetFieldScale()) fDetector->SetFieldScale(scale);
+
+  G4double P = point.getDefault("vacuum", fDetector->GetVacuumPressure()/torr)*torr;
+  if(P != fDetector->GetVacuumPressure()) fDetector->SetVacuumPressure(P);
+
+  G4double dead = point.getDefault("deadLayer", fDetector->GetDeadLayerThickness()/um)*um;
+  if(dead != fDetector->GetDeadLayerThickness()) fDetector->SetDeadLayerThickness(dead);
+}
+
+void SweepDriver::Run(const G4String& pointsFile)
+{
+  if(!fileExists(pointsFile))
+  {
+    G4cout << "SweepDriver: parameter point list " << pointsFile << " not found." << G4endl;
+    return;
+  }
+  vector<Stringmap> points = QFile(pointsFile).retrieve("point");
+  G4cout << "SweepDriver: " << points.size() << " parameter points from " << pointsFile << G4endl;
+
+  G4String originalOutput = RunAction::GetOutputFileName();
+  for(unsigned int i = 0; i < points.size(); i++)
+  {
+    G4String name = points[i].getDefault("name", G4UIcommand::ConvertToString((G4int)i));
+    G4int nEvents = points[i].getDefaultI("events", fEventsPerPoint);
+    G4cout << "\n=============== Sweep point " << i+1 << "/" << points.size() << ": " << name
+	   << " (" << nEvents << " events) ===============" << G4endl;
+
+    ApplyPoint(points[i]);
+
+    // tag the results with the parameter point, both by file name and in the file itself
+    RunAction::SetOutputFileName(fOutputBase + "_" + name + ".txt");
+    ofstream outfile;
+    outfile.open(RunAction::GetOutputFileName().c_str(), ios::app);
+    outfile << "Parameter point " << name << ": mwpcV = " << fDetector->GetMWPCPotential()/volt
+	    << " V, fieldScale = " << fDetector->GetFieldScale()
+	    << ", vacuum = " << fDetector->GetVacuumPressure()/torr
+	    << " torr, deadLayer = " << fDetector->GetDeadLayerThickness()/um << " um\n";
+    outfile.close();
+
+    G4RunManager::GetRunManager()->BeamOn(nEvents);
+  }
+  RunAction::SetOutputFileName(originalOutput);
+}
+
+void SweepDriver::CompareFieldAccuracy(G4int nEvents)
+{
+  FieldAccuracyPolicy& policy = fDetector->GetAccuracyPolicy();
+  G4bool originalPolicy = policy.enabled;
+  G4String originalOutput = RunAction::GetOutputFileName();
+  long seed = G4Random::getTheSeed();	// both runs start from the same seed
+
+  const char* label[2] = { "base", "energyAware" };
+  Spectrum east[2], west[2];
+  double seconds[2];
+  for(int mode = 0; mode < 2; mode++)
+  {
+    G4cout << "\n=============== Field accuracy comparison: " << label[mode] << " tolerances ("
+	   << nEvents << " events) ===============" << G4endl;
+    policy.enabled = (mode == 1);
+    G4String fileName = fOutputBase + "_" + label[mode] + ".txt";
+    remove(fileName.c_str());	// the actions append
+    RunAction::SetOutputFileName(fileName);
+    G4Random::setTheSeed(seed);
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    G4RunManager::GetRunManager()->BeamOn(nEvents);
+    seconds[mode] = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    fDetector->ReportFieldAccuracy();
+    ReadScintSpectra(fileName, east[mode], west[mode]);
+  }
+  policy.enabled = originalPolicy;
+  RunAction::SetOutputFileName(originalOutput);
+
+  char line[256];
+  snprintf(line, sizeof(line), "Field accuracy A/B: base %.1f s, energy-aware %.1f s (x%.2f)\n",
+	   seconds[0], seconds[1], seconds[1] > 0 ? seconds[0]/seconds[1] : 0.);
+  G4cout << line;
+  for(int side = 0; side < 2; side++)
+  {
+    Spectrum* spectra = side ? west : east;
+    double meanA, errA, meanB, errB, D, p, hitsA, hitsB, nEff;
+    MeanAndError(spectra[0], meanA, errA);
+    MeanAndError(spectra[1], meanB, errB);
+    KolmogorovSmirnov(spectra[0], spectra[1], D, p);
+    Weights(spectra[0], hitsA, nEff);
+    Weights(spectra[1], hitsB, nEff);
+    snprintf(line, sizeof(line), "  %s scint: %.0f / %.0f events hit, mean %.2f +- %.2f / %.2f +- %.2f keV, KS D = %.4f (p = %.3f)\n",
+	     side ? "West" : "East", hitsA, hitsB, meanA, errA, meanB, errB, D, p);
+    G4cout << line;
+  }
+}
+
+//----------------------------------------------------------------
+
+SweepDriverMessenger::SweepDriverMessenger(SweepDriver* S): fSweep(S)
+{
+  fSweepDir = new G4UIdirectory("/ucn/sweep/");
+  fSweepDir->SetGuidance("Parameter sweeps as sub-runs sharing geometry and physics tables");
+
+  fRunCmd = new G4UIcmdWithAString("/ucn/sweep/run", this);
+  fRunCmd->SetGuidance("Run every point in the given parameter point list");
+  fRunCmd->SetParameterName("pointsFile", false);
+  fRunCmd->AvailableForStates(G4State_Idle);
+
+  fEventsCmd = new G4UIcmdWithAnInteger("/ucn/sweep/events", this);
+  fEventsCmd->SetGuidance("Events per point, for points without an 'events' key");
+  fEventsCmd->SetDefaultValue(1000);
+  fEventsCmd->SetRange("events>0");
+  fEventsCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fOutputCmd = new G4UIcmdWithAString("/ucn/sweep/output", this);
+  fOutputCmd->SetGuidance("Output file stem; each point writes <stem>_<name>.txt");
+  fOutputCmd->SetDefaultValue("FinalSim_EnergyOutput");
+  fOutputCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+  fCompareAccuracyCmd = new G4UIcmdWithAnInteger("/ucn/sweep/compareFieldAccuracy", this);
+  fCompareAccuracyCmd->SetGuidance("Run the given number of events with base and with energy-aware field tolerances");
+  fCompareAccuracyCmd->SetGuidance("(same seed, <stem>_base.txt and <stem>_energyAware.txt) and compare the scint spectra");
+  fCompareAccuracyCmd->SetDefaultValue(10000);
+  fCompareAccuracyCmd->SetRange("events>0");
+  fCompareAccuracyCmd->AvailableForStates(G4State_Idle);
+}
+
+SweepDriverMessenger::~SweepDriverMessenger()
+{
+  delete fRunCmd;
+  delete fEventsCmd;
+  delete fOutputCmd;
+  delete fCompareAccuracyCmd;
+  delete fSweepDir;
+}
+
+void SweepDriverMessenger::SetNewValue(G4UIcommand* command, G4String newValue)
+{
+  if(command == fRunCmd)
+  {
+    fSweep->Run(newValue);
+  }
+  else if(command == fEventsCmd)
+  {
+    fSweep->SetEventsPerPoint(fEventsCmd->GetNewIntValue(newValue));
+  }
+  else if(command == fOutputCmd)
+  {
+    fSweep->SetOutputBase(newValue);
+  }
+  else if(command == fCompareAccuracyCmd)
+  {
+    fSweep->CompareFieldAccuracy(fCompareAccuracyCmd->GetNewIntValue(newValue));
+  }
+}
@@ -0,0 +1,51 @@
+#include <cmath>
+
+#include "UniformFieldHelixStepper.hh"
+#include "GlobalField.hh"
+
+#include "G4Mag_EqRhs.hh"
+
+UniformFieldHelixStepper::UniformFieldHelixStepper(G4Mag_EqRhs* equation, const GlobalField* field,
+						   G4MagIntegratorStepper* fallback)
+ : G4MagHelicalStepper(equation), fField(field), fFallback(fallback), fLastExact(false),
+   fExactSteps(0), fFallbackSteps(0)
+{
+}
+
+void UniformFieldHelixStepper::Stepper(const G4double yInput[], const G4double dydx[], G4double h,
+				       G4double yOutput[], G4double yError[])
+{
+  // the track moves at most h in any direction, so this bounds the whole step
+  G4double zMin, zMax, Bz;
+  G4double r = sqrt(yInput[0]*yInput[0] + yInput[1]*yInput[1]);
+  if(r + h < fField->GetMaxRadius() && fField->UniformSection(yInput[2], zMin, zMax, Bz)
+     && yInput[2] - h > zMin && yInput[2] + h < zMax)
+  {
+    AdvanceHelix(yInput, G4ThreeVector(0., 0., Bz), h, yOutput);
+    for(int i = 0; i < GetNumberOfVariables(); i++) yError[i] = 0.;
+    fLastExact = true;
+    fExactSteps++;
+  }
+  else
+  {
+    fFallback->Stepper(yInput, dydx, h, yOutput, yError);
+    fLastExact = false;
+    fFallbackSteps++;
+  }
+}
+
+void UniformFieldHelixStepper::DumbStepper(const G4double yInput[], G4ThreeVector Bfield, G4double h, G4double yOutput[])
+{
+  AdvanceHelix(yInput, Bfield, h, yOutput);
+}
+
+G4double UniformFieldHelixStepper::DistChord() const
+{
+  return fLastExact ? G4MagHelicalStepper::DistChord() : fFallback->DistChord();
+}
+
+G4int UniformFieldHelixStepper::IntegratorOrder() const
+{
+  // the exact steps have no error; the driver's step control only matters for the fallback
+  return fFallback->IntegratorOrder();
+}
@@ -0,0 +1,16 @@
+#include "WirePlaneParameterisation.hh"
+
+#include "G4VPhysicalVolume.hh"
+#include "G4ThreeVector.hh"
+
+WirePlaneParameterisation::WirePlaneParameterisation(G4int nWires, G4double spacing)
+ : G4VPVParameterisation(), fNWires(nWires), fSpacing(spacing)
+{
+}
+
+void WirePlaneParameterisation::ComputeTransformation(const G4int copyNo, G4VPhysicalVolume* physVol) const
+{
+  // wire copyNo sits where replica segment copyNo is centred
+  physVol->SetTranslation(G4ThreeVector((copyNo - 0.5*(fNWires - 1))*fSpacing, 0., 0.));
+  physVol->SetRotation(0);
+}
@@ -4,6 +4,13 @@
 #include "RunAction.hh"
 #include "EventAction.hh"
 #include "SteppingAction.hh"
+#include "StackingAction.hh"
+#include "RunTracer.hh"
+#include "ProgressMonitor.hh"
+#include "SweepDriver.hh"
+#include "GeometryValidator.hh"
+#include "ImportanceSplitting.hh"
+#include "EventTermination.hh"
 
 #ifdef G4MULTITHREADED
 #include "G4MTRunManager.hh"
@@ -27,6 +34,11 @@ int main(int argc,char** argv)
     ui = new G4UIExecutive(argc, argv);
   }
 
+  RunTracer* tracer = RunTracer::Instance();	// creates the /ucn/trace/ commands on the master thread
+  ProgressMonitor::Instance();			// and the /ucn/progress/ commands
+  ImportanceSplitting::Instance();		// and the /ucn/bias/ commands
+  EventTermination::Instance();			// and the /ucn/termination/ commands
+
   G4int seed = time(NULL);
   G4Random::setTheEngine(new CLHEP::RanecuEngine);	// Choose the Random engine
   G4Random::setTheSeed(seed);
@@ -46,6 +58,9 @@ int main(int argc,char** argv)
   EventAction* eventAction = new EventAction;
   runManager->SetUserAction(eventAction);
   runManager->SetUserAction(new SteppingAction(eventAction));
+  runManager->SetUserAction(new StackingAction(detector));
+  SweepDriver* sweep = new SweepDriver(detector);	// /ucn/sweep/ parameter scans
+  GeometryValidator* validator = new GeometryValidator(detector);	// /ucn/validate/ geometry checks
 
   new G4UnitDefinition("torr", "torr", "Pressure", atmosphere/760.);
 
@@ -64,6 +79,10 @@ int main(int argc,char** argv)
     delete ui;
   }
 
+  if(RunTracer::IsEnabled()) tracer->Write();
+
+  delete sweep;
+  delete validator;
   delete visManager;
   delete runManager;
 }